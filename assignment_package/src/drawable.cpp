@@ -13,11 +13,13 @@ Drawable::~Drawable()
 
 void Drawable::destroyVBOdata()
 {
-    mp_context->glDeleteBuffers(1, &m_bufIdx);
-    mp_context->glDeleteBuffers(1, &m_bufVBO);
-    mp_context->glDeleteBuffers(1, &m_bufPos);
-    mp_context->glDeleteBuffers(1, &m_bufNor);
-    mp_context->glDeleteBuffers(1, &m_bufCol);
+    // Only delete handles we actually own; a stale handle from an earlier
+    // destroy may have been reused by another Drawable since.
+    if(m_idxGenerated) mp_context->glDeleteBuffers(1, &m_bufIdx);
+    if(m_vboGenerated) mp_context->glDeleteBuffers(1, &m_bufVBO);
+    if(m_posGenerated) mp_context->glDeleteBuffers(1, &m_bufPos);
+    if(m_norGenerated) mp_context->glDeleteBuffers(1, &m_bufNor);
+    if(m_colGenerated) mp_context->glDeleteBuffers(1, &m_bufCol);
     m_idxGenerated = m_vboGenerated = m_posGenerated = m_norGenerated = m_colGenerated = false;
     m_count = -1;
 }
@@ -40,6 +42,8 @@ int Drawable::elemCount()
 
 void Drawable::generateIdx()
 {
+    // Recreating the data reuses the buffer we already have
+    if(m_idxGenerated) return;
     m_idxGenerated = true;
     // Create a VBO on our GPU and store its handle in bufIdx
     mp_context->glGenBuffers(1, &m_bufIdx);
@@ -47,6 +51,8 @@ void Drawable::generateIdx()
 
 void Drawable::generateVBO()
 {
+    // Recreating the data reuses the buffer we already have
+    if(m_vboGenerated) return;
     m_vboGenerated = true;
     // Create a VBO on our GPU and store its handle in bufVBO
     mp_context->glGenBuffers(1, &m_bufVBO);
@@ -54,6 +60,8 @@ void Drawable::generateVBO()
 
 void Drawable::generatePos()
 {
+    // Recreating the data reuses the buffer we already have
+    if(m_posGenerated) return;
     m_posGenerated = true;
     // Create a VBO on our GPU and store its handle in bufPos
     mp_context->glGenBuffers(1, &m_bufPos);
@@ -61,6 +69,8 @@ void Drawable::generatePos()
 
 void Drawable::generateNor()
 {
+    // Recreating the data reuses the buffer we already have
+    if(m_norGenerated) return;
     m_norGenerated = true;
     // Create a VBO on our GPU and store its handle in bufNor
     mp_context->glGenBuffers(1, &m_bufNor);
@@ -68,6 +78,8 @@ void Drawable::generateNor()
 
 void Drawable::generateCol()
 {
+    // Recreating the data reuses the buffer we already have
+    if(m_colGenerated) return;
     m_colGenerated = true;
     // Create a VBO on our GPU and store its handle in bufCol
     mp_context->glGenBuffers(1, &m_bufCol);
@@ -75,6 +87,8 @@ void Drawable::generateCol()
 
 void Drawable::generateUV()
 {
+    // Recreating the data reuses the buffer we already have
+    if(m_uvGenerated) return;
     m_uvGenerated = true;
     // Create a VBO on our GPU and store its handle in bufCol
     mp_context->glGenBuffers(1, &m_bufUV);
@@ -6,6 +6,13 @@
 #include <QDateTime>
 #include <QKeyEvent>
 
+// Where the world is saved, relative to the working directory
+#define WORLD_DIRECTORY "world"
+// Keep finished meshes in the world directory too. Off by default:
+// the cache trades about a megabyte of disk per surface Chunk for
+// skipping the mesher when an unchanged area is revisited.
+#define USE_MESH_CACHE false
+
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
@@ -31,6 +38,11 @@ MyGL::MyGL(QWidget *parent)
 MyGL::~MyGL() {
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
+    ShaderProgram::StateStats s = ShaderProgram::stateStats();
+    std::cout << "Shader state: " << s.programBinds << " program binds (" << s.programBindsSkipped
+              << " skipped), " << s.uniformUploads << " uniform uploads (" << s.uniformUploadsSkipped
+              << " skipped), " << s.vaoBinds << " VAO binds (" << s.vaoBindsSkipped
+              << " skipped)" << std::endl;
 }
 
 
@@ -88,13 +100,17 @@ void MyGL::initializeGL()
     // and UV coordinates
 //    m_progLambert.setGeometryColor(glm::vec4(0,1,0,1));
 
-    // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
-    // using multiple VAOs, we can just bind one once.
-    glBindVertexArray(vao);
+    // We have to have a VAO bound in OpenGL 3.2 Core. The terrain's
+    // arena binds its own, so paintGL rebinds this one every frame.
+    ShaderProgram::bindVertexArray(this, vao);
 
 
     m_player.rotateOnRightLocal(-60.f);
 
+    m_terrain.setMeshCacheEnabled(USE_MESH_CACHE);
+    if(!m_terrain.openWorld(WORLD_DIRECTORY)) {
+        std::cout << "Could not open world " << WORLD_DIRECTORY << ", nothing will be saved" << std::endl;
+    }
     m_terrain.loadInitialTerrain();
 }
 
@@ -131,6 +147,7 @@ void MyGL::tick() {
     glm::vec3 currPosition = m_player.mcr_position;
 
     m_terrain.tryExpansion(this->m_prevPos, currPosition, m_time);
+    m_terrain.prefetchAlong(currPosition, m_player.getVelocity(), m_player.getLook(), m_time);
     m_terrain.checkThreadResults(m_time);
 
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
@@ -155,6 +172,8 @@ void MyGL::sendPlayerDataToGUI() const {
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
 void MyGL::paintGL() {
+    ShaderProgram::forgetBoundState();
+    ShaderProgram::bindVertexArray(this, vao);
     m_progLambert.setTime(m_time++);
 
     // Clear the screen so that we only see newly drawn images
@@ -167,7 +186,9 @@ void MyGL::paintGL() {
     int texture_slot = 1;
    // Added
    glm::vec3 playerPos = m_player.mcr_camera.mcr_position;
-   auto currBtype = m_terrain.getBlockAt(playerPos.x, playerPos.y, playerPos.z);
+   // The camera can be inside a Chunk that hasn't been generated yet
+   // while flying; treat that as open air rather than throwing.
+   BlockType currBtype = m_terrain.tryGetBlockAt(playerPos.x, playerPos.y, playerPos.z).value_or(EMPTY);
    if (currBtype == WATER || currBtype == LAVA) {
        m_framebuffer.bindFrameBuffer();
        glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
@@ -208,7 +229,8 @@ void MyGL::renderTerrain() {
     int currX = static_cast<int>(glm::floor(currPos.x / 64.f));
     int currZ = static_cast<int>(glm::floor(currPos.z / 64.f));
     //renders terrain zones around player
-    m_terrain.draw(64*currX, 64*currZ, &m_progLambert);
+    m_terrain.draw(64*currX, 64*currZ, m_player.mcr_camera.getViewProj(),
+                   m_player.mcr_camera.mcr_position, &m_progLambert);
 }
 
 void MyGL::keyPressEvent(QKeyEvent *e) {
@@ -0,0 +1,111 @@
+#pragma once
+#include "terrain.h"
+#include <stdexcept>
+#include <string>
+
+// A read-only accessor for walking the Terrain one voxel at a time.
+// Terrain::getBlockAt does a hash lookup, a float floor and two bounds
+// checks on every call; a cursor remembers which Chunk it last read from
+// and only goes back to the Terrain when it leaves that Chunk. Stepping
+// into an adjacent Chunk follows its neighbor link instead of the hash map,
+// so physics probes and raycasts (which move one cell at a time) almost
+// never touch m_chunks.
+//
+// Coordinates are world-space ints, so chunk origins and local coordinates
+// come from shifts and masks rather than floor(x / 16.f).
+//
+// Chunks that have not been generated yet read as the Terrain's unloaded
+// block type (see Terrain::setUnloadedBlockType), and cells above or below
+// the world read as EMPTY, matching Terrain::getBlockAt's height rule.
+// Nothing here throws on a missing Chunk.
+//
+// The Checked variant returns exactly the same blocks but indexes with at()
+// and verifies every cached/linked Chunk against the Terrain's own lookup,
+// throwing if the two ever disagree. Use it to debug the fast path.
+template<bool Checked>
+class BasicBlockCursor {
+private:
+    const Terrain &mcr_terrain;
+    // The Chunk containing the last cell read, or nullptr if that
+    // cell's Chunk does not exist (yet).
+    const Chunk *mp_chunk;
+    // World-space origin of the Chunk cached above
+    int m_chunkX, m_chunkZ;
+    bool m_hasChunk;
+
+    // Point the cursor at the Chunk whose origin is (cx, cz)
+    void moveToChunk(int cx, int cz) {
+        const Chunk *next = nullptr;
+        int dx = cx - m_chunkX;
+        int dz = cz - m_chunkZ;
+        if(m_hasChunk && mp_chunk != nullptr &&
+                ((dz == 0 && (dx == 16 || dx == -16)) ||
+                 (dx == 0 && (dz == 16 || dz == -16)))) {
+            // One Chunk over: follow the link rather than hashing
+            Direction dir = dx == 16 ? XPOS : dx == -16 ? XNEG : dz == 16 ? ZPOS : ZNEG;
+            next = mp_chunk->getNeighbor(dir);
+            if(next == nullptr) {
+                // Neighbors are linked whenever both exist, but fall
+                // back to the map rather than trust a missing link.
+                next = mcr_terrain.findChunkAt(cx, cz);
+            }
+        }
+        else {
+            next = mcr_terrain.findChunkAt(cx, cz);
+        }
+        if(Checked) {
+            const Chunk *expected = mcr_terrain.findChunkAt(cx, cz);
+            if(next != expected) {
+                throw std::logic_error("BlockCursor stepped to the wrong Chunk at " +
+                                       std::to_string(cx) + " " + std::to_string(cz));
+            }
+        }
+        mp_chunk = next;
+        m_chunkX = cx;
+        m_chunkZ = cz;
+        m_hasChunk = true;
+    }
+
+public:
+    BasicBlockCursor(const Terrain &terrain)
+        : mcr_terrain(terrain), mp_chunk(nullptr),
+          m_chunkX(0), m_chunkZ(0), m_hasChunk(false)
+    {}
+
+    BlockType getBlockAt(int x, int y, int z) {
+        int cx = x & ~15;
+        int cz = z & ~15;
+        if(!m_hasChunk || cx != m_chunkX || cz != m_chunkZ) {
+            moveToChunk(cx, cz);
+        }
+        if(mp_chunk == nullptr) {
+            return mcr_terrain.getUnloadedBlockType();
+        }
+        if(y < 0 || y >= 256) {
+            return EMPTY;
+        }
+        if(Checked) {
+            return mp_chunk->getBlockAt(static_cast<unsigned int>(x - cx),
+                                        static_cast<unsigned int>(y),
+                                        static_cast<unsigned int>(z - cz));
+        }
+        return mp_chunk->getBlockAtUnchecked(x & 15, y, z & 15);
+    }
+
+    BlockType getBlockAt(glm::ivec3 p) {
+        return getBlockAt(p.x, p.y, p.z);
+    }
+};
+
+using BlockCursor = BasicBlockCursor<false>;
+using CheckedBlockCursor = BasicBlockCursor<true>;
+
+// The cursor type gameplay code should use: the fast one, unless the
+// build opts in to checking with DEFINES += TERRAIN_CURSOR_CHECKED
+// (the checked cursor does a hash lookup per step, which is what the
+// cursor exists to avoid, so it isn't tied to debug builds)
+#ifdef TERRAIN_CURSOR_CHECKED
+using TerrainCursor = CheckedBlockCursor;
+#else
+using TerrainCursor = BlockCursor;
+#endif
@@ -1,25 +1,70 @@
 #include "chunk.h"
+#include "paddedchunkview.h"
 #include <iostream>
 
-Chunk::Chunk(OpenGLContext* context, int x, int z) :
-    Drawable(context), m_blocks(),
-    m_neighbors{{XPOS, nullptr},{XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
-     m_xChunk(x), m_zChunk(z)
-{
-    std::fill_n(m_blocks.begin(), 65536, EMPTY);
-}
+Chunk::Chunk(OpenGLContext* context, GpuArena *arena, int x, int z) :
+    Drawable(context), ChunkBlocks(),
+    m_neighbors{}, mp_arena(arena),
+     m_xChunk(x), m_zChunk(z),
+     m_gpuOpaque(0), m_gpuTrans(0),
+     m_minY(256), m_maxY(0), m_gpuMinY(256), m_gpuMaxY(0), m_sections(), m_mesh(),
+     m_awaitingBlocks(false), m_meshJobs(0), m_uploadPending(false), m_generated(true),
+     m_renderIndex(-1)
+{}
 
 Chunk::~Chunk()
 {
     this->destroyVBOdata();
 }
 
+// One slab per terrain zone's worth of Chunks
+static ChunkPool& chunkPool()
+{
+    static ChunkPool pool(sizeof(Chunk), 16);
+    return pool;
+}
+
+void* Chunk::operator new(std::size_t size)
+{
+    // A subclass of Chunk wouldn't fit in a pool slot
+    if(size != sizeof(Chunk)) {
+        return ::operator new(size);
+    }
+    return chunkPool().allocate();
+}
+
+void Chunk::operator delete(void *p, std::size_t size)
+{
+    if(size != sizeof(Chunk)) {
+        ::operator delete(p);
+        return;
+    }
+    chunkPool().release(p);
+}
+
+ChunkPool::Stats Chunk::poolStats()
+{
+    return chunkPool().stats();
+}
+
+
+// UV offsets of a face's four corners within its 1/16 x 1/16 atlas tile.
+// Faces along Z list their corners in a different order than the others.
+const static std::array<glm::vec2, 4> faceCornerUVsZ {
+    glm::vec2(0, 1/16.f), glm::vec2(0, 0), glm::vec2(1/16.f, 0), glm::vec2(1/16.f, 1/16.f)
+};
+const static std::array<glm::vec2, 4> faceCornerUVs {
+    glm::vec2(0, 0), glm::vec2(1/16.f, 0), glm::vec2(1/16.f, 1/16.f), glm::vec2(0, 1/16.f)
+};
 
 //Using x,z - the chunk coordinate - to transform all blocks appropriately
-void Chunk::createChunkVBOdata(ChunkVBOData& c, int time)
+//view must have been filled from this Chunk (see PaddedChunkView::fill)
+void Chunk::createChunkVBOdata(ChunkVBOData& c, const PaddedChunkView &view, int time)
 {
     //bools - vbo for chunk gen or not- > render
     this->m_idxCount = 0;
+    this->m_minY = 256;
+    this->m_maxY = 0;
 
     this->m_idxInter.clear();
     this->m_vboInter.clear();
@@ -29,136 +74,89 @@ void Chunk::createChunkVBOdata(ChunkVBOData& c, int time)
     c.m_idxOpaque.clear();
     c.m_vboOpaque.clear();
 
-    for(int i = 0; i < 16; ++i) {
-        for(int j = 0; j < 256; ++j) {
-            for(int k = 0; k < 16; ++k) {
-                BlockType currBlock = this->getBlockAt(i, j, k);
+    // Walk column by column (y innermost) to match the view's layout
+    for(int k = 0; k < 16; ++k) {
+        for(int i = 0; i < 16; ++i) {
+            for(int j = 0; j < 256; ++j) {
+                int viewIdx = PaddedChunkView::index(i, j, k);
+                BlockType currBlock = view[viewIdx];
 
                 //if empty, we don't need to paint any faces
-                if(currBlock!=EMPTY)
-                {
-                    //flow sets
-                    float flow_offset;
-                    if(currBlock==WATER || currBlock==LAVA) {
-                        flow_offset = fmod(time * 0.001, 2/16.f);
-                    }
-                    else{
-                        flow_offset = 0;
-                    }
+                if(currBlock==EMPTY)
+                    continue;
+
+                //flow sets
+                float flow_offset;
+                if(currBlock==WATER || currBlock==LAVA) {
+                    flow_offset = fmod(time * 0.001, 2/16.f);
+                }
+                else{
+                    flow_offset = 0;
+                }
 
-                    //iterating through adjacent faces to paint
-                    for(const BlockFace &f: adjacentFaces)
+                bool transparent = currBlock==WATER || currBlock==ICE || currBlock==LAVA;
+                std::vector<glm::vec4> &vbo = transparent ? c.m_vboTrans : c.m_vboOpaque;
+                std::vector<GLuint> &idx = transparent ? c.m_idxTrans : c.m_idxOpaque;
+
+                glm::vec4 vertCol = colorFromBlock.at(DEBUG);
+                if(colorFromBlock.count(currBlock) != 0)
+                    vertCol = colorFromBlock.at(currBlock);
+                const auto &currBlockUVs = BlockFaceUVs.at(currBlock);
+                //pos vecs for this block - last elem 0.0f because it adds to vert
+                glm::vec4 blockPos = glm::vec4(i+this->m_xChunk, j, k+this->m_zChunk, 0.0f);
+
+                //iterating through adjacent faces to paint
+                for(const BlockFace &f: adjacentFaces)
+                {
+                    // The padded view has a border around the Chunk,
+                    // so the adjacent block is always just an offset away
+                    BlockType adjBlock = view[viewIdx + PaddedChunkView::offsetOf(f.dir)];
+
+                    //transparent blocks only paint faces that face air;
+                    //solid blocks also paint faces that face liquid
+                    bool paintFace = transparent ?
+                                adjBlock==EMPTY :
+                                (adjBlock==EMPTY || adjBlock==WATER || adjBlock==LAVA);
+                    if(!paintFace)
+                        continue;
+
+                    glm::vec2 currBlockUV = currBlockUVs.at(f.dir);
+                    const std::array<glm::vec2, 4> &delta_dist =
+                            (f.dir==ZNEG || f.dir == ZPOS) ? faceCornerUVsZ : faceCornerUVs;
+
+                    // Index of this face's first vertex within its own list
+                    GLuint firstVert = vbo.size() / 4;
+                    int local_idx = 0;
+                    for(const VertexData &v: f.verts)
                     {
-                        BlockType adjBlock = EMPTY;
-                        glm::vec3 testBorder = glm::vec3(i,j,k) + f.dirVec;
-                        /*
-                         * testing if the face is on a bordering chunk
-                         * and then assigning to adjacent block
-                        */
-                        if(testBorder.x >=16.f || testBorder.y >=256.f || testBorder.z >=16.f ||
-                                testBorder.x < 0.0f || testBorder.y < 0.0f || testBorder.z < 0.f)
-                        {
-                            Chunk* adjChunk = this->m_neighbors[f.dir];
-                            //if a neighbo(u)ring chunk exists
-                            if(adjChunk != nullptr) {
-                                //https://stackoverflow.com/questions/7594508/modulo-operator-with-negative-values
-                                int dx = (16 + i + (int)f.dirVec.x) % 16;
-                                int dy = (256 + j + (int)f.dirVec.y) % 256;
-                                int dz = (16 + k + (int)f.dirVec.z) % 16;
-                                adjBlock = adjChunk->getBlockAt(dx,dy,dz);
-                            }
-                        }
-                        //face is in the same chunk
-                        else
-                            adjBlock = this->getBlockAt(i+(int)f.dirVec.x, j+(int)f.dirVec.y, k+(int)f.dirVec.z);
-
-                        //transparent block painting
-                        if(currBlock==WATER || currBlock==ICE || currBlock==LAVA)
-                        {
-                            if(adjBlock==EMPTY)
-                            {
-                                glm::vec4 vertCol = colorFromBlock.at(DEBUG);
-                                if(colorFromBlock.count(currBlock) != 0)
-                                    vertCol = colorFromBlock.at(currBlock);
-
-                                //pos vecs for this block - last elem 0.0f because it adds to vert
-                                glm::vec4 blockPos = glm::vec4(i+this->m_xChunk, j, k+this->m_zChunk, 0.0f);
-                                auto currBlockUVs = BlockFaceUVs.at(currBlock);
-                                glm::vec2 currBlockUV = currBlockUVs.at(f.dir);
-                                std::vector<glm::vec2> delta_dist;
-                                if(f.dir==ZNEG || f.dir == ZPOS)
-                                {
-                                    delta_dist = {{0,1/16.f}, {0,0}, {1/16.f,0}, {1/16.f,1/16.f}};
-                                }
-
-                                else
-                                {
-                                    delta_dist = {{0,0}, {1/16.f,0}, {1/16.f,1/16.f}, {0,1/16.f}};
-                                }
-                                int local_idx = 0;
-                                for(const VertexData &v: f.verts)
-                                {
-                                    glm::vec4 vertPos = v.pos + blockPos;
-                                    c.m_vboTrans.push_back(vertPos);
-                                    c.m_vboTrans.push_back(vertCol);
-                                    c.m_vboTrans.push_back(glm::vec4{currBlockUV + delta_dist[local_idx++] + glm::vec2(flow_offset, 0), 0, 0});
-                                    c.m_vboTrans.push_back(glm::vec4(f.dirVec,0.f));
-                                }
-                                c.m_idxTrans.push_back(0 + m_idxCount);
-                                c.m_idxTrans.push_back(1 + m_idxCount);
-                                c.m_idxTrans.push_back(2 + m_idxCount);
-                                c.m_idxTrans.push_back(0 + m_idxCount);
-                                c.m_idxTrans.push_back(2 + m_idxCount);
-                                c.m_idxTrans.push_back(3 + m_idxCount);
-                                m_idxCount += 4;
-                            }
-                        }
-                        //if not empty, paint faces (while checking for empty neighbors)
-                        else //solid block painting (!= WATER/ICE/LAVA)
-                        {
-                            if(adjBlock==EMPTY || adjBlock==WATER || adjBlock==LAVA)
-                            {
-                                glm::vec4 vertCol = colorFromBlock.at(DEBUG);
-                                if(colorFromBlock.count(currBlock) != 0)
-                                    vertCol = colorFromBlock.at(currBlock);
-
-                                //pos vecs for this block - last elem 0.0f because it adds to vert
-                                glm::vec4 blockPos = glm::vec4(i+this->m_xChunk, j, k+this->m_zChunk, 0.0f);
-                                auto currBlockUVs = BlockFaceUVs.at(currBlock);
-                                glm::vec2 currBlockUV = currBlockUVs.at(f.dir);
-                                std::vector<glm::vec2> delta_dist;
-                                if(f.dir==ZNEG || f.dir == ZPOS){
-                                    delta_dist = {{0,1/16.f}, {0,0}, {1/16.f,0}, {1/16.f,1/16.f}};
-                                }
-                                else{
-                                    delta_dist = {{0,0}, {1/16.f,0}, {1/16.f,1/16.f}, {0,1/16.f}};
-                                }
-
-                                int local_idx = 0;
-                                for(const VertexData &v: f.verts)
-                                {
-                                    glm::vec4 vertPos = v.pos + blockPos;
-                                    c.m_vboOpaque.push_back(vertPos);
-                                    c.m_vboOpaque.push_back(vertCol);
-                                    c.m_vboOpaque.push_back(glm::vec4{currBlockUV + delta_dist[local_idx++] + glm::vec2(flow_offset, 0), 0, 0});
-                                    c.m_vboOpaque.push_back(glm::vec4(f.dirVec,0.f));
-                                }
-                                c.m_idxOpaque.push_back(0 + m_idxCount);
-                                c.m_idxOpaque.push_back(1 + m_idxCount);
-                                c.m_idxOpaque.push_back(2 + m_idxCount);
-                                c.m_idxOpaque.push_back(0 + m_idxCount);
-                                c.m_idxOpaque.push_back(2 + m_idxCount);
-                                c.m_idxOpaque.push_back(3 + m_idxCount);
-                                m_idxCount += 4;
-                            }
-                        }
+                        glm::vec4 vertPos = v.pos + blockPos;
+                        vbo.push_back(vertPos);
+                        vbo.push_back(vertCol);
+                        vbo.push_back(glm::vec4{currBlockUV + delta_dist[local_idx++] + glm::vec2(flow_offset, 0), 0, 0});
+                        vbo.push_back(glm::vec4(f.dirVec,0.f));
                     }
+                    idx.push_back(0 + firstVert);
+                    idx.push_back(1 + firstVert);
+                    idx.push_back(2 + firstVert);
+                    idx.push_back(0 + firstVert);
+                    idx.push_back(2 + firstVert);
+                    idx.push_back(3 + firstVert);
+                    m_idxCount += 4;
+                    m_minY = glm::min(m_minY, j);
+                    m_maxY = glm::max(m_maxY, j + 1);
                 }
             }
         }
     }
+    // The transparent vertices come after the opaque ones in the
+    // interleaved buffer, so shift their indices to match
+    GLuint opaqueVerts = c.m_vboOpaque.size() / 4;
+    // Sized once, so a kept copy holds no growth slack
+    m_idxInter.reserve(c.m_idxOpaque.size() + c.m_idxTrans.size());
+    m_vboInter.reserve(c.m_vboOpaque.size() + c.m_vboTrans.size());
     m_idxInter.insert(m_idxInter.end(), c.m_idxOpaque.begin(), c.m_idxOpaque.end());
-    m_idxInter.insert(m_idxInter.end(), c.m_idxTrans.begin(), c.m_idxTrans.end());
+    for(GLuint i : c.m_idxTrans)
+        m_idxInter.push_back(i + opaqueVerts);
     m_vboInter.insert(m_vboInter.end(), c.m_vboOpaque.begin(), c.m_vboOpaque.end());
     m_vboInter.insert(m_vboInter.end(), c.m_vboTrans.begin(), c.m_vboTrans.end());
     m_countTrans = c.m_idxTrans.size();
@@ -168,31 +166,35 @@ void Chunk::createChunkVBOdata(ChunkVBOData& c, int time)
 
 void Chunk::createVBOdata()
 {
-    generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_idxInter.size() * sizeof(GLuint), m_idxInter.data(), GL_STATIC_DRAW);
-
-    generateVBO();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufVBO);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboInter.size() * sizeof(glm::vec4), m_vboInter.data(), GL_STATIC_DRAW);
+    mp_arena->upload(m_mesh, m_vboInter, m_idxInter);
+    m_count = m_mesh.indexCount;
+    m_gpuOpaque = m_countOpaque;
+    m_gpuTrans = m_countTrans;
+    m_gpuMinY = m_minY;
+    m_gpuMaxY = m_maxY;
 }
 
-// Does bounds checking with at()
-BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
-    return m_blocks.at(x + 16 * y + 16 * 256 * z);
+void Chunk::releaseCpuMesh()
+{
+    // clear() alone would keep the memory
+    std::vector<GLuint>().swap(m_idxInter);
+    std::vector<glm::vec4>().swap(m_vboInter);
 }
 
-// Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
-BlockType Chunk::getBlockAt(int x, int y, int z) const {
-    return getBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
+std::size_t Chunk::cpuMeshBytes() const
+{
+    return m_vboInter.capacity() * sizeof(glm::vec4) + m_idxInter.capacity() * sizeof(GLuint);
 }
 
-// Does bounds checking with at()
-void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+void Chunk::destroyVBOdata()
+{
+    mp_arena->release(m_mesh);
+    m_gpuOpaque = m_gpuTrans = 0;
+    m_gpuMinY = 256;
+    m_gpuMaxY = 0;
+    Drawable::destroyVBOdata();
 }
 
-
 const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirection {
     {XPOS, XNEG},
     {XNEG, XPOS},
@@ -208,3 +210,17 @@ void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
         neighbor->m_neighbors[oppositeDirection.at(dir)] = this;
     }
 }
+
+Chunk* Chunk::getNeighbor(Direction dir) const {
+    return m_neighbors[dir];
+}
+
+void Chunk::unlinkNeighbors() {
+    for(int d = 0; d < 6; ++d) {
+        Chunk *n = m_neighbors[d];
+        if(n != nullptr) {
+            n->m_neighbors[oppositeDirection.at(static_cast<Direction>(d))] = nullptr;
+            m_neighbors[d] = nullptr;
+        }
+    }
+}
@@ -2,6 +2,10 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include "drawable.h"
+#include "chunkblocks.h"
+#include "chunkpool.h"
+#include "occlusion.h"
+#include "gpuarena.h"
 #include <array>
 #include <unordered_map>
 #include <cstddef>
@@ -14,21 +18,6 @@
 
 //using namespace std;
 
-// C++ 11 allows us to define the size of an enum. This lets us use only one byte
-// of memory to store our different block types. By default, the size of a C++ enum
-// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
-// block types, but in the scope of this project we'll never get anywhere near that many.
-enum BlockType : unsigned char
-{
-    EMPTY, GRASS, DIRT, STONE, WATER, SNOW, BEDROCK, LAVA, DEBUG, ICE
-};
-
-// The six cardinal directions in 3D space
-enum Direction : unsigned char
-{
-        XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
-};
-
 // Lets us use any enum class as the key of a
 // std::unordered_map
 struct EnumHash {
@@ -176,6 +165,7 @@ const static std::unordered_map<BlockType, std::unordered_map<Direction, glm::ve
 };
 
 struct ChunkVBOData;
+class PaddedChunkView;
 
 // One Chunk is a 16 x 256 x 16 section of the world,
 // containing all the Minecraft blocks in that area.
@@ -183,32 +173,83 @@ struct ChunkVBOData;
 // recomputing its VBO data faster by not having to
 // render all the world at once, while also not having
 // to render the world block by block.
-class Chunk : public Drawable {
+class Chunk : public Drawable, public ChunkBlocks {
 private:
-    // All of the blocks contained within this Chunk
-    std::array<BlockType, 65536> m_blocks;
-    // This Chunk's four neighbors to the north, south, east, and west
-    // The third input to this map just lets us use a Direction as
-    // a key for this map.
-    // These allow us to properly determine
-    std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
+    // This Chunk's four neighbors to the north, south, east, and west,
+    // indexed by Direction. The YPOS and YNEG slots always stay nullptr
+    // since Chunks span the full height of the world.
+    // These allow us to properly determine which faces border air
+    std::array<Chunk*, 6> m_neighbors;
+    GpuArena *mp_arena;
 
 public:
-    Chunk(OpenGLContext*, int, int);
+    // The Chunk's mesh is uploaded into arena
+    Chunk(OpenGLContext*, GpuArena *arena, int, int);
     ~Chunk();
-    void createChunkVBOdata(ChunkVBOData&, int time);
+    // Chunks are carved out of a shared ChunkPool rather than
+    // allocated one by one, so mkU<Chunk> and deleting a Chunk
+    // take and return a pooled slot.
+    static void* operator new(std::size_t size);
+    static void operator delete(void *p, std::size_t size);
+    // Occupancy of the pool backing all Chunks
+    static ChunkPool::Stats poolStats();
+    // Builds this Chunk's mesh from a view filled from this Chunk
+    void createChunkVBOdata(ChunkVBOData&, const PaddedChunkView&, int time);
+    // Uploads m_vboInter and m_idxInter into the arena, replacing
+    // the mesh uploaded before
     void createVBOdata() override;
+    // Gives the mesh's space in the arena back
+    void destroyVBOdata() override;
+    // Frees m_vboInter and m_idxInter once they're on the GPU. The
+    // mesh can always be rebuilt from the blocks by meshing again.
+    void releaseCpuMesh();
+    // Memory held by m_vboInter and m_idxInter, counting capacity
+    std::size_t cpuMeshBytes() const;
     //drawMode is triangles by default
-    BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
-    BlockType getBlockAt(int x, int y, int z) const;
-    void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // The adjacent Chunk in the given direction, or nullptr if it doesn't exist
+    Chunk* getNeighbor(Direction dir) const;
+    // Clears the links between this Chunk and all of its neighbors
+    void unlinkNeighbors();
 
     int m_xChunk, m_zChunk;
     int m_idxCount;
     int m_countTrans, m_countOpaque;
+    // The same counts for the mesh on the GPU, taken when it was
+    // uploaded; the ones above may already belong to a newer mesh.
+    // The opaque indices come first.
+    int m_gpuOpaque, m_gpuTrans;
+    // The mesh as built by a worker, until it is uploaded
     std::vector<GLuint> m_idxInter;
     std::vector<glm::vec4> m_vboInter;
+    // The heights the worker's mesh spans, [m_minY, m_maxY).
+    // m_minY >= m_maxY when the mesh has no faces.
+    int m_minY, m_maxY;
+    // The same for the mesh on the GPU, which is what gets culled;
+    // workers may be writing the ones above meanwhile
+    int m_gpuMinY, m_gpuMaxY;
+    // Which faces of each section see each other, as of the mesh
+    // on the GPU
+    SectionGraph m_sections;
+    // Where the mesh is in the arena
+    GpuArena::Allocation m_mesh;
+
+    // Main-thread bookkeeping that keeps Terrain from evicting a
+    // Chunk while a worker thread may still be using it.
+    // True from spawnFBMWorker until checkThreadResults picks up
+    // this Chunk's block data.
+    bool m_awaitingBlocks;
+    // VBOWorkers started for this Chunk whose results have not been
+    // uploaded by checkThreadResults yet
+    int m_meshJobs;
+    // A finished mesh is waiting in Terrain's upload queue
+    bool m_uploadPending;
+    // The blocks came from the terrain generator (plus the player's
+    // edits), rather than from a Chunk saved whole
+    bool m_generated;
+    // Where this Chunk sits in Terrain's render list, or -1 if its
+    // mesh isn't on the GPU
+    int m_renderIndex;
 };
 
 struct ChunkVBOData
@@ -216,10 +257,12 @@ struct ChunkVBOData
     Chunk* m_chunk;
     std::vector<glm::vec4> m_vboTrans, m_vboOpaque;
     std::vector<GLuint> m_idxTrans, m_idxOpaque;
+    SectionGraph m_sections;
 
     ChunkVBOData(Chunk* c)
         : m_chunk(c),
           m_vboTrans{}, m_vboOpaque{},
-          m_idxTrans{}, m_idxOpaque{}
+          m_idxTrans{}, m_idxOpaque{},
+          m_sections()
     {}
 };
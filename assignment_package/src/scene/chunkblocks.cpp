@@ -0,0 +1,27 @@
+#include "chunkblocks.h"
+#include <algorithm>
+
+ChunkBlocks::ChunkBlocks()
+    : m_blocks()
+{
+    clearBlocks();
+}
+
+// Does bounds checking with at()
+BlockType ChunkBlocks::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return m_blocks.at(ChunkLayout::index(x, y, z));
+}
+
+// Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
+BlockType ChunkBlocks::getBlockAt(int x, int y, int z) const {
+    return getBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
+}
+
+// Does bounds checking with at()
+void ChunkBlocks::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
+    m_blocks.at(ChunkLayout::index(x, y, z)) = t;
+}
+
+void ChunkBlocks::clearBlocks() {
+    std::fill_n(m_blocks.begin(), 65536, EMPTY);
+}
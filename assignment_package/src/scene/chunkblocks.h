@@ -0,0 +1,46 @@
+#pragma once
+#include "chunklayout.h"
+#include <array>
+
+// C++ 11 allows us to define the size of an enum. This lets us use only one byte
+// of memory to store our different block types. By default, the size of a C++ enum
+// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
+// block types, but in the scope of this project we'll never get anywhere near that many.
+enum BlockType : unsigned char
+{
+    EMPTY, GRASS, DIRT, STONE, WATER, SNOW, BEDROCK, LAVA, DEBUG, ICE
+};
+
+// The six cardinal directions in 3D space
+enum Direction : unsigned char
+{
+        XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
+};
+
+// The 16 x 256 x 16 blocks of one Chunk, with no rendering state.
+// Chunk inherits from this; code that only needs block data
+// (compression, persistence, offline tools) works on ChunkBlocks
+// so it doesn't drag in OpenGL.
+class ChunkBlocks {
+protected:
+    // All of the blocks contained within this Chunk,
+    // ordered according to ChunkLayout (see chunklayout.h)
+    std::array<BlockType, 65536> m_blocks;
+
+public:
+    ChunkBlocks();
+
+    BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
+    BlockType getBlockAt(int x, int y, int z) const;
+    void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // No bounds checking at all; x and z must be in [0, 16) and y in [0, 256).
+    // Meant for hot loops such as BlockCursor that have already done the math.
+    BlockType getBlockAtUnchecked(int x, int y, int z) const {
+        return m_blocks[ChunkLayout::index(x, y, z)];
+    }
+    void setBlockAtUnchecked(int x, int y, int z, BlockType t) {
+        m_blocks[ChunkLayout::index(x, y, z)] = t;
+    }
+    // Sets every block back to EMPTY
+    void clearBlocks();
+};
@@ -0,0 +1,81 @@
+#include "chunkcodec.h"
+#include <algorithm>
+
+static void writeRun(std::vector<unsigned char> &out, int length, BlockType t)
+{
+    unsigned int stored = static_cast<unsigned int>(length - 1);
+    out.push_back(static_cast<unsigned char>(stored & 0xff));
+    out.push_back(static_cast<unsigned char>(stored >> 8));
+    out.push_back(static_cast<unsigned char>(t));
+}
+
+std::vector<unsigned char> encodeChunkBlocks(const ChunkBlocks &blocks)
+{
+    std::vector<unsigned char> out;
+    BlockType runType = blocks.getBlockAtUnchecked(0, 0, 0);
+    int runLength = 0;
+    for(int z = 0; z < 16; ++z) {
+        for(int x = 0; x < 16; ++x) {
+            for(int y = 0; y < 256; ++y) {
+                BlockType t = blocks.getBlockAtUnchecked(x, y, z);
+                if(t != runType || runLength == 65536) {
+                    writeRun(out, runLength, runType);
+                    runType = t;
+                    runLength = 0;
+                }
+                runLength++;
+            }
+        }
+    }
+    writeRun(out, runLength, runType);
+    return out;
+}
+
+bool decodeChunkBlocks(const unsigned char *data, std::size_t size, ChunkBlocks &out)
+{
+    if(size % 3 != 0) {
+        return false;
+    }
+    int x = 0, y = 0, z = 0;
+    int written = 0;
+    for(std::size_t i = 0; i < size; i += 3) {
+        int length = (data[i] | (data[i + 1] << 8)) + 1;
+        if(data[i + 2] > ICE || written + length > 65536) {
+            return false;
+        }
+        BlockType t = static_cast<BlockType>(data[i + 2]);
+        written += length;
+        while(length > 0) {
+            // Fill the rest of the current column in one go
+            int span = std::min(length, 256 - y);
+            for(int end = y + span; y < end; ++y) {
+                out.setBlockAtUnchecked(x, y, z, t);
+            }
+            length -= span;
+            if(y == 256) {
+                y = 0;
+                if(++x == 16) {
+                    x = 0;
+                    ++z;
+                }
+            }
+        }
+    }
+    return written == 65536;
+}
+
+bool chunkBlocksValid(const unsigned char *data, std::size_t size)
+{
+    if(size % 3 != 0) {
+        return false;
+    }
+    int written = 0;
+    for(std::size_t i = 0; i < size; i += 3) {
+        int length = (data[i] | (data[i + 1] << 8)) + 1;
+        if(data[i + 2] > ICE || written + length > 65536) {
+            return false;
+        }
+        written += length;
+    }
+    return written == 65536;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "chunkblocks.h"
+#include <cstddef>
+#include <vector>
+
+// Compact serialized form of a Chunk's blocks, used by the compressed
+// residency tier and anything else that stores Chunks.
+//
+// Blocks are visited column by column (z, then x, then y fastest),
+// independent of the compile-time ChunkLayout, and stored as runs:
+//   2 bytes  run length - 1, little endian (so runs of 1 to 65536)
+//   1 byte   BlockType
+// A generated Chunk is mostly long vertical runs of air, stone and dirt,
+// so it typically shrinks from 64 KB to well under 2 KB, and both
+// directions run at close to memcpy speed.
+std::vector<unsigned char> encodeChunkBlocks(const ChunkBlocks &blocks);
+
+// Decodes data produced by encodeChunkBlocks straight into out.
+// Returns false (leaving out partially written) if data is truncated,
+// has trailing bytes, or names an unknown BlockType.
+bool decodeChunkBlocks(const unsigned char *data, std::size_t size, ChunkBlocks &out);
+
+// Whether decodeChunkBlocks would accept data, without decoding it.
+// Only walks the runs, so it costs a fraction of a decode.
+bool chunkBlocksValid(const unsigned char *data, std::size_t size);
@@ -0,0 +1,110 @@
+#include "chunkdelta.h"
+#include <algorithm>
+
+ChunkDelta::ChunkDelta()
+    : mp_edits(nullptr)
+{}
+
+void ChunkDelta::record(int x, int y, int z, BlockType t)
+{
+    if(mp_edits == nullptr) {
+        mp_edits = std::make_shared<EditMap>();
+    }
+    else if(mp_edits.use_count() > 1) {
+        // Shared with a snapshot: copy before writing
+        mp_edits = std::make_shared<EditMap>(*mp_edits);
+    }
+    (*mp_edits)[static_cast<uint16_t>(y + 256 * x + 4096 * z)] = t;
+}
+
+void ChunkDelta::overlay(const ChunkDelta &newer)
+{
+    if(newer.mp_edits == nullptr || newer.mp_edits == mp_edits) {
+        return;
+    }
+    if(mp_edits == nullptr) {
+        // Nothing of our own to keep: share newer's
+        mp_edits = newer.mp_edits;
+        return;
+    }
+    if(mp_edits.use_count() > 1) {
+        mp_edits = std::make_shared<EditMap>(*mp_edits);
+    }
+    for(auto &kv : *newer.mp_edits) {
+        (*mp_edits)[kv.first] = kv.second;
+    }
+}
+
+void ChunkDelta::applyTo(ChunkBlocks &blocks) const
+{
+    if(mp_edits == nullptr) {
+        return;
+    }
+    for(auto &kv : *mp_edits) {
+        int i = kv.first;
+        blocks.setBlockAtUnchecked((i >> 8) & 15, i & 255, i >> 12, kv.second);
+    }
+}
+
+bool ChunkDelta::empty() const
+{
+    return size() == 0;
+}
+
+std::size_t ChunkDelta::size() const
+{
+    return mp_edits == nullptr ? 0 : mp_edits->size();
+}
+
+std::size_t ChunkDelta::memoryBytes() const
+{
+    // Node plus bucket pointer per edit, approximately
+    return sizeof(ChunkDelta) + size() * (sizeof(void*) * 3 + 4);
+}
+
+std::vector<unsigned char> ChunkDelta::encode() const
+{
+    std::vector<uint16_t> indices;
+    indices.reserve(size());
+    if(mp_edits != nullptr) {
+        for(auto &kv : *mp_edits) {
+            indices.push_back(kv.first);
+        }
+    }
+    std::sort(indices.begin(), indices.end());
+
+    std::vector<unsigned char> out;
+    out.reserve(4 + 3 * indices.size());
+    uint32_t n = static_cast<uint32_t>(indices.size());
+    for(int i = 0; i < 4; ++i) {
+        out.push_back((n >> (8 * i)) & 0xff);
+    }
+    for(uint16_t idx : indices) {
+        out.push_back(idx & 0xff);
+        out.push_back(idx >> 8);
+        out.push_back(mp_edits->at(idx));
+    }
+    return out;
+}
+
+bool ChunkDelta::decode(const unsigned char *data, std::size_t size)
+{
+    mp_edits = nullptr;
+    if(size < 4) {
+        return false;
+    }
+    uint32_t n = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    if(size != 4 + 3 * static_cast<std::size_t>(n)) {
+        return false;
+    }
+    std::shared_ptr<EditMap> edits = std::make_shared<EditMap>();
+    for(uint32_t i = 0; i < n; ++i) {
+        const unsigned char *e = data + 4 + 3 * i;
+        if(e[2] > ICE) {
+            return false;
+        }
+        (*edits)[static_cast<uint16_t>(e[0] | (e[1] << 8))] = static_cast<BlockType>(e[2]);
+    }
+    mp_edits = std::move(edits);
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "chunkblocks.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// The player's edits to one Chunk: every block set through Terrain since
+// the Chunk was first generated, with its latest type. The generator is
+// deterministic for a given world seed, so generate-then-apply rebuilds
+// the edited Chunk exactly, and an unedited Chunk needs no storage at all.
+//
+// Blocks are keyed by their column-order index (y + 256 * x + 4096 * z),
+// independent of the compile-time ChunkLayout.
+//
+// Copies are copy-on-write: copying a delta (e.g. to snapshot it for an
+// autosave) shares the edits, and the first record() afterwards gives the
+// recording side its own copy. A copy may be read on another thread while
+// the original keeps recording on the main thread.
+class ChunkDelta
+{
+public:
+    ChunkDelta();
+
+    void record(int x, int y, int z, BlockType t);
+    // Records every edit in newer on top of this delta's own
+    void overlay(const ChunkDelta &newer);
+    void applyTo(ChunkBlocks &blocks) const;
+
+    bool empty() const;
+    // Number of edited blocks
+    std::size_t size() const;
+    // Roughly what this delta costs in RAM
+    std::size_t memoryBytes() const;
+
+    // Serialized form, used in region files:
+    //   u32           number of edits, little endian
+    //   per edit, in increasing index order:
+    //     u16         block index, little endian
+    //     u8          BlockType
+    std::vector<unsigned char> encode() const;
+    // Replaces this delta's contents with the decoded data. Returns
+    // false (leaving the delta empty) if the data is malformed.
+    bool decode(const unsigned char *data, std::size_t size);
+
+private:
+    using EditMap = std::unordered_map<uint16_t, BlockType>;
+    // Null until the first edit
+    std::shared_ptr<EditMap> mp_edits;
+};
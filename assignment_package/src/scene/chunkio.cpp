@@ -0,0 +1,115 @@
+#include "chunkio.h"
+#include "terrain.h"
+#include <algorithm>
+
+using namespace std::chrono;
+
+// Reads one terrain zone on an I/O thread
+class ChunkIO::ZoneReader : public QRunnable
+{
+private:
+    ChunkIO *mp_io;
+    int64_t m_zoneId;
+    steady_clock::time_point m_requested;
+public:
+    ZoneReader(ChunkIO *io, int64_t zoneId)
+        : mp_io(io), m_zoneId(zoneId), m_requested(steady_clock::now())
+    {}
+
+    void run() override {
+        ZoneLoad load;
+        load.zoneId = m_zoneId;
+        glm::ivec2 coords = toCoords(m_zoneId);
+        load.chunks.resize(16);
+        int i = 0;
+        for(int x = coords.x; x < coords.x + 64; x+=16) {
+            for(int z = coords.y; z < coords.y + 64; z+=16) {
+                load.chunks[i].x = x;
+                load.chunks[i].z = z;
+                i++;
+            }
+        }
+        mp_io->mp_storage->loadBatch(load.chunks);
+        load.latencyMs = duration<double, std::milli>(steady_clock::now() - m_requested).count();
+        mp_io->finish(std::move(load));
+    }
+};
+
+ChunkIO::ChunkIO(WorldStorage *storage, int threads)
+    : mp_storage(storage), m_pool(), m_lock(),
+      m_completed(), m_pending(0), m_stats{}
+{
+    m_pool.setMaxThreadCount(threads);
+}
+
+ChunkIO::~ChunkIO()
+{
+    m_pool.waitForDone();
+}
+
+void ChunkIO::loadZone(int64_t zoneId, int distance)
+{
+    m_lock.lock();
+    m_pending++;
+    m_stats.maxPending = std::max(m_stats.maxPending, m_pending);
+    m_lock.unlock();
+    // Stays above BACKGROUND however far away the zone is
+    int priority = std::max(LOAD - distance, BACKGROUND + 1);
+    m_pool.start(new ZoneReader(this, zoneId), priority);
+}
+
+void ChunkIO::startRead(QRunnable *job, int distance)
+{
+    m_lock.lock();
+    m_stats.otherReads++;
+    m_lock.unlock();
+    m_pool.start(job, std::max(LOAD - distance, BACKGROUND + 1));
+}
+
+void ChunkIO::startBackground(QRunnable *job)
+{
+    m_lock.lock();
+    m_stats.backgroundJobs++;
+    m_lock.unlock();
+    m_pool.start(job, BACKGROUND);
+}
+
+void ChunkIO::finish(ZoneLoad &&load)
+{
+    QMutexLocker locker(&m_lock);
+    m_stats.zonesLoaded++;
+    for(const SavedChunk &saved : load.chunks) {
+        if(saved.hasBlocks || saved.hasEdits) {
+            m_stats.chunksFound++;
+        }
+    }
+    m_stats.totalLatencyMs += load.latencyMs;
+    m_stats.maxLatencyMs = std::max(m_stats.maxLatencyMs, load.latencyMs);
+    m_completed.push_back(std::move(load));
+}
+
+std::vector<ChunkIO::ZoneLoad> ChunkIO::takeCompleted()
+{
+    QMutexLocker locker(&m_lock);
+    std::vector<ZoneLoad> done;
+    done.swap(m_completed);
+    m_pending -= done.size();
+    return done;
+}
+
+std::size_t ChunkIO::pendingLoads() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_pending;
+}
+
+void ChunkIO::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+ChunkIO::Stats ChunkIO::stats() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "worldstorage.h"
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Runs world I/O on its own few threads, so a Chunk read that misses
+// the page cache stalls neither the main thread nor the generation and
+// meshing workers on the global pool.
+//
+// Requests are prioritized: reads for the zone the player stands in
+// start before reads for the edge of the view, and every read starts
+// before background work (autosave SaveWorkers). A request that is
+// already running is never interrupted, so background jobs are kept
+// small. Reads are batched per terrain zone: one request reads all 16
+// Chunks under a single WorldStorage lock. Other reads, such as the
+// mesh cache's, share the same queue through startRead.
+class ChunkIO
+{
+public:
+    // QThreadPool priorities: higher starts first
+    enum Priority {
+        BACKGROUND = 0,
+        // A zone load's priority is this minus its distance in zones
+        LOAD = 64
+    };
+
+    ChunkIO(WorldStorage *storage, int threads);
+    // Waits for every request
+    ~ChunkIO();
+
+    // What was saved for one terrain zone's 16 Chunks
+    struct ZoneLoad {
+        int64_t zoneId;
+        std::vector<SavedChunk> chunks;
+        // From the request to the read finishing
+        double latencyMs;
+    };
+
+    // Reads a terrain zone's Chunks; distance is in zones from the
+    // player, and nearer zones are read first. Collect the result
+    // with takeCompleted().
+    void loadZone(int64_t zoneId, int distance);
+    // Runs a read job (e.g. a MeshCache lookup) on the I/O threads, at
+    // the priority a zone load distance zones away would have
+    void startRead(QRunnable *job, int distance);
+    // Runs job (e.g. a SaveWorker) on the I/O threads, behind any reads
+    void startBackground(QRunnable *job);
+    // Zone loads finished since the last call
+    std::vector<ZoneLoad> takeCompleted();
+    // Zone loads requested but not yet taken
+    std::size_t pendingLoads() const;
+    void waitForDone();
+
+    // Totals since the ChunkIO was created
+    struct Stats {
+        std::size_t zonesLoaded, chunksFound, otherReads, backgroundJobs, maxPending;
+        double totalLatencyMs, maxLatencyMs;
+    };
+    Stats stats() const;
+
+private:
+    class ZoneReader;
+    void finish(ZoneLoad &&load);
+
+    WorldStorage *mp_storage;
+    QThreadPool m_pool;
+    mutable QMutex m_lock;
+    std::vector<ZoneLoad> m_completed;
+    std::size_t m_pending;
+    Stats m_stats;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+
+// Compile-time policies for how a Chunk's 16 x 256 x 16 blocks are
+// ordered in memory. Each policy maps local block coordinates
+// (x and z in [0, 16), y in [0, 256)) to an index in [0, 65536).
+//
+// The default is ColumnLayout, measured through the real code by the
+// "layoutpath" bench (tests/bench) built once per layout. Generation,
+// the PaddedChunkView fill and meshing cost about the same with rows
+// or columns; decoding a saved or evicted Chunk (chunkcodec.h, which
+// walks columns) is about 5x faster with columns. Morton is behind on
+// all of them. The others are kept so the choice can be re-measured
+// (build with DEFINES += CHUNK_VOXEL_LAYOUT=RowLayout, for example).
+
+// The original layout: x varies fastest, then y, then z.
+// Walking a column strides 16 bytes; walking along z strides 4 KB.
+struct RowLayout {
+    static constexpr std::size_t index(int x, int y, int z) {
+        return x + 16 * y + 16 * 256 * z;
+    }
+};
+
+// y varies fastest, so each (x, z) column is 256 contiguous bytes.
+struct ColumnLayout {
+    static constexpr std::size_t index(int x, int y, int z) {
+        return y + 256 * x + 256 * 16 * z;
+    }
+};
+
+// The Chunk is cut into sixteen 16 x 16 x 16 sections stacked along y.
+// Sections are stored bottom to top, and the 4096 blocks inside each are
+// in Morton (Z-order) order, so blocks that are close in 3D are usually
+// close in memory no matter which axis a walk follows.
+struct MortonLayout {
+    // Spreads the low 4 bits of v three bits apart: b3 b2 b1 b0 -> b3..b2..b1..b0
+    static constexpr std::size_t spread(int v) {
+        return (v & 1) | ((v & 2) << 2) | ((v & 4) << 4) | ((v & 8) << 6);
+    }
+    static constexpr std::size_t index(int x, int y, int z) {
+        return (static_cast<std::size_t>(y >> 4) << 12) |
+               spread(x) | (spread(y & 15) << 1) | (spread(z) << 2);
+    }
+};
+
+#ifndef CHUNK_VOXEL_LAYOUT
+#define CHUNK_VOXEL_LAYOUT ColumnLayout
+#endif
+
+using ChunkLayout = CHUNK_VOXEL_LAYOUT;
@@ -0,0 +1,66 @@
+#include "chunkpool.h"
+
+ChunkPool::ChunkPool(std::size_t objectSize, std::size_t objectsPerSlab)
+    : m_slotSize(), m_objectsPerSlab(objectsPerSlab),
+      m_slabs(), m_freeList(), m_neverUsed(0), m_stats(), m_lock()
+{
+    // Round each slot up so every object in a slab stays aligned
+    const std::size_t align = alignof(std::max_align_t);
+    m_slotSize = (objectSize + align - 1) / align * align;
+}
+
+void ChunkPool::addSlab()
+{
+    // new[] storage is aligned for any fundamental type
+    m_slabs.push_back(std::unique_ptr<unsigned char[]>(new unsigned char[m_slotSize * m_objectsPerSlab]));
+    unsigned char *slab = m_slabs.back().get();
+    // Push in reverse so allocation walks the slab front to back
+    for(std::size_t i = m_objectsPerSlab; i > 0; --i) {
+        m_freeList.push_back(slab + (i - 1) * m_slotSize);
+    }
+    m_neverUsed += m_objectsPerSlab;
+    m_stats.slabs++;
+    m_stats.capacity += m_objectsPerSlab;
+    m_stats.bytesReserved += m_slotSize * m_objectsPerSlab;
+}
+
+void* ChunkPool::allocate()
+{
+    QMutexLocker locker(&m_lock);
+    if(m_freeList.empty()) {
+        addSlab();
+    }
+    // Slabs are only added when the free list is empty, so slots that
+    // have never been handed out always sit below released ones.
+    if(m_freeList.size() > m_neverUsed) {
+        m_stats.reuses++;
+    }
+    else {
+        m_neverUsed--;
+    }
+    void *p = m_freeList.back();
+    m_freeList.pop_back();
+
+    m_stats.allocations++;
+    m_stats.inUse++;
+    if(m_stats.inUse > m_stats.peakInUse) {
+        m_stats.peakInUse = m_stats.inUse;
+    }
+    return p;
+}
+
+void ChunkPool::release(void *p)
+{
+    if(p == nullptr) {
+        return;
+    }
+    QMutexLocker locker(&m_lock);
+    m_freeList.push_back(p);
+    m_stats.inUse--;
+}
+
+ChunkPool::Stats ChunkPool::stats() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <QMutex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A slab allocator for fixed-size objects, used to back every Chunk
+// (see Chunk::operator new). Each slab holds several objects
+// side by side, so creating a terrain zone costs at most one real heap
+// allocation instead of sixteen 64 KB ones. Released slots go on a free
+// list and are handed out again, most recently freed first, so evicting
+// and re-creating Chunks over a long session reuses the same memory
+// instead of fragmenting the heap. Slabs are kept until the pool is
+// destroyed.
+class ChunkPool
+{
+public:
+    struct Stats {
+        std::size_t slabs;          // Slabs allocated so far
+        std::size_t capacity;       // Objects those slabs can hold
+        std::size_t inUse;          // Objects currently allocated
+        std::size_t peakInUse;      // Highest inUse seen
+        std::size_t allocations;    // Calls to allocate()
+        std::size_t reuses;         // ...of which were served from the free list
+        std::size_t bytesReserved;  // Total size of all slabs
+    };
+
+    ChunkPool(std::size_t objectSize, std::size_t objectsPerSlab);
+
+    // Returns uninitialized storage for one object
+    void* allocate();
+    // Returns storage obtained from allocate() to the pool
+    void release(void *p);
+
+    Stats stats() const;
+
+private:
+    void addSlab();
+
+    std::size_t m_slotSize;
+    std::size_t m_objectsPerSlab;
+    std::vector<std::unique_ptr<unsigned char[]>> m_slabs;
+    std::vector<void*> m_freeList;
+    // How many slots at the bottom of m_freeList have never been used
+    std::size_t m_neverUsed;
+    Stats m_stats;
+    mutable QMutex m_lock;
+};
@@ -0,0 +1,182 @@
+#include "chunkresidency.h"
+#include "chunkcodec.h"
+#include <chrono>
+
+using namespace std::chrono;
+
+ChunkResidency::ChunkResidency(std::size_t compressedBudgetBytes, std::size_t diskBudgetBytes)
+    : m_compressedBudget(compressedBudgetBytes), m_diskBudget(diskBudgetBytes),
+      m_compressed(), m_compressedOrder(), m_compressedBytes(0),
+      mp_spillFile(nullptr), m_spillEnd(0), m_onDisk(), m_diskBytes(0),
+      m_demotions(0), m_promotions(0), m_dropped(0),
+      m_lastPromotionMs(0), m_totalPromotionMs(0), m_maxPromotionMs(0),
+      m_lock()
+{}
+
+ChunkResidency::~ChunkResidency()
+{
+    if(mp_spillFile != nullptr) {
+        std::fclose(mp_spillFile);
+    }
+}
+
+void ChunkResidency::setBudgets(std::size_t compressedBytes, std::size_t diskBytes)
+{
+    QMutexLocker locker(&m_lock);
+    m_compressedBudget = compressedBytes;
+    m_diskBudget = diskBytes;
+    if(static_cast<std::size_t>(m_spillEnd) > m_diskBudget) {
+        dropDiskTier();
+    }
+    enforceCompressedBudget();
+}
+
+bool ChunkResidency::contains(int64_t key) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_compressed.count(key) != 0 || m_onDisk.count(key) != 0;
+}
+
+void ChunkResidency::demote(int64_t key, const ChunkBlocks &blocks, bool generated)
+{
+    // Encoded before locking; promotions on workers needn't wait for it
+    std::vector<unsigned char> data = encodeChunkBlocks(blocks);
+
+    QMutexLocker locker(&m_lock);
+    // A newer copy replaces any older one
+    forgetLocked(key);
+    CompressedEntry &e = m_compressed[key];
+    m_compressedBytes += data.size();
+    e.data = std::move(data);
+    e.generated = generated;
+    e.order = m_compressedOrder.insert(m_compressedOrder.end(), key);
+    m_demotions++;
+    enforceCompressedBudget();
+}
+
+void ChunkResidency::forget(int64_t key)
+{
+    QMutexLocker locker(&m_lock);
+    forgetLocked(key);
+}
+
+void ChunkResidency::forgetLocked(int64_t key)
+{
+    auto it = m_compressed.find(key);
+    if(it != m_compressed.end()) {
+        m_compressedBytes -= it->second.data.size();
+        m_compressedOrder.erase(it->second.order);
+        m_compressed.erase(it);
+    }
+    auto d = m_onDisk.find(key);
+    if(d != m_onDisk.end()) {
+        m_diskBytes -= d->second.size;
+        m_onDisk.erase(d);
+    }
+}
+
+void ChunkResidency::enforceCompressedBudget()
+{
+    while(m_compressedBytes > m_compressedBudget && !m_compressedOrder.empty()) {
+        spillOldest();
+    }
+}
+
+void ChunkResidency::spillOldest()
+{
+    int64_t key = m_compressedOrder.front();
+    auto it = m_compressed.find(key);
+    CompressedEntry &e = it->second;
+
+    if(static_cast<std::size_t>(m_spillEnd) + e.data.size() > m_diskBudget) {
+        dropDiskTier();
+    }
+    if(mp_spillFile == nullptr) {
+        mp_spillFile = std::tmpfile();
+        m_spillEnd = 0;
+    }
+    bool written = mp_spillFile != nullptr &&
+                   static_cast<std::size_t>(m_spillEnd) + e.data.size() <= m_diskBudget &&
+                   std::fseek(mp_spillFile, m_spillEnd, SEEK_SET) == 0 &&
+                   std::fwrite(e.data.data(), 1, e.data.size(), mp_spillFile) == e.data.size();
+    if(written) {
+        m_onDisk[key] = DiskEntry{m_spillEnd, e.data.size(), e.generated};
+        m_diskBytes += e.data.size();
+        m_spillEnd += static_cast<long>(e.data.size());
+    }
+    else {
+        // No room on disk either: regenerated when it's needed again
+        m_dropped++;
+    }
+    m_compressedBytes -= e.data.size();
+    m_compressedOrder.pop_front();
+    m_compressed.erase(it);
+}
+
+void ChunkResidency::dropDiskTier()
+{
+    m_dropped += m_onDisk.size();
+    m_onDisk.clear();
+    m_diskBytes = 0;
+    if(mp_spillFile != nullptr) {
+        std::fclose(mp_spillFile);
+        mp_spillFile = nullptr;
+    }
+    m_spillEnd = 0;
+}
+
+bool ChunkResidency::promote(int64_t key, ChunkBlocks &out, bool &generated)
+{
+    auto start = steady_clock::now();
+    std::vector<unsigned char> data;
+
+    QMutexLocker locker(&m_lock);
+    auto it = m_compressed.find(key);
+    if(it != m_compressed.end()) {
+        data = std::move(it->second.data);
+        generated = it->second.generated;
+    }
+    else {
+        auto d = m_onDisk.find(key);
+        if(d == m_onDisk.end()) {
+            return false;
+        }
+        data.resize(d->second.size);
+        generated = d->second.generated;
+        if(std::fseek(mp_spillFile, d->second.offset, SEEK_SET) != 0 ||
+                std::fread(data.data(), 1, data.size(), mp_spillFile) != data.size()) {
+            data.clear();
+        }
+    }
+    forgetLocked(key);
+    locker.unlock();
+
+    bool ok = !data.empty() && decodeChunkBlocks(data.data(), data.size(), out);
+
+    double ms = duration<double, std::milli>(steady_clock::now() - start).count();
+    locker.relock();
+    m_lastPromotionMs = ms;
+    m_totalPromotionMs += ms;
+    if(ms > m_maxPromotionMs) {
+        m_maxPromotionMs = ms;
+    }
+    m_promotions++;
+    return ok;
+}
+
+ChunkResidency::Stats ChunkResidency::stats() const
+{
+    QMutexLocker locker(&m_lock);
+    Stats s{};
+    s.compressedChunks = m_compressed.size();
+    s.compressedBytes = m_compressedBytes;
+    s.diskChunks = m_onDisk.size();
+    s.diskBytes = m_diskBytes;
+    s.demotions = m_demotions;
+    s.promotions = m_promotions;
+    s.dropped = m_dropped;
+    s.lastPromotionMs = m_lastPromotionMs;
+    s.avgPromotionMs = m_promotions == 0 ? 0 : m_totalPromotionMs / m_promotions;
+    s.maxPromotionMs = m_maxPromotionMs;
+    return s;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "chunkblocks.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <QMutex>
+
+// Keeps the block data of Chunks that Terrain has evicted from memory.
+// Terrain decides *which* Chunks leave the hot tier (fully instantiated
+// Chunks in its map); this class holds them in two colder tiers:
+//   compressed: run-length encoded (see chunkcodec.h) in RAM
+//   disk:       the same bytes appended to an anonymous temporary file
+// Once the compressed tier grows past its budget, its oldest entries are
+// spilled to disk. promote() brings a Chunk back from whichever tier has
+// it and records how long that took.
+//
+// Both tiers are only caches: Terrain keeps every edit, so an evicted
+// Chunk can always be loaded again the way it was the first time (read
+// from the saved world, or generated from the seed), then patched with
+// its edits, just more slowly. So once the spill file reaches its own
+// budget, the whole disk tier is dropped and those Chunks' zones fall
+// back to being loaded afresh.
+//
+// Chunks are demoted on the main thread and promoted on worker
+// threads, so every call locks.
+class ChunkResidency
+{
+public:
+    struct Stats {
+        std::size_t compressedChunks, compressedBytes;
+        std::size_t diskChunks, diskBytes;
+        // Chunks dropped from the disk tier, to be regenerated
+        std::size_t demotions, promotions, dropped;
+        double lastPromotionMs, avgPromotionMs, maxPromotionMs;
+    };
+
+    ChunkResidency(std::size_t compressedBudgetBytes, std::size_t diskBudgetBytes);
+    ~ChunkResidency();
+
+    ChunkResidency(const ChunkResidency&) = delete;
+    ChunkResidency& operator=(const ChunkResidency&) = delete;
+
+    void setBudgets(std::size_t compressedBytes, std::size_t diskBytes);
+
+    // Is there an evicted copy of the Chunk with this key?
+    bool contains(int64_t key) const;
+    // Stores a compressed copy of blocks under key. generated is handed
+    // back by promote (see Chunk::m_generated).
+    void demote(int64_t key, const ChunkBlocks &blocks, bool generated);
+    // Writes the stored copy into out and forgets it. Returns false if
+    // nothing is stored under key or it couldn't be read back.
+    bool promote(int64_t key, ChunkBlocks &out, bool &generated);
+    // Drops any copy stored under key
+    void forget(int64_t key);
+
+    Stats stats() const;
+
+private:
+    struct CompressedEntry {
+        std::vector<unsigned char> data;
+        bool generated;
+        // Position in m_compressedOrder, for O(1) removal
+        std::list<int64_t>::iterator order;
+    };
+    struct DiskEntry {
+        long offset;
+        std::size_t size;
+        bool generated;
+    };
+
+    // Callers hold m_lock
+    void forgetLocked(int64_t key);
+    void enforceCompressedBudget();
+    void spillOldest();
+    void dropDiskTier();
+
+    std::size_t m_compressedBudget, m_diskBudget;
+    std::unordered_map<int64_t, CompressedEntry> m_compressed;
+    // Oldest demotion at the front
+    std::list<int64_t> m_compressedOrder;
+    std::size_t m_compressedBytes;
+
+    // Created on first spill; deleted by the OS when closed. Space
+    // from promoted entries isn't reused, so the budget applies to
+    // the file's length rather than to the live entries in it.
+    std::FILE *mp_spillFile;
+    long m_spillEnd;
+    std::unordered_map<int64_t, DiskEntry> m_onDisk;
+    std::size_t m_diskBytes;
+
+    std::size_t m_demotions, m_promotions, m_dropped;
+    double m_lastPromotionMs, m_totalPromotionMs, m_maxPromotionMs;
+    mutable QMutex m_lock;
+};
@@ -6,12 +6,21 @@
 #include <QMutex>
 #include <unordered_set>
 #include "chunk.h"
+#include "chunkdelta.h"
+#include "chunkresidency.h"
+#include "editjournal.h"
+#include "meshcache.h"
+#include "chunkio.h"
+#include "smartpointerhelp.h"
+#include <chrono>
 
 
 class FBMWorker: public QRunnable
 {
 private:
     glm::ivec2 terrCoords;
+    // Same seed, same terrain: edits are stored as deltas against it
+    uint32_t m_seed;
     //chunks that have been instantiated but
     //need their BlockType data filled.
     std::vector<Chunk*> m_chunksToFill;
@@ -19,12 +28,33 @@ private:
     std::unordered_set<Chunk*>* m_chunksFilled;
     QMutex* m_chunksFillLock;
 public:
-    FBMWorker(int, int, std::vector<Chunk*>, std::unordered_set<Chunk*>*, QMutex*);
+    FBMWorker(int, int, uint32_t, std::vector<Chunk*>, std::unordered_set<Chunk*>*, QMutex*);
     //fills blocktype data in chunksToFill
     void run() override;
 
 };
 
+// Brings an evicted terrain zone's Chunks back from ChunkResidency.
+// Like an FBMWorker, it fills Chunks that are awaiting their blocks
+// and hands them over through the same set. If any of them can't be
+// promoted, none are handed over; the zone's id goes into
+// zonesLost instead, for Terrain to load the way it would have
+// if the zone had never been evicted.
+class RehydrateWorker: public QRunnable
+{
+private:
+    ChunkResidency* mp_residency;
+    int64_t m_zone;
+    std::vector<Chunk*> m_chunksToFill;
+    std::unordered_set<Chunk*>* m_chunksFilled;
+    std::vector<int64_t>* m_zonesLost;
+    QMutex* m_chunksFillLock;
+public:
+    RehydrateWorker(ChunkResidency*, int64_t, std::vector<Chunk*>,
+                    std::unordered_set<Chunk*>*, std::vector<int64_t>*, QMutex*);
+    void run() override;
+};
+
 class VBOWorker: public QRunnable
 {
 private:
@@ -32,10 +62,66 @@ private:
     std::vector<ChunkVBOData>* m_chunkVBOsCompleted;
     QMutex* m_chunkVBOsLock;
     int time;
+    // Optional; nullptr meshes every Chunk from scratch. Otherwise
+    // lookup is filled by a read started alongside this worker, which
+    // Terrain parks until then (see MeshCache::startWhenAnswered), and
+    // a newly built mesh is written back through io.
+    MeshCache* mp_meshCache;
+    sPtr<MeshCache::Lookup> mp_lookup;
+    ChunkIO* mp_io;
 public:
-    VBOWorker(Chunk*, std::vector<ChunkVBOData>*, QMutex*, int);
+    VBOWorker(Chunk*, std::vector<ChunkVBOData>*, QMutex*, int,
+              MeshCache*, sPtr<MeshCache::Lookup>, ChunkIO*);
     //calls the createVBO functions and everything
     void run() override;
 };
 
+// One edited Chunk, frozen at a tick boundary for an autosave
+struct ChunkSaveSnapshot
+{
+    int x, z;
+    // Copy-on-write: shares the edits until the main thread edits again
+    ChunkDelta edits;
+    // The edits don't include those saved by earlier sessions yet
+    // (see Terrain::m_editsMerged); the SaveWorker reads and merges them
+    bool mergeSaved;
+    // A copy of the whole Chunk, only for instantiated Chunks that
+    // didn't come from the generator (they're saved whole)
+    uPtr<ChunkBlocks> blocks;
+};
+
+// Shared by the SaveWorkers of one autosave
+struct AutosaveBatch
+{
+    EditJournal *journal;
+    WorldStorage *storage;
+    // EditJournal::mark() taken with the snapshots
+    uint64_t mark;
+    std::chrono::steady_clock::time_point start;
+
+    QMutex lock;
+    int workersLeft;
+    std::vector<EditJournal::ChunkWrite> writes;
+    // Chunks that couldn't be serialized. If there are any, the batch
+    // is committed without dropping anything from the journal, and the
+    // main thread queues them for the next autosave.
+    std::vector<glm::ivec2> failed;
+    // Set by the last worker
+    std::size_t bytes;
+    double serializeMs;
+    bool done;
+};
+
+class SaveWorker: public QRunnable
+{
+private:
+    std::vector<ChunkSaveSnapshot> m_snapshots;
+    sPtr<AutosaveBatch> mp_batch;
+public:
+    SaveWorker(std::vector<ChunkSaveSnapshot>&&, sPtr<AutosaveBatch>);
+    //encodes its snapshots; the last worker of the batch
+    //hands all of them to the journal
+    void run() override;
+};
+
 #endif // CHUNKWORKERS_H
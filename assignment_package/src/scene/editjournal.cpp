@@ -0,0 +1,255 @@
+#include "editjournal.h"
+#include "filesync.h"
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+// How long edits accumulate before they're written and synced
+#define JOURNAL_BATCH_MS 200
+
+using namespace std::chrono;
+
+static const char JOURNAL_MAGIC[4] = {'M', 'M', 'J', 'L'};
+static const uint32_t JOURNAL_VERSION = 1;
+static const int RECORD_SIZE = 12;
+
+static uint16_t recordCheck(const unsigned char *p) {
+    uint32_t h = 2166136261u;
+    for(int i = 0; i < 10; ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return static_cast<uint16_t>(h);
+}
+
+static void encodeRecord(const EditJournal::Record &r, unsigned char *p) {
+    for(int i = 0; i < 4; ++i) {
+        p[i] = (static_cast<uint32_t>(r.x) >> (8 * i)) & 0xff;
+        p[4 + i] = (static_cast<uint32_t>(r.z) >> (8 * i)) & 0xff;
+    }
+    p[8] = static_cast<unsigned char>(r.y);
+    p[9] = r.type;
+    uint16_t check = recordCheck(p);
+    p[10] = check & 0xff;
+    p[11] = check >> 8;
+}
+
+EditJournal::EditJournal(const std::string &path, WorldStorage *storage)
+    : m_path(path), mp_storage(storage), mp_file(nullptr),
+      m_written(), m_fileBase(0),
+      m_lock(), m_wake(), m_pending(), m_appended(0), m_checkpoints(),
+      m_stopping(false), m_stats{}
+{}
+
+EditJournal::~EditJournal()
+{
+    m_lock.lock();
+    m_stopping = true;
+    m_wake.wakeAll();
+    m_lock.unlock();
+    wait();
+    if(mp_file != nullptr) {
+        std::fclose(mp_file);
+    }
+}
+
+std::vector<EditJournal::Record> EditJournal::replay()
+{
+    std::vector<Record> records;
+    std::FILE *f = std::fopen(m_path.c_str(), "rb");
+    if(f != nullptr) {
+        unsigned char header[8];
+        if(std::fread(header, 1, 8, f) == 8 &&
+                std::equal(JOURNAL_MAGIC, JOURNAL_MAGIC + 4, header) &&
+                (header[4] | (header[5] << 8) | (header[6] << 16) |
+                 (static_cast<uint32_t>(header[7]) << 24)) == JOURNAL_VERSION) {
+            unsigned char p[RECORD_SIZE];
+            while(std::fread(p, 1, RECORD_SIZE, f) == RECORD_SIZE &&
+                  (p[10] | (p[11] << 8)) == recordCheck(p) && p[9] <= ICE) {
+                Record r;
+                r.x = static_cast<int>(p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+                r.z = static_cast<int>(p[4] | (p[5] << 8) | (p[6] << 16) | (static_cast<uint32_t>(p[7]) << 24));
+                r.y = p[8];
+                r.type = static_cast<BlockType>(p[9]);
+                records.push_back(r);
+            }
+        }
+        std::fclose(f);
+    }
+
+    // Start a clean journal holding just the replayed edits, so a torn
+    // tail from the crash can't hide later appends
+    rewrite(records);
+    m_written = records;
+    m_appended = records.size();
+    return records;
+}
+
+bool EditJournal::rewrite(const std::vector<Record> &records)
+{
+    // The journal is replaced only once its successor is complete and
+    // on disk, so a crash at any point leaves one or the other intact
+    std::string tmpPath = m_path + ".tmp";
+    std::FILE *f = std::fopen(tmpPath.c_str(), "w+b");
+    if(f == nullptr) {
+        std::cout << "Could not write edit journal " << tmpPath << std::endl;
+        return false;
+    }
+    unsigned char header[8];
+    std::copy(JOURNAL_MAGIC, JOURNAL_MAGIC + 4, header);
+    for(int i = 0; i < 4; ++i) {
+        header[4 + i] = (JOURNAL_VERSION >> (8 * i)) & 0xff;
+    }
+    std::vector<unsigned char> bytes(records.size() * RECORD_SIZE);
+    for(std::size_t i = 0; i < records.size(); ++i) {
+        encodeRecord(records[i], &bytes[i * RECORD_SIZE]);
+    }
+    bool ok = std::fwrite(header, 1, 8, f) == 8 &&
+              std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size() &&
+              syncFile(f);
+
+    // Windows won't replace a file that is still open
+    bool wasOpen = mp_file != nullptr;
+    if(ok && wasOpen) {
+        std::fclose(mp_file);
+        mp_file = nullptr;
+    }
+    ok = ok && replaceFile(tmpPath, m_path);
+    if(!ok) {
+        std::fclose(f);
+        std::remove(tmpPath.c_str());
+        std::cout << "Could not replace edit journal " << m_path << std::endl;
+        if(wasOpen && mp_file == nullptr) {
+            // The old journal is intact; keep appending to it
+            mp_file = std::fopen(m_path.c_str(), "ab");
+        }
+        return false;
+    }
+    syncParentDirectory(m_path);
+    mp_file = f;
+    return std::fseek(mp_file, 0, SEEK_END) == 0;
+}
+
+void EditJournal::append(int x, int y, int z, BlockType t)
+{
+    QMutexLocker locker(&m_lock);
+    m_pending.push_back(Record{x, y, z, t});
+    m_appended++;
+}
+
+uint64_t EditJournal::mark()
+{
+    QMutexLocker locker(&m_lock);
+    return m_appended;
+}
+
+void EditJournal::commit(uint64_t mark, std::vector<ChunkWrite> &&writes)
+{
+    QMutexLocker locker(&m_lock);
+    m_checkpoints.push_back(Checkpoint{mark, std::move(writes)});
+    m_wake.wakeAll();
+}
+
+void EditJournal::run()
+{
+    std::vector<Record> batch;
+    std::vector<Checkpoint> checkpoints;
+    while(true) {
+        bool stopping;
+        m_lock.lock();
+        if(!m_stopping && m_checkpoints.empty()) {
+            m_wake.wait(&m_lock, JOURNAL_BATCH_MS);
+        }
+        batch.swap(m_pending);
+        checkpoints.swap(m_checkpoints);
+        stopping = m_stopping;
+        m_lock.unlock();
+
+        // Records first, so that a checkpoint can carry the ones
+        // appended after its mark over to the fresh journal
+        if(!batch.empty()) {
+            writeBatch(batch);
+            batch.clear();
+        }
+        for(const Checkpoint &c : checkpoints) {
+            writeCheckpoint(c.mark, c.writes);
+        }
+        checkpoints.clear();
+        if(stopping) {
+            return;
+        }
+    }
+}
+
+bool EditJournal::writeRecords(const std::vector<Record> &records)
+{
+    std::vector<unsigned char> bytes(records.size() * RECORD_SIZE);
+    for(std::size_t i = 0; i < records.size(); ++i) {
+        encodeRecord(records[i], &bytes[i * RECORD_SIZE]);
+    }
+    return std::fwrite(bytes.data(), 1, bytes.size(), mp_file) == bytes.size() && syncFile(mp_file);
+}
+
+void EditJournal::writeBatch(const std::vector<Record> &records)
+{
+    if(records.empty()) {
+        return;
+    }
+    // Kept even if they can't be written now, so the next
+    // successful rewrite() still includes them
+    m_written.insert(m_written.end(), records.begin(), records.end());
+    if(mp_file == nullptr) {
+        return;
+    }
+    auto start = steady_clock::now();
+    if(!writeRecords(records)) {
+        std::cout << "Could not write edit journal " << m_path << std::endl;
+    }
+    double ms = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    QMutexLocker locker(&m_lock);
+    m_stats.batches++;
+    m_stats.recordsWritten += records.size();
+    m_stats.lastSyncMs = ms;
+    if(ms > m_stats.maxSyncMs) {
+        m_stats.maxSyncMs = ms;
+    }
+}
+
+void EditJournal::writeCheckpoint(uint64_t mark, const std::vector<ChunkWrite> &writes)
+{
+    auto start = steady_clock::now();
+    bool ok = true;
+    std::size_t bytes = 0;
+    for(const ChunkWrite &w : writes) {
+        ok = mp_storage->writePayload(w.x, w.z, w.kind, w.body) && ok;
+        bytes += w.body.size();
+    }
+    ok = mp_storage->sync() && ok;
+
+    // Keep the whole journal if anything failed to reach the region files,
+    // or might not survive a crash there
+    if(ok && mark > m_fileBase) {
+        std::size_t covered = std::min<std::size_t>(mark - m_fileBase, m_written.size());
+        std::vector<Record> kept(m_written.begin() + covered, m_written.end());
+        if(rewrite(kept)) {
+            m_written.swap(kept);
+            m_fileBase += covered;
+        }
+    }
+    else if(!ok) {
+        std::cout << "Checkpoint incomplete, keeping edit journal " << m_path << std::endl;
+    }
+    double ms = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    QMutexLocker locker(&m_lock);
+    m_stats.checkpoints++;
+    m_stats.lastCheckpointChunks = writes.size();
+    m_stats.lastCheckpointBytes = bytes;
+    m_stats.lastCheckpointMs = ms;
+}
+
+EditJournal::Stats EditJournal::stats() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "chunkblocks.h"
+#include "worldstorage.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+// An append-only, write-ahead log of block edits, kept next to the
+// region files as <world>/edits.journal. Every edit is appended on the
+// main thread (just a push under a lock); a background thread writes
+// whatever has accumulated every JOURNAL_BATCH_MS and fsyncs it, so a
+// crash loses at most the last batch and the main thread never waits
+// on the disk.
+//
+// Periodically Terrain checkpoints. It calls mark(), snapshots every
+// Chunk edited since the last checkpoint, and (possibly much later, from
+// another thread) hands the encoded payloads to commit() along with the
+// mark. The background thread writes them into the region files, syncs
+// those, and only then rewrites the journal without the records from
+// before the mark. The rewrite goes to <world>/edits.journal.tmp, which
+// is synced and then renamed over the journal, so a crash never leaves
+// less than one complete journal. On startup, replay() returns whatever the journal
+// holds, i.e. every edit made since the last completed checkpoint.
+//
+// Format (little endian): the 8 byte header "MMJL" + u32 version (1),
+// then 12 byte records:
+//   i32 x, i32 z    world-space block coordinates
+//   u8 y, u8 type
+//   u16 check       low 16 bits of an FNV-1a hash of the first 10 bytes
+// A torn or corrupt record ends replay; everything before it is used.
+class EditJournal : public QThread
+{
+public:
+    struct Record {
+        int x, y, z;
+        BlockType type;
+    };
+    // One Chunk's payload for a checkpoint
+    struct ChunkWrite {
+        int x, z;
+        WorldStorage::PayloadKind kind;
+        std::vector<unsigned char> body;
+    };
+    struct Stats {
+        std::size_t batches, recordsWritten, checkpoints;
+        double lastSyncMs, maxSyncMs;
+        // Region writes and syncs of the last checkpoint
+        std::size_t lastCheckpointChunks, lastCheckpointBytes;
+        double lastCheckpointMs;
+    };
+
+    // storage must outlive the journal
+    EditJournal(const std::string &path, WorldStorage *storage);
+    // Writes anything still pending, then stops the thread
+    ~EditJournal();
+
+    // The records left by earlier sessions. Call once, before start().
+    std::vector<Record> replay();
+
+    // Main thread only
+    void append(int x, int y, int z, BlockType t);
+    // Identifies the edits appended so far
+    uint64_t mark();
+    // Any thread. The payloads must cover every edit appended before
+    // mark was taken; those edits are dropped from the journal once
+    // the payloads are safely in the region files. A mark of 0 writes
+    // the payloads but drops nothing.
+    void commit(uint64_t mark, std::vector<ChunkWrite> &&writes);
+
+    Stats stats() const;
+
+protected:
+    void run() override;
+
+private:
+    // Atomically replaces the journal with one holding just records,
+    // and appends to that from then on. On failure the old journal
+    // stays in place, and in use.
+    bool rewrite(const std::vector<Record> &records);
+    bool writeRecords(const std::vector<Record> &records);
+    void writeBatch(const std::vector<Record> &records);
+    void writeCheckpoint(uint64_t mark, const std::vector<ChunkWrite> &writes);
+
+    struct Checkpoint {
+        uint64_t mark;
+        std::vector<ChunkWrite> writes;
+    };
+
+    std::string m_path;
+    WorldStorage *mp_storage;
+    // Only touched by replay() and then the background thread: the
+    // file, the records in it, and the sequence number of the first
+    std::FILE *mp_file;
+    std::vector<Record> m_written;
+    uint64_t m_fileBase;
+
+    mutable QMutex m_lock;
+    QWaitCondition m_wake;
+    std::vector<Record> m_pending;
+    // Records ever appended, including replayed ones
+    uint64_t m_appended;
+    std::vector<Checkpoint> m_checkpoints;
+    bool m_stopping;
+    Stats m_stats;
+};
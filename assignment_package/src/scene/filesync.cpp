@@ -0,0 +1,51 @@
+#include "filesync.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool syncFile(std::FILE *f)
+{
+    if(std::fflush(f) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+bool replaceFile(const std::string &from, const std::string &to)
+{
+#ifdef _WIN32
+    // rename() refuses to overwrite an existing file on Windows
+    return MoveFileExA(from.c_str(), to.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool syncParentDirectory(const std::string &path)
+{
+#ifdef _WIN32
+    // NTFS journals the rename itself (see MOVEFILE_WRITE_THROUGH)
+    (void)path;
+    return true;
+#else
+    std::size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." :
+                      slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdio>
+#include <string>
+
+// Helpers for files that have to survive a crash or power loss: the
+// region files and the edit journal. Each returns false on failure.
+
+// Flushes stdio's buffers, then waits until the OS has f on stable storage
+bool syncFile(std::FILE *f);
+
+// Atomically replaces the file at to with the one at from, which must
+// already be synced. If this fails, to is left as it was.
+bool replaceFile(const std::string &from, const std::string &to);
+
+// Makes a rename or creation of the file at path durable by syncing
+// the directory holding it. A no-op where directories can't be synced.
+bool syncParentDirectory(const std::string &path);
@@ -0,0 +1,73 @@
+#include "frustum.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+Frustum::Frustum(const glm::mat4 &viewProj)
+{
+    // glm is column-major, so row r of the matrix is viewProj[0..3][r].
+    // Each clip plane is the w row plus or minus one of the others:
+    // left, right, bottom, top, near, far
+    for(int i = 0; i < 6; i++) {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.f : -1.f;
+        glm::vec4 p(viewProj[0][3] + sign * viewProj[0][row],
+                    viewProj[1][3] + sign * viewProj[1][row],
+                    viewProj[2][3] + sign * viewProj[2][row],
+                    viewProj[3][3] + sign * viewProj[3][row]);
+        // Normalizing isn't needed for a yes/no test, but keeps the
+        // planes' distances in blocks for anyone reading them
+        float len = glm::length(glm::vec3(p));
+        if(len > 0.f) {
+            p /= len;
+        }
+        m_a[i] = p.x;
+        m_b[i] = p.y;
+        m_c[i] = p.z;
+        m_d[i] = p.w;
+    }
+    for(int i = 6; i < PLANE_SLOTS; i++) {
+        m_a[i] = m_b[i] = m_c[i] = 0.f;
+        m_d[i] = 1.f;
+    }
+}
+
+// A box is outside a plane when even its corner furthest along the
+// plane's normal is behind it. Per axis, that corner's term is the
+// larger of the normal times the box's min and times its max, which
+// saves picking the corner with branches.
+bool Frustum::intersects(glm::vec3 min, glm::vec3 max) const
+{
+#ifdef FRUSTUM_SSE
+    const __m128 minX = _mm_set1_ps(min.x), maxX = _mm_set1_ps(max.x);
+    const __m128 minY = _mm_set1_ps(min.y), maxY = _mm_set1_ps(max.y);
+    const __m128 minZ = _mm_set1_ps(min.z), maxZ = _mm_set1_ps(max.z);
+    const __m128 zero = _mm_setzero_ps();
+    for(int i = 0; i < PLANE_SLOTS; i += 4) {
+        __m128 a = _mm_load_ps(m_a + i);
+        __m128 b = _mm_load_ps(m_b + i);
+        __m128 c = _mm_load_ps(m_c + i);
+        __m128 dist = _mm_load_ps(m_d + i);
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(a, minX), _mm_mul_ps(a, maxX)));
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(b, minY), _mm_mul_ps(b, maxY)));
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(c, minZ), _mm_mul_ps(c, maxZ)));
+        if(_mm_movemask_ps(_mm_cmplt_ps(dist, zero)) != 0) {
+            return false;
+        }
+    }
+    return true;
+#else
+    for(int i = 0; i < 6; i++) {
+        float dist = m_d[i]
+                + glm::max(m_a[i] * min.x, m_a[i] * max.x)
+                + glm::max(m_b[i] * min.y, m_b[i] * max.y)
+                + glm::max(m_c[i] * min.z, m_c[i] * max.z);
+        if(dist < 0.f) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "glm_includes.h"
+
+// The six planes of a camera's view volume, for throwing away geometry
+// that can't be on screen before it's drawn. Built from the same
+// view-projection matrix the shaders get, so it always agrees with what
+// the camera sees. Pure math; needs no OpenGL context.
+class Frustum
+{
+public:
+    // Extracts the planes of viewProj's clip volume (-w <= x,y,z <= w)
+    Frustum(const glm::mat4 &viewProj);
+
+    // Whether any part of the axis-aligned box [min, max] may be inside.
+    // Conservative: a box near a corner of the frustum can pass without
+    // actually touching it, but a box that is inside never fails.
+    bool intersects(glm::vec3 min, glm::vec3 max) const;
+
+private:
+    // Plane i is m_a[i] x + m_b[i] y + m_c[i] z + m_d[i] >= 0 on the
+    // inside. Laid out plane-by-component so four planes can be tested
+    // at once; the last two slots are padding that everything is inside.
+    static constexpr int PLANE_SLOTS = 8;
+    alignas(16) float m_a[PLANE_SLOTS];
+    alignas(16) float m_b[PLANE_SLOTS];
+    alignas(16) float m_c[PLANE_SLOTS];
+    alignas(16) float m_d[PLANE_SLOTS];
+};
@@ -0,0 +1,226 @@
+#include "gpuarena.h"
+#include "shaderprogram.h"
+#include <algorithm>
+
+// Default page size: 64 MB of interleaved vertices and the 1.5 indices
+// per vertex that quads need, room for a few hundred surface Chunks
+#define ARENA_PAGE_VERTICES (1u << 20)
+#define ARENA_PAGE_INDICES (3u << 19)
+#define ARENA_VERTEX_BYTES (4 * sizeof(glm::vec4))
+
+GpuArena::Allocation::Allocation()
+    : page(-1), firstVertex(0), vertexCount(0), firstIndex(0), indexCount(0)
+{}
+
+GpuArena::Page::Page(uint32_t vertexCapacity, uint32_t indexCapacity)
+    : vbo(0), ibo(0), vao(0), layoutFor(nullptr),
+      vertices(vertexCapacity), indices(indexCapacity),
+      counts(), offsets(), baseVertices()
+{}
+
+GpuArena::GpuArena(OpenGLContext *context)
+    : mp_context(context), m_pages(), m_queueOrder(),
+      m_resolved(false), mp_multiDraw(nullptr),
+      m_drawCalls(0), m_meshesDrawn(0)
+{}
+
+GpuArena::~GpuArena()
+{
+    for(uPtr<Page> &p : m_pages) {
+        mp_context->glDeleteBuffers(1, &p->vbo);
+        mp_context->glDeleteBuffers(1, &p->ibo);
+        if(p->vao != 0) {
+            mp_context->glDeleteVertexArrays(1, &p->vao);
+        }
+    }
+    // GL unbinds a bound VAO that is deleted
+    ShaderProgram::forgetBoundState();
+}
+
+int GpuArena::addPage(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    uPtr<Page> p = mkU<Page>(vertexCapacity, indexCapacity);
+    mp_context->glGenBuffers(1, &p->vbo);
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, p->vbo);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, vertexCapacity * ARENA_VERTEX_BYTES, nullptr, GL_DYNAMIC_DRAW);
+    mp_context->glGenBuffers(1, &p->ibo);
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, p->ibo);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    m_pages.push_back(std::move(p));
+    return static_cast<int>(m_pages.size()) - 1;
+}
+
+void GpuArena::upload(Allocation &a, const std::vector<glm::vec4> &interleaved,
+                      const std::vector<GLuint> &indices)
+{
+    release(a);
+    uint32_t vertexCount = static_cast<uint32_t>(interleaved.size() / 4);
+    uint32_t indexCount = static_cast<uint32_t>(indices.size());
+    if(vertexCount == 0 || indexCount == 0) {
+        return;
+    }
+
+    //first page with room for both halves of the mesh
+    int page = -1;
+    uint32_t firstVertex = RangeAllocator::NONE, firstIndex = RangeAllocator::NONE;
+    for(std::size_t i = 0; i < m_pages.size() && page < 0; i++) {
+        Page &p = *m_pages[i];
+        firstVertex = p.vertices.allocate(vertexCount);
+        if(firstVertex == RangeAllocator::NONE) {
+            continue;
+        }
+        firstIndex = p.indices.allocate(indexCount);
+        if(firstIndex == RangeAllocator::NONE) {
+            p.vertices.free(firstVertex, vertexCount);
+            continue;
+        }
+        page = static_cast<int>(i);
+    }
+    if(page < 0) {
+        //a mesh bigger than a page gets a page of its own
+        page = addPage(std::max(ARENA_PAGE_VERTICES, vertexCount),
+                       std::max(ARENA_PAGE_INDICES, indexCount));
+        firstVertex = m_pages[page]->vertices.allocate(vertexCount);
+        firstIndex = m_pages[page]->indices.allocate(indexCount);
+    }
+
+    Page &p = *m_pages[page];
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, p.vbo);
+    mp_context->glBufferSubData(GL_ARRAY_BUFFER, firstVertex * ARENA_VERTEX_BYTES,
+                                vertexCount * ARENA_VERTEX_BYTES, interleaved.data());
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, p.ibo);
+    mp_context->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, firstIndex * sizeof(GLuint),
+                                indexCount * sizeof(GLuint), indices.data());
+    a.page = page;
+    a.firstVertex = firstVertex;
+    a.vertexCount = vertexCount;
+    a.firstIndex = firstIndex;
+    a.indexCount = indexCount;
+}
+
+void GpuArena::release(Allocation &a)
+{
+    if(a.page < 0) {
+        return;
+    }
+    Page &p = *m_pages[a.page];
+    p.vertices.free(a.firstVertex, a.vertexCount);
+    p.indices.free(a.firstIndex, a.indexCount);
+    a = Allocation();
+}
+
+void GpuArena::queue(const Allocation &a, uint32_t firstIndex, uint32_t indexCount)
+{
+    if(a.page < 0 || indexCount == 0) {
+        return;
+    }
+    Page &p = *m_pages[a.page];
+    p.counts.push_back(static_cast<GLsizei>(indexCount));
+    p.offsets.push_back(reinterpret_cast<const void*>(
+                            static_cast<std::size_t>(a.firstIndex + firstIndex) * sizeof(GLuint)));
+    p.baseVertices.push_back(static_cast<GLint>(a.firstVertex));
+    m_queueOrder.push_back(a.page);
+}
+
+void GpuArena::queue(const Allocation &a)
+{
+    queue(a, 0, a.indexCount);
+}
+
+void GpuArena::drawBatch(Page &p, ShaderProgram &prog, std::size_t first, std::size_t count)
+{
+    if(count == 0) {
+        return;
+    }
+    if(p.vao == 0) {
+        mp_context->glGenVertexArrays(1, &p.vao);
+    }
+    ShaderProgram::bindVertexArray(mp_context, p.vao);
+    if(p.layoutFor != &prog) {
+        //the index buffer binding is part of the VAO too
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, p.vbo);
+        prog.enableInterleavedAttribs();
+        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, p.ibo);
+        p.layoutFor = &prog;
+    }
+    GLsizei n = static_cast<GLsizei>(count);
+    if(mp_multiDraw != nullptr) {
+        mp_multiDraw(GL_TRIANGLES, p.counts.data() + first, GL_UNSIGNED_INT,
+                     p.offsets.data() + first, n, p.baseVertices.data() + first);
+        m_drawCalls++;
+    }
+    else {
+        for(std::size_t i = first; i < first + count; i++) {
+            mp_context->glDrawElementsBaseVertex(GL_TRIANGLES, p.counts[i], GL_UNSIGNED_INT,
+                                                 p.offsets[i], p.baseVertices[i]);
+        }
+        m_drawCalls += count;
+    }
+    m_meshesDrawn += count;
+}
+
+void GpuArena::drawQueued(ShaderProgram &prog, bool keepOrder)
+{
+    if(!m_resolved) {
+        // Desktop GL 3.2; not part of the GL ES functions Qt wraps
+        mp_multiDraw = reinterpret_cast<MultiDrawElementsBaseVertex>(
+                    mp_context->context()->getProcAddress("glMultiDrawElementsBaseVertex"));
+        m_resolved = true;
+    }
+
+    m_drawCalls = m_meshesDrawn = 0;
+    // Tracked, rather than asked of GL, which would stall the pipeline
+    GLuint previousVao = ShaderProgram::boundVertexArray();
+    prog.useMe();
+    if(keepOrder) {
+        //each run of meshes from the same page is one batch
+        std::vector<std::size_t> next(m_pages.size(), 0);
+        std::size_t i = 0;
+        while(i < m_queueOrder.size()) {
+            int page = m_queueOrder[i];
+            std::size_t run = 1;
+            while(i + run < m_queueOrder.size() && m_queueOrder[i + run] == page) {
+                run++;
+            }
+            drawBatch(*m_pages[page], prog, next[page], run);
+            next[page] += run;
+            i += run;
+        }
+    }
+    else {
+        for(uPtr<Page> &page : m_pages) {
+            drawBatch(*page, prog, 0, page->counts.size());
+        }
+    }
+    for(uPtr<Page> &page : m_pages) {
+        page->counts.clear();
+        page->offsets.clear();
+        page->baseVertices.clear();
+    }
+    m_queueOrder.clear();
+    if(previousVao != ShaderProgram::UNKNOWN_BINDING) {
+        ShaderProgram::bindVertexArray(mp_context, previousVao);
+    }
+    mp_context->printGLErrorLog();
+}
+
+GpuArena::Stats GpuArena::stats() const
+{
+    Stats s{};
+    s.pages = m_pages.size();
+    std::size_t largest = 0, free = 0;
+    for(const uPtr<Page> &page : m_pages) {
+        const Page &p = *page;
+        s.vertexBytes += p.vertices.capacity() * ARENA_VERTEX_BYTES;
+        s.vertexBytesUsed += p.vertices.used() * ARENA_VERTEX_BYTES;
+        s.indexBytes += p.indices.capacity() * sizeof(GLuint);
+        s.indexBytesUsed += p.indices.used() * sizeof(GLuint);
+        largest += p.vertices.largestFree();
+        free += p.vertices.capacity() - p.vertices.used();
+    }
+    s.fragmentation = free == 0 ? 0.f : 1.f - static_cast<float>(largest) / free;
+    s.drawCalls = m_drawCalls;
+    s.meshesDrawn = m_meshesDrawn;
+    s.multiDraw = mp_multiDraw != nullptr;
+    return s;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "openglcontext.h"
+#include "glm_includes.h"
+#include "rangeallocator.h"
+#include "smartpointerhelp.h"
+#include <vector>
+
+class ShaderProgram;
+
+// Every Chunk mesh lives in a few large GPU buffers instead of a pair
+// of buffers of its own. Each page is one vertex buffer and one index
+// buffer, carved up with a RangeAllocator each; a new page is only
+// created when no existing page has room for a mesh. Meshes keep their
+// Chunk-relative indices and are drawn with a base vertex, so a whole
+// page of Chunks goes out in a single glMultiDrawElementsBaseVertex
+// call where the driver has it (one glDrawElementsBaseVertex per Chunk
+// otherwise). Each page also has a vertex array object holding its
+// vertex layout and index buffer, so drawing a page binds one VAO
+// instead of respecifying every attribute.
+//
+// Main thread only, with the GL context current.
+class GpuArena
+{
+public:
+    // Where one mesh sits in the arena; page is -1 for no mesh
+    struct Allocation {
+        int page;
+        uint32_t firstVertex, vertexCount;
+        uint32_t firstIndex, indexCount;
+        Allocation();
+    };
+
+    GpuArena(OpenGLContext *context);
+    // Deletes every page's buffers
+    ~GpuArena();
+    GpuArena(const GpuArena&) = delete;
+    GpuArena& operator=(const GpuArena&) = delete;
+
+    // Replaces a's mesh with the interleaved vertices (4 vec4s each)
+    // and indices given, freeing the old one
+    void upload(Allocation &a, const std::vector<glm::vec4> &interleaved,
+                const std::vector<GLuint> &indices);
+    void release(Allocation &a);
+
+    // Adds indexCount indices of a's mesh, from its first + firstIndex,
+    // to the next drawQueued
+    void queue(const Allocation &a, uint32_t firstIndex, uint32_t indexCount);
+    void queue(const Allocation &a);
+    // Draws everything queued with prog and empties the queue.
+    // Meshes are drawn in the order queued within each page, one page
+    // after another; keepOrder draws them exactly in the order queued
+    // instead, for blending, at the cost of a batch per run of meshes
+    // from the same page. Leaves the vertex array that was bound
+    // before bound again.
+    void drawQueued(ShaderProgram &prog, bool keepOrder = false);
+
+    struct Stats {
+        std::size_t pages;
+        std::size_t vertexBytes, vertexBytesUsed;
+        std::size_t indexBytes, indexBytesUsed;
+        // RangeAllocator::fragmentation over the free vertex space of
+        // all pages together
+        float fragmentation;
+        // Draw calls and meshes in the last drawQueued, and whether
+        // the driver had glMultiDrawElementsBaseVertex (known once
+        // the arena has been drawn from)
+        std::size_t drawCalls, meshesDrawn;
+        bool multiDraw;
+    };
+    Stats stats() const;
+
+private:
+    typedef void (QOPENGLF_APIENTRYP MultiDrawElementsBaseVertex)(
+            GLenum mode, const GLsizei *count, GLenum type, const void *const *indices,
+            GLsizei drawcount, const GLint *basevertex);
+
+    struct Page {
+        GLuint vbo, ibo;
+        // Set up for the attribute locations of layoutFor, the last
+        // ShaderProgram that drew this page
+        GLuint vao;
+        const ShaderProgram *layoutFor;
+        RangeAllocator vertices, indices;
+        // What's queued to draw from this page
+        std::vector<GLsizei> counts;
+        std::vector<const void*> offsets;
+        std::vector<GLint> baseVertices;
+        Page(uint32_t vertexCapacity, uint32_t indexCapacity);
+    };
+    int addPage(uint32_t vertexCapacity, uint32_t indexCapacity);
+    // Draws count of p's queued meshes starting at first
+    void drawBatch(Page &p, ShaderProgram &prog, std::size_t first, std::size_t count);
+
+    OpenGLContext *mp_context;
+    std::vector<uPtr<Page>> m_pages;
+    // The page of every queued mesh, in the order queued
+    std::vector<int> m_queueOrder;
+    // Looked up the first time the arena is drawn from
+    bool m_resolved;
+    MultiDrawElementsBaseVertex mp_multiDraw;
+    std::size_t m_drawCalls, m_meshesDrawn;
+};
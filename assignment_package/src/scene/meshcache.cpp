@@ -0,0 +1,328 @@
+#include "meshcache.h"
+#include "chunk.h"
+#include "paddedchunkview.h"
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <QThreadPool>
+
+namespace fs = std::filesystem;
+
+// u32 version, u64 hash, u32 x 2 sizes, i32 x 3 counts, i32 x 2 heights
+#define MESH_HEADER_SIZE 40
+// Region files kept open at once; see WorldStorage's MAX_OPEN_REGIONS
+#define MAX_OPEN_MESH_REGIONS 64
+// Abandoned bytes past which a region file is compacted when closed
+#define MESH_REGION_MAX_WASTE (8l << 20)
+// How long a VBOWorker stays parked on its lookup. Long enough for a
+// read queued behind a few zone loads, short enough that a stalled
+// disk only delays meshing a little.
+#define MESH_LOOKUP_WAIT_MS 250
+
+// Same region grid as WorldStorage
+static int regionIndex(int v) {
+    return v >> 9;
+}
+static int localIndex(int v) {
+    return (v >> 4) & (RegionFile::CHUNKS_PER_SIDE - 1);
+}
+
+template<typename T>
+static void put(std::vector<unsigned char> &out, std::size_t &at, const T &v) {
+    std::memcpy(out.data() + at, &v, sizeof(T));
+    at += sizeof(T);
+}
+template<typename T>
+static T get(const unsigned char *&in) {
+    T v;
+    std::memcpy(&v, in, sizeof(T));
+    in += sizeof(T);
+    return v;
+}
+
+MeshCache::MeshCache(const std::string &worldDir)
+    : m_dir((fs::path(worldDir) / "meshes").string()),
+      m_regions(), m_regionOrder(), m_waiting(), m_stats{}, m_lock()
+{
+    std::error_code err;
+    fs::create_directories(m_dir, err);
+    if(err) {
+        std::cout << "Could not create mesh cache " << m_dir << ": " << err.message() << std::endl;
+    }
+}
+
+MeshCache::~MeshCache()
+{
+    for(auto &kv : m_regions) {
+        closeRegion(*kv.second.file);
+    }
+}
+
+void MeshCache::closeRegion(RegionFile &r)
+{
+    r.flush();
+    // Remeshed Chunks leave their old meshes behind
+    if(r.wastedBytes() > MESH_REGION_MAX_WASTE) {
+        r.compact();
+    }
+}
+
+uint64_t MeshCache::hashView(const PaddedChunkView &view)
+{
+    static_assert(PaddedChunkView::VOLUME % 8 == 0, "view hashed 8 blocks at a time");
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(view.data());
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ MESHER_VERSION;
+    for(int i = 0; i < PaddedChunkView::VOLUME; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, bytes + i, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+RegionFile* MeshCache::regionFor(int x, int z, bool create)
+{
+    int rx = regionIndex(x), rz = regionIndex(z);
+    int64_t key = (static_cast<int64_t>(rx) << 32) | static_cast<uint32_t>(rz);
+    auto it = m_regions.find(key);
+    if(it != m_regions.end()) {
+        // Now the most recently used
+        m_regionOrder.splice(m_regionOrder.end(), m_regionOrder, it->second.order);
+        return it->second.file.get();
+    }
+    std::string path = (fs::path(m_dir) /
+                        ("r." + std::to_string(rx) + "." + std::to_string(rz) + ".mmr")).string();
+    if(!create && !fs::exists(path)) {
+        return nullptr;
+    }
+    uPtr<RegionFile> region = mkU<RegionFile>(path);
+    if(!region->isOpen()) {
+        return nullptr;
+    }
+    if(m_regions.size() >= MAX_OPEN_MESH_REGIONS) {
+        auto oldest = m_regions.find(m_regionOrder.front());
+        closeRegion(*oldest->second.file);
+        m_regionOrder.pop_front();
+        m_regions.erase(oldest);
+        m_stats.regionsClosed++;
+    }
+    RegionFile *r = region.get();
+    OpenRegion &open = m_regions[key];
+    open.file = std::move(region);
+    open.order = m_regionOrder.insert(m_regionOrder.end(), key);
+    return r;
+}
+
+class MeshCache::ReadJob : public QRunnable
+{
+private:
+    MeshCache *mp_cache;
+    int m_x, m_z;
+    sPtr<Lookup> mp_lookup;
+public:
+    ReadJob(MeshCache *cache, int x, int z, sPtr<Lookup> lookup)
+        : mp_cache(cache), m_x(x), m_z(z), mp_lookup(lookup)
+    {}
+
+    void run() override {
+        std::vector<unsigned char> payload;
+        bool found = mp_cache->read(m_x, m_z, payload);
+        QMutexLocker locker(&mp_lookup->lock);
+        mp_lookup->payload.swap(payload);
+        mp_lookup->found = found;
+        mp_lookup->answered = true;
+        QRunnable *worker = mp_lookup->worker;
+        mp_lookup->worker = nullptr;
+        locker.unlock();
+        if(worker != nullptr) {
+            QThreadPool::globalInstance()->start(worker, mp_lookup->priority);
+        }
+    }
+};
+
+class MeshCache::WriteJob : public QRunnable
+{
+private:
+    MeshCache *mp_cache;
+    int m_x, m_z;
+    uint64_t m_hash;
+    std::vector<unsigned char> m_payload;
+public:
+    WriteJob(MeshCache *cache, int x, int z, uint64_t hash, std::vector<unsigned char> &&payload)
+        : mp_cache(cache), m_x(x), m_z(z), m_hash(hash), m_payload(std::move(payload))
+    {}
+
+    void run() override {
+        mp_cache->write(m_x, m_z, m_hash, m_payload);
+    }
+};
+
+QRunnable* MeshCache::readJob(int x, int z, sPtr<Lookup> lookup)
+{
+    lookup->deadline = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(MESH_LOOKUP_WAIT_MS);
+    return new ReadJob(this, x, z, lookup);
+}
+
+void MeshCache::startWhenAnswered(sPtr<Lookup> lookup, QRunnable *worker, int priority)
+{
+    QMutexLocker lookupLocker(&lookup->lock);
+    if(lookup->answered) {
+        lookupLocker.unlock();
+        QThreadPool::globalInstance()->start(worker, priority);
+        return;
+    }
+    lookup->worker = worker;
+    lookup->priority = priority;
+    lookupLocker.unlock();
+
+    QMutexLocker locker(&m_lock);
+    m_waiting.push_back(lookup);
+}
+
+void MeshCache::startOverdue(bool all)
+{
+    std::vector<std::pair<QRunnable*, int>> due;
+    auto now = std::chrono::steady_clock::now();
+    QMutexLocker locker(&m_lock);
+    for(std::size_t i = 0; i < m_waiting.size();) {
+        Lookup &lookup = *m_waiting[i];
+        QMutexLocker lookupLocker(&lookup.lock);
+        if(lookup.worker != nullptr && (all || now >= lookup.deadline)) {
+            due.push_back({lookup.worker, lookup.priority});
+            lookup.worker = nullptr;
+        }
+        //started here or by its read
+        if(lookup.worker == nullptr) {
+            lookupLocker.unlock();
+            m_waiting[i] = std::move(m_waiting.back());
+            m_waiting.pop_back();
+        }
+        else {
+            i++;
+        }
+    }
+    locker.unlock();
+    for(auto &d : due) {
+        QThreadPool::globalInstance()->start(d.first, d.second);
+    }
+}
+
+QRunnable* MeshCache::writeJob(int x, int z, uint64_t hash, std::vector<unsigned char> &&payload)
+{
+    return new WriteJob(this, x, z, hash, std::move(payload));
+}
+
+bool MeshCache::read(int x, int z, std::vector<unsigned char> &payload)
+{
+    QMutexLocker locker(&m_lock);
+    RegionFile *r = regionFor(x, z, false);
+    const unsigned char *data;
+    std::size_t size;
+    if(r == nullptr || !r->readPayload(localIndex(x), localIndex(z), data, size)) {
+        return false;
+    }
+    // The mapping may move on the next read or write
+    payload.assign(data, data + size);
+    m_stats.bytesRead += size;
+    return true;
+}
+
+void MeshCache::write(int x, int z, uint64_t hash, const std::vector<unsigned char> &payload)
+{
+    QMutexLocker locker(&m_lock);
+    RegionFile *r = regionFor(x, z, true);
+    if(r == nullptr) {
+        return;
+    }
+    // Meshed again only because the read hadn't answered in time
+    const unsigned char *data;
+    std::size_t size;
+    if(r->readPayload(localIndex(x), localIndex(z), data, size) && size >= MESH_HEADER_SIZE) {
+        uint32_t version = get<uint32_t>(data);
+        uint64_t storedHash = get<uint64_t>(data);
+        if(version == MESHER_VERSION && storedHash == hash) {
+            m_stats.storesSkipped++;
+            return;
+        }
+    }
+    if(r->writePayload(localIndex(x), localIndex(z), payload)) {
+        m_stats.stores++;
+        m_stats.bytesWritten += payload.size();
+    }
+}
+
+bool MeshCache::take(Lookup &lookup, uint64_t hash, Chunk &c)
+{
+    QMutexLocker lookupLocker(&lookup.lock);
+    bool answered = lookup.answered;
+    bool hit = false;
+    const std::vector<unsigned char> &payload = lookup.payload;
+    std::size_t size = payload.size();
+    if(lookup.found && size >= MESH_HEADER_SIZE) {
+        const unsigned char *in = payload.data();
+        uint32_t version = get<uint32_t>(in);
+        uint64_t storedHash = get<uint64_t>(in);
+        uint32_t vecs = get<uint32_t>(in);
+        uint32_t indices = get<uint32_t>(in);
+        if(version == MESHER_VERSION && storedHash == hash &&
+                size == MESH_HEADER_SIZE + vecs * sizeof(glm::vec4) + indices * sizeof(GLuint)) {
+            c.m_countOpaque = get<int32_t>(in);
+            c.m_countTrans = get<int32_t>(in);
+            c.m_idxCount = get<int32_t>(in);
+            c.m_minY = get<int32_t>(in);
+            c.m_maxY = get<int32_t>(in);
+            c.m_vboInter.resize(vecs);
+            std::memcpy(static_cast<void*>(c.m_vboInter.data()), in, vecs * sizeof(glm::vec4));
+            in += vecs * sizeof(glm::vec4);
+            c.m_idxInter.resize(indices);
+            std::memcpy(c.m_idxInter.data(), in, indices * sizeof(GLuint));
+            c.m_count = indices;
+            hit = true;
+        }
+    }
+    lookupLocker.unlock();
+
+    QMutexLocker locker(&m_lock);
+    if(hit) {
+        m_stats.hits++;
+    }
+    else if(answered) {
+        m_stats.misses++;
+    }
+    else {
+        m_stats.unanswered++;
+    }
+    return hit;
+}
+
+std::vector<unsigned char> MeshCache::encode(const Chunk &c, uint64_t hash)
+{
+    std::size_t vecBytes = c.m_vboInter.size() * sizeof(glm::vec4);
+    std::size_t idxBytes = c.m_idxInter.size() * sizeof(GLuint);
+    std::vector<unsigned char> payload(MESH_HEADER_SIZE + vecBytes + idxBytes);
+    std::size_t at = 0;
+    put(payload, at, MESHER_VERSION);
+    put(payload, at, hash);
+    put(payload, at, static_cast<uint32_t>(c.m_vboInter.size()));
+    put(payload, at, static_cast<uint32_t>(c.m_idxInter.size()));
+    put(payload, at, static_cast<int32_t>(c.m_countOpaque));
+    put(payload, at, static_cast<int32_t>(c.m_countTrans));
+    put(payload, at, static_cast<int32_t>(c.m_idxCount));
+    put(payload, at, static_cast<int32_t>(c.m_minY));
+    put(payload, at, static_cast<int32_t>(c.m_maxY));
+    if(vecBytes > 0) {
+        std::memcpy(payload.data() + at, c.m_vboInter.data(), vecBytes);
+    }
+    if(idxBytes > 0) {
+        std::memcpy(payload.data() + at + vecBytes, c.m_idxInter.data(), idxBytes);
+    }
+    return payload;
+}
+
+MeshCache::Stats MeshCache::stats() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "regionfile.h"
+#include "smartpointerhelp.h"
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <QMutex>
+#include <QRunnable>
+
+class Chunk;
+class PaddedChunkView;
+
+// Finished Chunk meshes saved next to a world's region files, so
+// re-entering an explored area can upload meshes instead of rebuilding
+// them. Layout:
+//   <world>/meshes/r.<rx>.<rz>.mmr    region files (see regionfile.h)
+// whose payloads are, in native byte order (the cache is local to one
+// machine and one build, and anything it can't use is simply remeshed):
+//   u32  MESHER_VERSION
+//   u64  content hash of the PaddedChunkView the mesh was built from
+//   u32  vec4s in the interleaved vertex buffer, u32 indices
+//   i32  m_countOpaque, m_countTrans, m_idxCount
+//   i32  m_minY, m_maxY
+//   the vertex buffer, then the index buffer
+//
+// The padded view holds the Chunk's blocks and the faces of its
+// neighbors it borders, which is everything the mesher reads, so a
+// matching hash means the mesh would come out the same. The one input
+// it doesn't see is the time liquids' UV offset is taken from; that
+// offset is only a phase, and a cached one is as good as a new one.
+//
+// Reading and writing the region files is only done on ChunkIO's
+// threads, through the jobs below, so a slow disk never holds up a
+// VBOWorker on the global pool. For each Chunk it meshes, Terrain
+// starts a read and parks the VBOWorker with it. The read may queue
+// behind zone loads, so the worker is only put on the global pool
+// once the read has answered, or once MESH_LOOKUP_WAIT_MS have passed
+// since it was requested (Terrain checks every tick). If the hashes
+// match, the worker takes the cached mesh; otherwise it meshes as
+// usual and hands the result to a background write. Every call locks
+// the cache.
+//
+// Like WorldStorage, the cache keeps a bounded number of region files
+// open, closing the least recently used one past that.
+class MeshCache
+{
+public:
+    // Bump whenever the mesher's output changes, to discard every
+    // cached mesh
+    static constexpr uint32_t MESHER_VERSION = 2;
+
+    // Opens (creating if needed) the cache under worldDir
+    MeshCache(const std::string &worldDir);
+    // Compacts region files that are mostly abandoned meshes
+    ~MeshCache();
+
+    static uint64_t hashView(const PaddedChunkView &view);
+
+    // Where a read job leaves what it found, for the VBOWorker
+    // meshing the same Chunk
+    struct Lookup {
+        QMutex lock;
+        // The read has finished, and whether it found a payload
+        bool answered = false, found = false;
+        std::vector<unsigned char> payload;
+        // Set by readJob: past this, the worker stops waiting
+        std::chrono::steady_clock::time_point deadline;
+        // Parked by startWhenAnswered until then
+        QRunnable *worker = nullptr;
+        int priority = 0;
+    };
+
+    // Reads the Chunk at (x, z)'s cached payload into lookup. Run the
+    // job on ChunkIO (it deletes itself once it has run).
+    QRunnable* readJob(int x, int z, sPtr<Lookup> lookup);
+    // Starts worker on the global pool at priority as soon as lookup
+    // has answered, or once its deadline passes (see startOverdue).
+    // The pool takes ownership of worker either way.
+    void startWhenAnswered(sPtr<Lookup> lookup, QRunnable *worker, int priority);
+    // Starts the parked workers whose lookups are past their deadline,
+    // or every parked worker if all. Call every tick, and with all
+    // before waiting for the global pool.
+    void startOverdue(bool all = false);
+    // Caches a payload made by encode, unless a mesh with the same
+    // hash is stored already. Run the job on ChunkIO.
+    QRunnable* writeJob(int x, int z, uint64_t hash, std::vector<unsigned char> &&payload);
+
+    // Fills c's interleaved mesh and counts from lookup if it has
+    // answered with a mesh of exactly this content. Returns false
+    // otherwise, without waiting for the read.
+    bool take(Lookup &lookup, uint64_t hash, Chunk &c);
+    // c's freshly built interleaved mesh, as a cache payload
+    static std::vector<unsigned char> encode(const Chunk &c, uint64_t hash);
+
+    struct Stats {
+        // Lookups that found the mesh, that found no usable mesh, and
+        // that hadn't been answered when the VBOWorker needed them
+        std::size_t hits, misses, unanswered;
+        // Meshes written, and not written since they were cached already
+        std::size_t stores, storesSkipped;
+        std::size_t bytesRead, bytesWritten;
+        // Region files closed to stay under the open file limit
+        std::size_t regionsClosed;
+    };
+    Stats stats() const;
+
+private:
+    class ReadJob;
+    class WriteJob;
+
+    // ChunkIO threads only
+    bool read(int x, int z, std::vector<unsigned char> &payload);
+    void write(int x, int z, uint64_t hash, const std::vector<unsigned char> &payload);
+    RegionFile* regionFor(int x, int z, bool create);
+    // Flushes, compacts if mostly abandoned meshes, and closes
+    static void closeRegion(RegionFile &r);
+
+    std::string m_dir;
+    struct OpenRegion {
+        uPtr<RegionFile> file;
+        // Position in m_regionOrder, for O(1) reordering
+        std::list<int64_t>::iterator order;
+    };
+    // Keyed by (rx, rz), like WorldStorage's
+    std::unordered_map<int64_t, OpenRegion> m_regions;
+    // Least recently used region at the front
+    std::list<int64_t> m_regionOrder;
+    // Lookups that may still have a worker parked on them
+    std::vector<sPtr<Lookup>> m_waiting;
+    Stats m_stats;
+    mutable QMutex m_lock;
+};
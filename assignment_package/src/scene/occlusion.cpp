@@ -0,0 +1,285 @@
+#include "occlusion.h"
+#include <QRunnable>
+
+// Entry face of the section the camera is in
+#define NO_FACE 0xff
+
+// Blocks the mesher draws see-through (see Chunk::createChunkVBOdata)
+static bool seeThrough(BlockType t) {
+    return t == EMPTY || t == WATER || t == ICE || t == LAVA;
+}
+
+static Direction opposite(int d) {
+    // XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG pair up
+    return static_cast<Direction>(d ^ 1);
+}
+
+SectionGraph::SectionGraph()
+{
+    for(auto &section : m_links) {
+        section.fill(0x3f);
+    }
+}
+
+void SectionGraph::compute(const ChunkBlocks &blocks)
+{
+    // Cells of one section as x + 16 z + 256 y
+    std::array<bool, 4096> open, seen;
+    std::array<uint16_t, 4096> stack;
+    for(int s = 0; s < SECTIONS; s++) {
+        int openCount = 0;
+        for(int y = 0; y < 16; y++) {
+            for(int z = 0; z < 16; z++) {
+                for(int x = 0; x < 16; x++) {
+                    bool o = seeThrough(blocks.getBlockAtUnchecked(x, 16*s + y, z));
+                    open[x + 16*z + 256*y] = o;
+                    openCount += o;
+                }
+            }
+        }
+        m_links[s].fill(openCount == 4096 ? 0x3f : 0);
+        if(openCount == 0 || openCount == 4096) {
+            continue;
+        }
+
+        //each pocket of see-through blocks links every face it touches
+        seen.fill(false);
+        for(int start = 0; start < 4096; start++) {
+            if(!open[start] || seen[start]) {
+                continue;
+            }
+            uint8_t faces = 0;
+            int top = 0;
+            stack[top++] = start;
+            seen[start] = true;
+            while(top > 0) {
+                int c = stack[--top];
+                int x = c & 15, z = (c >> 4) & 15, y = c >> 8;
+                auto visit = [&](bool inside, int n, Direction face) {
+                    if(!inside) {
+                        faces |= 1 << face;
+                    }
+                    else if(open[n] && !seen[n]) {
+                        seen[n] = true;
+                        stack[top++] = n;
+                    }
+                };
+                visit(x < 15, c + 1, XPOS);
+                visit(x > 0, c - 1, XNEG);
+                visit(y < 15, c + 256, YPOS);
+                visit(y > 0, c - 256, YNEG);
+                visit(z < 15, c + 16, ZPOS);
+                visit(z > 0, c - 16, ZNEG);
+            }
+            for(int f = 0; f < 6; f++) {
+                if(faces & (1 << f)) {
+                    m_links[s][f] |= faces;
+                }
+            }
+        }
+    }
+}
+
+OcclusionCuller::OcclusionCuller()
+    : m_minX(0), m_minZ(0), m_chunksX(0), m_chunksZ(0),
+      m_graphs(), m_visible(), m_reached(0),
+      m_entry(), m_moved(), m_queue()
+{}
+
+void OcclusionCuller::run(glm::vec3 eye, const Frustum &frustum,
+                          int minX, int minZ, int maxX, int maxZ, const GraphLookup &graphFor)
+{
+    fill(eye, &frustum, minX, minZ, maxX, maxZ, graphFor);
+}
+
+void OcclusionCuller::run(glm::vec3 eye, int minX, int minZ, int maxX, int maxZ,
+                          const GraphLookup &graphFor)
+{
+    fill(eye, nullptr, minX, minZ, maxX, maxZ, graphFor);
+}
+
+void OcclusionCuller::fill(glm::vec3 eye, const Frustum *frustum,
+                           int minX, int minZ, int maxX, int maxZ, const GraphLookup &graphFor)
+{
+    const int S = SectionGraph::SECTIONS;
+    m_minX = minX;
+    m_minZ = minZ;
+    m_chunksX = (maxX - minX) / 16;
+    m_chunksZ = (maxZ - minZ) / 16;
+    std::size_t sections = static_cast<std::size_t>(m_chunksX) * m_chunksZ * S;
+    m_graphs.resize(static_cast<std::size_t>(m_chunksX) * m_chunksZ);
+    m_visible.assign(m_graphs.size(), 0);
+    m_entry.resize(sections);
+    m_moved.resize(sections);
+    m_queue.clear();
+    m_reached = 0;
+
+    int cx = static_cast<int>(glm::floor((eye.x - minX) / 16.f));
+    int cz = static_cast<int>(glm::floor((eye.z - minZ) / 16.f));
+    if(cx < 0 || cx >= m_chunksX || cz < 0 || cz >= m_chunksZ) {
+        m_visible.assign(m_graphs.size(), 0xffff);
+        return;
+    }
+    for(int z = 0; z < m_chunksZ; z++) {
+        for(int x = 0; x < m_chunksX; x++) {
+            m_graphs[z * m_chunksX + x] = graphFor(minX + 16*x, minZ + 16*z);
+        }
+    }
+
+    //above or below the world, start from the nearest section
+    int cy = glm::clamp(static_cast<int>(glm::floor(eye.y / 16.f)), 0, S - 1);
+    int start = (cz * m_chunksX + cx) * S + cy;
+    m_visible[start / S] |= 1 << cy;
+    m_entry[start] = NO_FACE;
+    m_moved[start] = 0;
+    m_queue.push_back(start);
+
+    // Breadth first, so each section is reached along a straightest path
+    for(std::size_t head = 0; head < m_queue.size(); head++) {
+        int n = m_queue[head];
+        int column = n / S, y = n % S;
+        int x = column % m_chunksX, z = column / m_chunksX;
+        const SectionGraph *graph = m_graphs[column];
+        for(int d = 0; d < 6; d++) {
+            if(m_moved[n] & (1 << opposite(d))) {
+                continue;
+            }
+            if(m_entry[n] != NO_FACE && graph != nullptr &&
+                    !graph->connects(y, static_cast<Direction>(m_entry[n]), static_cast<Direction>(d))) {
+                continue;
+            }
+            int nx = x + (d == XPOS) - (d == XNEG);
+            int ny = y + (d == YPOS) - (d == YNEG);
+            int nz = z + (d == ZPOS) - (d == ZNEG);
+            if(nx < 0 || nx >= m_chunksX || ny < 0 || ny >= S || nz < 0 || nz >= m_chunksZ) {
+                continue;
+            }
+            int next = (nz * m_chunksX + nx) * S + ny;
+            uint16_t &visible = m_visible[next / S];
+            if(visible & (1 << ny)) {
+                continue;
+            }
+            glm::vec3 lo(minX + 16*nx, 16*ny, minZ + 16*nz);
+            if(frustum != nullptr && !frustum->intersects(lo, lo + glm::vec3(16))) {
+                continue;
+            }
+            visible |= 1 << ny;
+            m_entry[next] = opposite(d);
+            m_moved[next] = m_moved[n] | (1 << d);
+            m_queue.push_back(next);
+        }
+    }
+    m_reached = m_queue.size();
+}
+
+uint16_t OcclusionCuller::visibleSections(int x, int z) const
+{
+    int cx = (x - m_minX) >> 4, cz = (z - m_minZ) >> 4;
+    if(x < m_minX || z < m_minZ || cx >= m_chunksX || cz >= m_chunksZ) {
+        return 0xffff;
+    }
+    return m_visible[cz * m_chunksX + cx];
+}
+
+std::size_t OcclusionCuller::sectionsReached() const
+{
+    return m_reached;
+}
+
+class AsyncOcclusionCuller::FillJob : public QRunnable
+{
+private:
+    AsyncOcclusionCuller *mp_owner;
+    glm::vec3 m_eye;
+    int m_minX, m_minZ, m_maxX, m_maxZ;
+public:
+    FillJob(AsyncOcclusionCuller *owner, glm::vec3 eye,
+            int minX, int minZ, int maxX, int maxZ)
+        : mp_owner(owner), m_eye(eye),
+          m_minX(minX), m_minZ(minZ), m_maxX(maxX), m_maxZ(maxZ)
+    {}
+
+    void run() override {
+        AsyncOcclusionCuller *o = mp_owner;
+        o->mp_back->run(m_eye, m_minX, m_minZ, m_maxX, m_maxZ, [o](int x, int z) {
+            std::size_t i = ((z - o->m_minZ) >> 4) * o->m_chunksX + ((x - o->m_minX) >> 4);
+            return o->m_hasGraph[i] ? &o->m_graphs[i] : nullptr;
+        });
+        QMutexLocker locker(&o->m_lock);
+        o->m_finished = true;
+        o->m_fillFinished.wakeAll();
+    }
+};
+
+AsyncOcclusionCuller::AsyncOcclusionCuller()
+    : mp_front(mkU<OcclusionCuller>()), mp_back(mkU<OcclusionCuller>()),
+      m_graphs(), m_hasGraph(), m_minX(0), m_minZ(0), m_chunksX(0),
+      m_fillsTaken(0), m_running(false), m_finished(false),
+      m_lock(), m_fillFinished(), m_pool()
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+AsyncOcclusionCuller::~AsyncOcclusionCuller()
+{
+    waitForFill();
+}
+
+void AsyncOcclusionCuller::waitForFill()
+{
+    QMutexLocker locker(&m_lock);
+    while(m_running && !m_finished) {
+        m_fillFinished.wait(&m_lock);
+    }
+}
+
+void AsyncOcclusionCuller::update(glm::vec3 eye, int minX, int minZ, int maxX, int maxZ,
+                                  const OcclusionCuller::GraphLookup &graphFor)
+{
+    {
+        QMutexLocker locker(&m_lock);
+        if(m_finished) {
+            std::swap(mp_front, mp_back);
+            m_fillsTaken++;
+            m_running = m_finished = false;
+        }
+        if(m_running) {
+            return;
+        }
+        m_running = true;
+    }
+
+    // Chunks are only touched here, on the main thread: the worker
+    // reads copies of their graphs
+    m_minX = minX;
+    m_minZ = minZ;
+    m_chunksX = (maxX - minX) / 16;
+    int chunksZ = (maxZ - minZ) / 16;
+    m_graphs.resize(static_cast<std::size_t>(m_chunksX) * chunksZ);
+    m_hasGraph.assign(m_graphs.size(), false);
+    for(int z = 0; z < chunksZ; z++) {
+        for(int x = 0; x < m_chunksX; x++) {
+            const SectionGraph *graph = graphFor(minX + 16*x, minZ + 16*z);
+            if(graph != nullptr) {
+                m_graphs[z * m_chunksX + x] = *graph;
+                m_hasGraph[z * m_chunksX + x] = true;
+            }
+        }
+    }
+    m_pool.start(new FillJob(this, eye, minX, minZ, maxX, maxZ));
+}
+
+uint16_t AsyncOcclusionCuller::visibleSections(int x, int z) const
+{
+    return mp_front->visibleSections(x, z);
+}
+
+std::size_t AsyncOcclusionCuller::sectionsReached() const
+{
+    return mp_front->sectionsReached();
+}
+
+std::size_t AsyncOcclusionCuller::fillsTaken() const
+{
+    return m_fillsTaken;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include "chunkblocks.h"
+#include "frustum.h"
+#include "glm_includes.h"
+#include "smartpointerhelp.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+// Which faces of each 16 x 16 x 16 section of a Chunk can see each
+// other through the section's see-through blocks. Sight entering a
+// section through one face can only leave through the faces it's
+// linked to; a section of solid stone links nothing, a section of air
+// links everything. Built off the main thread with the Chunk's mesh.
+class SectionGraph
+{
+public:
+    static constexpr int SECTIONS = 16;
+
+    // Every face linked to every other, for Chunks not yet analyzed
+    SectionGraph();
+
+    void compute(const ChunkBlocks &blocks);
+
+    bool connects(int section, Direction from, Direction to) const {
+        return (m_links[section][from] >> to) & 1;
+    }
+
+private:
+    // m_links[section][face] has bit f set when face f is reachable
+    std::array<std::array<uint8_t, 6>, SECTIONS> m_links;
+};
+
+// Finds the sections that could be visible from the camera by flood
+// filling section to section from the one the camera is in, only
+// crossing a section between faces its SectionGraph links, never
+// turning back toward the camera, and, if given a frustum, never
+// leaving it. Sections the fill doesn't reach are hidden behind solid
+// terrain.
+//
+// Like Frustum, pure CPU work with no OpenGL, so it can be run and
+// checked without a window.
+class OcclusionCuller
+{
+public:
+    // The graph of the Chunk whose origin is (x, z), or nullptr if it
+    // has none yet, which is treated as open space
+    using GraphLookup = std::function<const SectionGraph*(int x, int z)>;
+
+    OcclusionCuller();
+
+    // Flood fills the Chunks with origins in [minX, maxX) x [minZ, maxZ),
+    // which should be multiples of 16. If the camera isn't over that
+    // area, everything in it is left visible.
+    void run(glm::vec3 eye, const Frustum &frustum,
+             int minX, int minZ, int maxX, int maxZ, const GraphLookup &graphFor);
+    // As above, filling in every direction. What it finds holds for
+    // any view from eye, so the caller can cull with a newer frustum.
+    void run(glm::vec3 eye, int minX, int minZ, int maxX, int maxZ, const GraphLookup &graphFor);
+
+    // Sections of the Chunk at (x, z) the last run reached, bit i set
+    // for section i counting up from y = 0. Chunks outside the area
+    // are all visible.
+    uint16_t visibleSections(int x, int z) const;
+    // Sections the last run reached
+    std::size_t sectionsReached() const;
+
+private:
+    // frustum may be nullptr
+    void fill(glm::vec3 eye, const Frustum *frustum,
+              int minX, int minZ, int maxX, int maxZ, const GraphLookup &graphFor);
+
+    int m_minX, m_minZ, m_chunksX, m_chunksZ;
+    std::vector<const SectionGraph*> m_graphs;
+    std::vector<uint16_t> m_visible;
+    std::size_t m_reached;
+    // Per section: the face the fill entered it through, and every
+    // direction the fill moved in to get there
+    std::vector<uint8_t> m_entry, m_moved;
+    std::vector<int> m_queue;
+};
+
+// Runs OcclusionCuller's fill on a thread of its own, one frame behind
+// the camera. Each frame, update() takes the newest fill that has
+// finished, then starts the next one from this frame's camera position
+// and a copy of the area's SectionGraphs, unless the last is still
+// running. The frame is culled with the fill it took, so what is
+// hidden lags the camera by about a frame; until the first fill
+// finishes, everything is visible.
+//
+// The fill ignores the frustum and floods in every direction, so
+// turning the camera never uncovers sections it skipped: the caller
+// culls against its own, current Frustum. It gets a thread rather
+// than the global pool, where it would queue behind generation and
+// meshing work and lag by many frames while terrain streams in.
+class AsyncOcclusionCuller
+{
+public:
+    AsyncOcclusionCuller();
+    // Waits for a running fill, which writes into this object
+    ~AsyncOcclusionCuller();
+
+    AsyncOcclusionCuller(const AsyncOcclusionCuller&) = delete;
+    AsyncOcclusionCuller& operator=(const AsyncOcclusionCuller&) = delete;
+
+    // Main thread only, like visibleSections. graphFor is called
+    // before this returns, never from the worker.
+    void update(glm::vec3 eye, int minX, int minZ, int maxX, int maxZ,
+                const OcclusionCuller::GraphLookup &graphFor);
+    // Blocks until the running fill, if any, has finished
+    void waitForFill();
+
+    // As OcclusionCuller's, for the fill update() last took
+    uint16_t visibleSections(int x, int z) const;
+    std::size_t sectionsReached() const;
+    // Fills finished and taken by update()
+    std::size_t fillsTaken() const;
+
+private:
+    class FillJob;
+
+    // Read by the main thread; the worker fills mp_back. They swap
+    // once a fill has finished.
+    uPtr<OcclusionCuller> mp_front, mp_back;
+    // The SectionGraphs the running fill reads, indexed like the
+    // fill's area; m_hasGraph is false where there was none
+    std::vector<SectionGraph> m_graphs;
+    std::vector<bool> m_hasGraph;
+    int m_minX, m_minZ, m_chunksX;
+    std::size_t m_fillsTaken;
+
+    bool m_running, m_finished;
+    QMutex m_lock;
+    QWaitCondition m_fillFinished;
+    // One thread, which runs the fills
+    QThreadPool m_pool;
+};
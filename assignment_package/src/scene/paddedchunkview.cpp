@@ -0,0 +1,50 @@
+#include "paddedchunkview.h"
+#include <algorithm>
+
+PaddedChunkView::PaddedChunkView()
+    : m_blocks(VOLUME, EMPTY)
+{}
+
+void PaddedChunkView::fill(const Chunk &c)
+{
+    // The view may be reused between Chunks, so clear any old border
+    std::fill(m_blocks.begin(), m_blocks.end(), EMPTY);
+
+    for(int z = 0; z < 16; ++z) {
+        for(int x = 0; x < 16; ++x) {
+            for(int y = 0; y < 256; ++y) {
+                m_blocks[index(x, y, z)] = c.getBlockAtUnchecked(x, y, z);
+            }
+        }
+    }
+
+    // Each neighbor contributes the one face that touches this Chunk
+    if(const Chunk *n = c.getNeighbor(XPOS)) {
+        for(int z = 0; z < 16; ++z) {
+            for(int y = 0; y < 256; ++y) {
+                m_blocks[index(16, y, z)] = n->getBlockAtUnchecked(0, y, z);
+            }
+        }
+    }
+    if(const Chunk *n = c.getNeighbor(XNEG)) {
+        for(int z = 0; z < 16; ++z) {
+            for(int y = 0; y < 256; ++y) {
+                m_blocks[index(-1, y, z)] = n->getBlockAtUnchecked(15, y, z);
+            }
+        }
+    }
+    if(const Chunk *n = c.getNeighbor(ZPOS)) {
+        for(int x = 0; x < 16; ++x) {
+            for(int y = 0; y < 256; ++y) {
+                m_blocks[index(x, y, 16)] = n->getBlockAtUnchecked(x, y, 0);
+            }
+        }
+    }
+    if(const Chunk *n = c.getNeighbor(ZNEG)) {
+        for(int x = 0; x < 16; ++x) {
+            for(int y = 0; y < 256; ++y) {
+                m_blocks[index(x, y, -1)] = n->getBlockAtUnchecked(x, y, 15);
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "chunk.h"
+#include <vector>
+
+// A scratch copy of one Chunk's blocks surrounded by a one-block border
+// taken from its four horizontal neighbors, i.e. an 18 x 258 x 18 box.
+// Border cells whose neighbor doesn't exist, and the layers just below
+// and above the world, are EMPTY; the four vertical edge columns (diagonal
+// neighbors) are never read by the mesher and are left EMPTY as well.
+//
+// Meshing against this view means every one of a block's six neighbors
+// is a fixed offset away in one flat array, so the mesher's inner loop
+// needs no border tests and no neighbor-Chunk lookups.
+class PaddedChunkView {
+public:
+    static constexpr int SIZE_X = 18, SIZE_Y = 258, SIZE_Z = 18;
+    static constexpr int VOLUME = SIZE_X * SIZE_Y * SIZE_Z;
+
+    PaddedChunkView();
+
+    // Copy c and the touching faces of its neighbors into this view
+    void fill(const Chunk &c);
+
+    // Local Chunk coordinates: x and z in [-1, 16], y in [-1, 256].
+    // Columns are contiguous, like ColumnLayout.
+    static constexpr int index(int x, int y, int z) {
+        return (y + 1) + SIZE_Y * (x + 1) + SIZE_Y * SIZE_X * (z + 1);
+    }
+    // How far index() moves when stepping one block in direction d
+    static constexpr int offsetOf(Direction d) {
+        return d == XPOS ?  index(1, 0, 0) - index(0, 0, 0) :
+               d == XNEG ?  index(-1, 0, 0) - index(0, 0, 0) :
+               d == YPOS ?  index(0, 1, 0) - index(0, 0, 0) :
+               d == YNEG ?  index(0, -1, 0) - index(0, 0, 0) :
+               d == ZPOS ?  index(0, 0, 1) - index(0, 0, 0) :
+                            index(0, 0, -1) - index(0, 0, 0);
+    }
+
+    BlockType getBlockAt(int x, int y, int z) const {
+        return m_blocks[index(x, y, z)];
+    }
+    BlockType operator[](int idx) const {
+        return m_blocks[idx];
+    }
+    // All VOLUME blocks, in index() order
+    const BlockType* data() const {
+        return m_blocks.data();
+    }
+
+private:
+    // Heap allocated: ~82 KB is too much for a worker thread's stack
+    std::vector<BlockType> m_blocks;
+};
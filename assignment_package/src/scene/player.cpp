@@ -1,10 +1,11 @@
 #include "player.h"
+#include "blockcursor.h"
 #include <QString>
 #include <iostream>
 #include <string.h>
 #include <vector>
 
-bool checkCollision(glm::vec3 origin, glm::vec3 rayDirection, int axis, const Terrain &terrain, float &out_dist, glm::ivec3 &out_blockHit, bool ignoreLiquid=true);
+bool checkCollision(glm::vec3 origin, glm::vec3 rayDirection, int axis, TerrainCursor &cursor, float &out_dist, glm::ivec3 &out_blockHit, bool ignoreLiquid=true);
 bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit, int *interfaceAxis);
 //std::string getName(BlockType t);
 
@@ -148,7 +149,10 @@ void Player::computePhysics(float dT, const Terrain &terrain) {
 
     float min_frame_rate = 15.f;
     m_velocity += m_acceleration * std::min(dT, 1/min_frame_rate);
-    BlockType currType = terrain.getBlockAt(int(m_position.x), int(m_position.y), int(m_position.z));
+    // Every probe below reads cells right around the player,
+    // so they all share one cursor.
+    TerrainCursor cursor(terrain);
+    BlockType currType = cursor.getBlockAt(int(m_position.x), int(m_position.y), int(m_position.z));
     if(currType == WATER || currType == LAVA){
         m_velocity = 2/3.f * m_velocity;
     }
@@ -166,7 +170,7 @@ void Player::computePhysics(float dT, const Terrain &terrain) {
     glm::vec3 pos_origin = (glm::vec3(m_position.x-0.5, m_position.y, m_position.z-0.5));
 
     // check if the player is under liquid or not
-    if(checkCollision(pos_origin, glm::vec3(0,100,0), 1, terrain, out_dist, out_blockHit, false)){
+    if(checkCollision(pos_origin, glm::vec3(0,100,0), 1, cursor, out_dist, out_blockHit, false)){
         m_underLiquid = true;
     }
     else{
@@ -182,7 +186,7 @@ void Player::computePhysics(float dT, const Terrain &terrain) {
             subdirection[i] = pos_offset[i];
             std::vector<glm::vec3> collisionPoints = getPoints(pos_origin, subdirection);
             for(const auto &point : collisionPoints){ // check for each vertex in the body
-                if(checkCollision(point, subdirection, i, terrain, out_dist, out_blockHit)){
+                if(checkCollision(point, subdirection, i, cursor, out_dist, out_blockHit)){
                     m_acceleration[i] = 0;
                     m_velocity[i] = 0;
                     if(i == 1 && subdirection[1] <= 0){
@@ -206,7 +210,7 @@ void Player::computePhysics(float dT, const Terrain &terrain) {
 }
 
 
-bool checkCollision(glm::vec3 origin, glm::vec3 rayDirection, int axis, const Terrain &terrain, float &out_dist, glm::ivec3 &out_blockHit, bool ignoreLiquid){
+bool checkCollision(glm::vec3 origin, glm::vec3 rayDirection, int axis, TerrainCursor &cursor, float &out_dist, glm::ivec3 &out_blockHit, bool ignoreLiquid){
     // Custom implementation ofgridMarch algorithm for individual axis. Runs faster and doesn't have bugs.
     glm::vec3 currCell = glm::floor(origin);
     float distanceMoved = (origin[axis] - currCell[axis]) * (-1 * glm::sign(rayDirection[axis]));
@@ -216,7 +220,7 @@ bool checkCollision(glm::vec3 origin, glm::vec3 rayDirection, int axis, const Te
         float tempDist = glm::min(0.9999f, maxDist-distanceMoved);
         float signedTempDist = tempDist * glm::sign(rayDirection[axis]);
         currCell[axis] += signedTempDist;
-        BlockType currType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z) ;
+        BlockType currType = cursor.getBlockAt(static_cast<int>(currCell.x), static_cast<int>(currCell.y), static_cast<int>(currCell.z));
         if(currType != EMPTY){
             if(ignoreLiquid) {
                 if(currType != WATER && currType != LAVA){
@@ -339,6 +343,7 @@ QString Player::lookAsQString() const {
 
 bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit, int *out_interfaceAxis) {
     float maxLen = glm::length(rayDirection); // Farthest we search
+    TerrainCursor cursor(terrain);
     glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
     rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
 
@@ -375,7 +380,7 @@ bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terra
         currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
         // If currCell contains something other than EMPTY, return
         // curr_t
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
+        BlockType cellType = cursor.getBlockAt(currCell);
         if(cellType != EMPTY) {
             *out_blockHit = currCell;
             if(rayDirection.y != 0){
@@ -404,9 +409,11 @@ void Player::placeBlock(Terrain& terrain){
     int interfaceAxis;
 
     if (gridMarch(rayOrigin, rayDirection, terrain, &out_dist, &out_blockHit, &interfaceAxis)){
-        BlockType bt = terrain.getBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z);
+        std::optional<BlockType> bt = terrain.tryGetBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z);
         out_blockHit[interfaceAxis] -= glm::sign(rayDirection[interfaceAxis]);
-        terrain.setBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, bt);
+        if(bt) {
+            terrain.trySetBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, *bt);
+        }
     }
 }
 
@@ -421,10 +428,18 @@ void Player::breakBlock(Terrain& terrain){
     int interfaceAxis;
 
     if (gridMarch(rayOrigin, rayDirection, terrain, &out_dist, &out_blockHit, &interfaceAxis)){
-        terrain.setBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, BlockType::EMPTY);
+        terrain.trySetBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, BlockType::EMPTY);
     }
 }
 
 glm::vec3 Player::getPos() const{
     return m_position;
 }
+
+glm::vec3 Player::getVelocity() const{
+    return m_velocity;
+}
+
+glm::vec3 Player::getLook() const{
+    return m_forward;
+}
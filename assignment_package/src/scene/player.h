@@ -53,6 +53,10 @@ public:
     std::vector<glm::vec3> getPoints(glm::vec3 origin, glm::vec3 subdirection);
 
     glm::vec3 getPos() const;
+    // In blocks per second
+    glm::vec3 getVelocity() const;
+    // The direction the camera faces
+    glm::vec3 getLook() const;
 
     // For sending the Player's data to the GUI
     // for display
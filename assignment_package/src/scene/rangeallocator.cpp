@@ -0,0 +1,97 @@
+#include "rangeallocator.h"
+#include <iterator>
+#include <stdexcept>
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+    : m_capacity(capacity), m_used(0), m_holes()
+{
+    if(capacity > 0) {
+        m_holes[0] = capacity;
+    }
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size)
+{
+    if(size == 0) {
+        return NONE;
+    }
+    auto best = m_holes.end();
+    for(auto it = m_holes.begin(); it != m_holes.end(); ++it) {
+        if(it->second >= size && (best == m_holes.end() || it->second < best->second)) {
+            best = it;
+            if(it->second == size) {
+                break;
+            }
+        }
+    }
+    if(best == m_holes.end()) {
+        return NONE;
+    }
+    uint32_t offset = best->first;
+    uint32_t left = best->second - size;
+    m_holes.erase(best);
+    if(left > 0) {
+        m_holes[offset + size] = left;
+    }
+    m_used += size;
+    return offset;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+    if(size == 0) {
+        return;
+    }
+    if(offset > m_capacity || size > m_capacity - offset || size > m_used) {
+        throw std::out_of_range("Freeing a range that was never allocated");
+    }
+    m_used -= size;
+    auto next = m_holes.lower_bound(offset);
+    //merge with the hole right after...
+    if(next != m_holes.end() && offset + size == next->first) {
+        size += next->second;
+        next = m_holes.erase(next);
+    }
+    //...and the one right before
+    if(next != m_holes.begin()) {
+        auto prev = std::prev(next);
+        if(prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    m_holes.emplace_hint(next, offset, size);
+}
+
+uint32_t RangeAllocator::capacity() const
+{
+    return m_capacity;
+}
+
+uint32_t RangeAllocator::used() const
+{
+    return m_used;
+}
+
+uint32_t RangeAllocator::largestFree() const
+{
+    uint32_t largest = 0;
+    for(const auto &hole : m_holes) {
+        largest = hole.second > largest ? hole.second : largest;
+    }
+    return largest;
+}
+
+std::size_t RangeAllocator::holes() const
+{
+    return m_holes.size();
+}
+
+float RangeAllocator::fragmentation() const
+{
+    uint32_t free = m_capacity - m_used;
+    if(free == 0) {
+        return 0.f;
+    }
+    return 1.f - static_cast<float>(largestFree()) / free;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <map>
+
+// Hands out ranges of a fixed-size space, such as the vertices of one
+// GPU buffer, and takes them back for reuse. Free space is kept as a
+// list of holes by offset; allocation picks the smallest hole that fits
+// (to keep big holes big), and freed ranges merge with the holes next
+// to them. Knows nothing about what the space holds.
+class RangeAllocator
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    RangeAllocator(uint32_t capacity);
+
+    // The offset of size free units, or NONE if no hole is big enough.
+    // Allocating 0 units returns NONE.
+    uint32_t allocate(uint32_t size);
+    // Returns a range from allocate() to the free space
+    void free(uint32_t offset, uint32_t size);
+
+    uint32_t capacity() const;
+    uint32_t used() const;
+    uint32_t largestFree() const;
+    std::size_t holes() const;
+    // How scattered the free space is: 0 when it's all one hole, up to
+    // nearly 1 when the biggest hole is a sliver of it
+    float fragmentation() const;
+
+private:
+    uint32_t m_capacity, m_used;
+    // Offset -> size of every hole
+    std::map<uint32_t, uint32_t> m_holes;
+};
@@ -0,0 +1,294 @@
+#include "regionfile.h"
+#include "filesync.h"
+#include <algorithm>
+
+static const char REGION_MAGIC[4] = {'M', 'M', 'R', 'G'};
+
+static void putU16(unsigned char *p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+static void putU32(unsigned char *p, uint32_t v) {
+    for(int i = 0; i < 4; ++i) {
+        p[i] = (v >> (8 * i)) & 0xff;
+    }
+}
+static uint16_t getU16(const unsigned char *p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+static uint32_t getU32(const unsigned char *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+RegionFile::RegionFile(const std::string &path)
+    : m_path(path), mp_file(nullptr), m_table{}, m_end(HEADER_SIZE),
+      m_mapFile(QString::fromStdString(path)), mp_map(nullptr), m_mapSize(0),
+      m_canMap(true), m_mappedReads(0), m_bufferedReads(0), m_readBuffer()
+{
+    mp_file = std::fopen(path.c_str(), "r+b");
+    if(mp_file != nullptr) {
+        if(!readHeader()) {
+            std::fclose(mp_file);
+            mp_file = nullptr;
+        }
+        return;
+    }
+    // Doesn't exist yet. Its directory entry has to be durable too, or
+    // payloads synced into it could vanish with the file after a crash.
+    mp_file = std::fopen(path.c_str(), "w+b");
+    if(mp_file != nullptr && (!writeHeader() || !syncParentDirectory(path))) {
+        std::fclose(mp_file);
+        mp_file = nullptr;
+    }
+}
+
+RegionFile::~RegionFile()
+{
+    unmap();
+    if(mp_file != nullptr) {
+        std::fclose(mp_file);
+    }
+}
+
+bool RegionFile::isOpen() const
+{
+    return mp_file != nullptr;
+}
+
+bool RegionFile::readHeader()
+{
+    std::vector<unsigned char> header(HEADER_SIZE);
+    if(std::fseek(mp_file, 0, SEEK_SET) != 0 ||
+            std::fread(header.data(), 1, header.size(), mp_file) != header.size()) {
+        return false;
+    }
+    if(!std::equal(REGION_MAGIC, REGION_MAGIC + 4, header.begin()) ||
+            getU16(&header[4]) != VERSION || getU16(&header[6]) != CHUNKS_PER_SIDE) {
+        return false;
+    }
+    if(std::fseek(mp_file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    long fileSize = std::ftell(mp_file);
+    m_end = fileSize;
+    for(int i = 0; i < CHUNK_COUNT; ++i) {
+        Entry &e = m_table[i];
+        e.offset = getU32(&header[8 + 8 * i]);
+        e.length = getU32(&header[12 + 8 * i]);
+        // Ignore entries pointing outside the file (e.g. a torn append)
+        if(e.offset != 0 && (e.offset < HEADER_SIZE ||
+                             static_cast<long>(e.offset) + static_cast<long>(e.length) > fileSize)) {
+            e = Entry{0, 0};
+        }
+    }
+    return true;
+}
+
+bool RegionFile::writeHeader()
+{
+    std::vector<unsigned char> header(HEADER_SIZE, 0);
+    std::copy(REGION_MAGIC, REGION_MAGIC + 4, header.begin());
+    putU16(&header[4], VERSION);
+    putU16(&header[6], CHUNKS_PER_SIDE);
+    for(int i = 0; i < CHUNK_COUNT; ++i) {
+        putU32(&header[8 + 8 * i], m_table[i].offset);
+        putU32(&header[12 + 8 * i], m_table[i].length);
+    }
+    return std::fseek(mp_file, 0, SEEK_SET) == 0 &&
+           std::fwrite(header.data(), 1, header.size(), mp_file) == header.size();
+}
+
+bool RegionFile::writeEntry(int index)
+{
+    unsigned char bytes[8];
+    putU32(bytes, m_table[index].offset);
+    putU32(bytes + 4, m_table[index].length);
+    return std::fseek(mp_file, 8 + 8 * index, SEEK_SET) == 0 &&
+           std::fwrite(bytes, 1, 8, mp_file) == 8;
+}
+
+bool RegionFile::remap()
+{
+    unmap();
+    // Stdio may still be holding appended payloads
+    std::fflush(mp_file);
+    if(!m_mapFile.open(QFile::ReadOnly)) {
+        m_canMap = false;
+        return false;
+    }
+    qint64 size = m_mapFile.size();
+    uchar *p = size > 0 ? m_mapFile.map(0, size) : nullptr;
+    if(p == nullptr) {
+        m_mapFile.close();
+        m_canMap = false;
+        return false;
+    }
+    mp_map = p;
+    m_mapSize = static_cast<long>(size);
+    return true;
+}
+
+void RegionFile::unmap()
+{
+    if(mp_map != nullptr) {
+        m_mapFile.unmap(const_cast<uchar*>(mp_map));
+        mp_map = nullptr;
+        m_mapSize = 0;
+    }
+    if(m_mapFile.isOpen()) {
+        m_mapFile.close();
+    }
+}
+
+bool RegionFile::hasChunk(int localX, int localZ) const
+{
+    return m_table[localX + CHUNKS_PER_SIDE * localZ].offset != 0;
+}
+
+bool RegionFile::readPayload(int localX, int localZ, const unsigned char *&data, std::size_t &size)
+{
+    const Entry &e = m_table[localX + CHUNKS_PER_SIDE * localZ];
+    if(mp_file == nullptr || e.offset == 0) {
+        return false;
+    }
+    long end = static_cast<long>(e.offset) + static_cast<long>(e.length);
+    if(end > m_mapSize && m_canMap) {
+        // Appended since the last mapping (or never mapped)
+        remap();
+    }
+    if(end <= m_mapSize) {
+        m_mappedReads++;
+        data = mp_map + e.offset;
+        size = e.length;
+        return true;
+    }
+
+    m_bufferedReads++;
+    m_readBuffer.resize(e.length);
+    if(std::fseek(mp_file, e.offset, SEEK_SET) != 0 ||
+            std::fread(m_readBuffer.data(), 1, e.length, mp_file) != e.length) {
+        return false;
+    }
+    data = m_readBuffer.data();
+    size = e.length;
+    return true;
+}
+
+bool RegionFile::writePayload(int localX, int localZ, const std::vector<unsigned char> &payload)
+{
+    if(mp_file == nullptr) {
+        return false;
+    }
+    // Offsets and lengths are stored as u32. Reclaim abandoned payloads
+    // if the file would outgrow that; if it still would, don't write.
+    if(!fitsInTable(payload.size())) {
+        if(wastedBytes() == 0 || !compact() || !fitsInTable(payload.size())) {
+            return false;
+        }
+    }
+    int index = localX + CHUNKS_PER_SIDE * localZ;
+    Entry &e = m_table[index];
+    long offset = m_end;
+
+    if(std::fseek(mp_file, offset, SEEK_SET) != 0 ||
+            std::fwrite(payload.data(), 1, payload.size(), mp_file) != payload.size()) {
+        return false;
+    }
+    m_end += static_cast<long>(payload.size());
+    e.offset = static_cast<uint32_t>(offset);
+    e.length = static_cast<uint32_t>(payload.size());
+    return writeEntry(index);
+}
+
+bool RegionFile::fitsInTable(std::size_t payloadSize) const
+{
+    return static_cast<uint64_t>(m_end) + payloadSize <= UINT32_MAX;
+}
+
+void RegionFile::flush()
+{
+    if(mp_file != nullptr) {
+        std::fflush(mp_file);
+    }
+}
+
+bool RegionFile::sync()
+{
+    return mp_file != nullptr && syncFile(mp_file);
+}
+
+long RegionFile::wastedBytes() const
+{
+    long live = 0;
+    for(const Entry &e : m_table) {
+        live += e.length;
+    }
+    return m_end - HEADER_SIZE - live;
+}
+
+bool RegionFile::compact()
+{
+    if(mp_file == nullptr) {
+        return false;
+    }
+    std::string tmpPath = m_path + ".tmp";
+    std::FILE *out = std::fopen(tmpPath.c_str(), "w+b");
+    if(out == nullptr) {
+        return false;
+    }
+
+    std::array<Entry, CHUNK_COUNT> newTable{};
+    std::vector<unsigned char> buffer;
+    long end = HEADER_SIZE;
+    bool ok = std::fseek(out, HEADER_SIZE, SEEK_SET) == 0;
+    for(int i = 0; ok && i < CHUNK_COUNT; ++i) {
+        const Entry &e = m_table[i];
+        if(e.offset == 0) {
+            continue;
+        }
+        buffer.resize(e.length);
+        ok = std::fseek(mp_file, e.offset, SEEK_SET) == 0 &&
+             std::fread(buffer.data(), 1, e.length, mp_file) == e.length &&
+             std::fwrite(buffer.data(), 1, e.length, out) == e.length;
+        newTable[i] = Entry{static_cast<uint32_t>(end), e.length};
+        end += e.length;
+    }
+
+    // The header goes in last, and the whole file reaches the disk
+    // before it replaces the original
+    std::array<Entry, CHUNK_COUNT> oldTable = m_table;
+    std::FILE *oldFile = mp_file;
+    m_table = newTable;
+    mp_file = out;
+    ok = ok && writeHeader() && syncFile(out);
+    m_table = oldTable;
+    mp_file = oldFile;
+    if(!ok) {
+        std::fclose(out);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    // The mapping is of the file about to be replaced, and Windows
+    // won't replace a file that is still open
+    unmap();
+    std::fclose(oldFile);
+    mp_file = nullptr;
+    if(!replaceFile(tmpPath, m_path)) {
+        // The original is untouched: carry on with it
+        std::fclose(out);
+        std::remove(tmpPath.c_str());
+        mp_file = std::fopen(m_path.c_str(), "r+b");
+        if(mp_file != nullptr && !readHeader()) {
+            std::fclose(mp_file);
+            mp_file = nullptr;
+        }
+        return false;
+    }
+    syncParentDirectory(m_path);
+    m_table = newTable;
+    mp_file = out;
+    m_end = end;
+    return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <QFile>
+
+// One region file holds the saved blocks of a 32 x 32 square of Chunks
+// (512 x 512 blocks). Region (rx, rz) covers the Chunks whose world-space
+// origins lie in [rx * 512, rx * 512 + 512) x [rz * 512, rz * 512 + 512).
+//
+// Format, version 2 (all integers little endian):
+//   offset 0      4 bytes   magic "MMRG"
+//   offset 4      u16       format version (2)
+//   offset 6      u16       Chunks per side (32)
+//   offset 8      1024 x { u32 offset, u32 length }
+//                 The offset table, indexed by localX + 32 * localZ where
+//                 localX = (chunk origin x / 16) mod 32, likewise for z.
+//                 offset is from the start of the file; 0 means the Chunk
+//                 has never been saved.
+//   offset 8200   Payloads, stored back to back in no particular order.
+//                 Each starts with a one byte kind:
+//                   0  the Chunk's blocks, encoded by encodeChunkBlocks
+//                      (see chunkcodec.h); used for terrain that didn't
+//                      come from the generator
+//                   1  the player's edits to a generated Chunk, encoded
+//                      by ChunkDelta::encode (see chunkdelta.h)
+//                 RegionFile itself treats payloads as opaque bytes.
+//
+// Rewriting a Chunk appends a new payload and abandons the old one. A
+// payload is always written before the table entry that points at it, so
+// a crash mid-save leaves the previous version of that Chunk intact.
+// compact() rewrites the file without the abandoned bytes.
+//
+// Reads go through a read-only memory mapping of the whole file: a
+// payload is handed out as a pointer into the mapped pages and decoded
+// from there, with no read() into an intermediate buffer. Untouched regions therefore cost
+// no heap memory, and re-entering an explored area is served from the OS
+// page cache. Payloads appended after the file was mapped are picked up by
+// remapping on demand. If the file can't be mapped, reads fall back to
+// stdio.
+class RegionFile
+{
+public:
+    static constexpr int CHUNKS_PER_SIDE = 32;
+    static constexpr int CHUNK_COUNT = CHUNKS_PER_SIDE * CHUNKS_PER_SIDE;
+    static constexpr uint16_t VERSION = 2;
+    static constexpr long HEADER_SIZE = 8 + 8 * CHUNK_COUNT;
+
+    // Opens the region file at path, creating an empty one (and syncing
+    // its directory) if it doesn't exist yet. Check isOpen() afterwards.
+    RegionFile(const std::string &path);
+    ~RegionFile();
+
+    RegionFile(const RegionFile&) = delete;
+    RegionFile& operator=(const RegionFile&) = delete;
+
+    // False if the file couldn't be opened or created, or
+    // isn't a region file this code understands
+    bool isOpen() const;
+
+    // localX and localZ are Chunk indices within the region, in [0, 32)
+    bool hasChunk(int localX, int localZ) const;
+    // Points data at the saved payload. It stays valid until the next
+    // call that reads or writes this RegionFile. Returns false if the
+    // Chunk was never saved or its payload can't be read.
+    bool readPayload(int localX, int localZ, const unsigned char *&data, std::size_t &size);
+    // Stores a payload, replacing any older one for the same Chunk.
+    // Fails if the file would grow past 4 GB even after compact().
+    bool writePayload(int localX, int localZ, const std::vector<unsigned char> &payload);
+
+    // Pushes buffered writes to the OS
+    void flush();
+    // Flushes, then waits until the OS has the file on stable storage
+    bool sync();
+
+    // Bytes taken up by payloads that no table entry points at any more
+    long wastedBytes() const;
+    // Rewrites the file with only the live payloads, via a temporary
+    // file that replaces the original once it is complete and on disk.
+    // On failure the original file stays in place and in use.
+    bool compact();
+
+    // How many readPayload calls were served from the mapping,
+    // and how many had to fall back to stdio
+    std::size_t mappedReads() const { return m_mappedReads; }
+    std::size_t bufferedReads() const { return m_bufferedReads; }
+
+private:
+    struct Entry {
+        uint32_t offset, length;
+    };
+
+    // (Re)maps the whole file read-only; false if mapping isn't possible
+    bool remap();
+    void unmap();
+
+    bool readHeader();
+    bool writeHeader();
+    bool writeEntry(int index);
+    // Could a payload of this size be appended and still
+    // be addressed by the offset table?
+    bool fitsInTable(std::size_t payloadSize) const;
+
+    std::string m_path;
+    std::FILE *mp_file;
+    std::array<Entry, CHUNK_COUNT> m_table;
+    // Where the next appended payload goes
+    long m_end;
+
+    // Read-only mapping of bytes [0, m_mapSize) of the file
+    QFile m_mapFile;
+    const unsigned char *mp_map;
+    long m_mapSize;
+    // Cleared once mapping has failed, so reads stop retrying it
+    bool m_canMap;
+    // Reads served from the mapping vs. by stdio
+    std::size_t m_mappedReads, m_bufferedReads;
+    // Holds payloads read by stdio
+    std::vector<unsigned char> m_readBuffer;
+};
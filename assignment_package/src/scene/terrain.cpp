@@ -2,23 +2,125 @@
 #include <stdexcept>
 #include <iostream>
 #include <chrono>
+#include <algorithm>
 #include <QThreadPool>
 #include "chunkworkers.h"
+#include "chunkcodec.h"
+#include "frustum.h"
 
 #define TERRAIN_ZONE_RADIUS 3
+// Zones stream in within this many zones of the player's zone
+// (Chebyshev distance), and out beyond TERRAIN_UNLOAD_RADIUS
+#define TERRAIN_LOAD_RADIUS TERRAIN_ZONE_RADIUS
+#define TERRAIN_UNLOAD_RADIUS (TERRAIN_LOAD_RADIUS + 1)
+// Prefetching looks this far ahead along the player's velocity
+#define PREFETCH_SECONDS 3.f
+// Slower than this (blocks per second) the ring keeps up on its own
+#define PREFETCH_MIN_SPEED 12.f
+// Prefetch budget: zones started per tick, zones prefetched but not
+// yet reached, and how far out (in zones) prefetching may go
+#define PREFETCH_ZONES_PER_TICK 2
+#define PREFETCH_MAX_ZONES 16
+#define PREFETCH_MAX_RADIUS 8
+// Default memory budget for instantiated Chunks (64 KB each)
+#define HOT_CHUNK_BUDGET_BYTES (128u << 20)
+// Default budgets for evicted Chunks: run-length encoded in RAM, then
+// in a temporary file. Past both they're regenerated from the seed.
+#define COMPRESSED_CHUNK_BUDGET_BYTES (32u << 20)
+#define DISK_CHUNK_BUDGET_BYTES (256u << 20)
+// How often journaled edits are autosaved into the region files
+#define AUTOSAVE_SECONDS 30
+// Edited Chunks encoded per SaveWorker
+#define CHUNKS_PER_SAVE_WORKER 32
+// Threads reading and autosaving the world
+#define CHUNK_IO_THREADS 2
+// Default per-frame upload budget
+#define UPLOAD_BUDGET_MS 2.f
+#define UPLOAD_BUDGET_BYTES (16u << 20)
+// Seed for worlds that don't bring their own
+#define DEFAULT_TERRAIN_SEED 1337u
 
 using namespace std::chrono;
 using namespace glm;
 
 Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(),
-      m_chunksThatHaveBlockData(), m_blockDataLock(),
-      m_chunksThatHaveVBOData(), m_vboDataLock(),
+    : m_arena(context), m_chunks(), m_generatedTerrain(), m_renderList(),
+      m_drawOrder(), m_chunksThatHaveBlockData(), m_zonesLost(), m_blockDataLock(),
+      m_chunksThatHaveVBOData(), m_vboDataLock(), m_pendingUploads(),
+      m_uploadBudgetMs(UPLOAD_BUDGET_MS), m_uploadBudgetBytes(UPLOAD_BUDGET_BYTES),
+      m_uploadMs(0.f), m_maxUploadMs(0.f), m_uploads(0), m_uploadBytes(0), m_totalUploads(0),
+      m_keepCpuMeshes(false),
+      m_hotBudget(HOT_CHUNK_BUDGET_BYTES), m_zonesEvicted(0), m_zonesRehydrated(0),
+      m_residency(COMPRESSED_CHUNK_BUDGET_BYTES, DISK_CHUNK_BUDGET_BYTES),
+      m_cullZones(0), m_cullZonesCulled(0),
+      m_cullChunks(0), m_cullChunksCulled(0), m_cullChunksOccluded(0), m_cullChunksDrawn(0), m_cullChunksTransparent(0),
+      m_framesDrawn(0), m_totalChunksDrawn(0), m_totalChunksCulled(0), m_totalChunksOccluded(0),
+      m_occlusion(),
+      m_edits(), m_editsMerged(), m_seed(DEFAULT_TERRAIN_SEED), m_playerZone(0, 0), m_viewerPos(0.f), m_streamedZones(),
+      m_prefetchedZones(), m_prefetchCount(0), m_prefetchHits(0), m_prefetchMisses(0),
+      mp_world(nullptr), mp_journal(nullptr),
+      m_uncheckpointed(), m_lastAutosave(steady_clock::now()),
+      m_autosaveSeconds(AUTOSAVE_SECONDS), mp_autosave(nullptr),
+      m_autosaves(0), m_autosaveChunks(0), m_autosaveFreezeMs(0.f), m_maxAutosaveFreezeMs(0.f),
+      m_autosaveBytes(0), m_autosaveSerializeMs(0.f),
+      mp_io(nullptr), m_savedChunks(),
+      mp_meshCache(nullptr), m_useMeshCache(false),
+      m_unloadedBlockType(EMPTY),
       mp_context(context)
 {}
 
 Terrain::~Terrain()
 {
+    // Workers hold raw pointers to our Chunks, including those
+    // still parked on a mesh cache read
+    if(mp_meshCache != nullptr) {
+        mp_meshCache->startOverdue(true);
+    }
+    QThreadPool::globalInstance()->waitForDone();
+    if(mp_io != nullptr) {
+        mp_io->waitForDone();
+    }
+    saveWorld();
+    if(mp_io != nullptr) {
+        mp_io->waitForDone();
+    }
+    // Finishes the checkpoint before the world closes
+    mp_journal.reset();
+    if(m_prefetchCount > 0) {
+        std::cout << "Prefetch: " << m_prefetchCount << " zones, " << m_prefetchHits
+                  << " hits, " << m_prefetchMisses << " misses" << std::endl;
+    }
+    if(m_framesDrawn > 0) {
+        std::cout << "Culling: " << m_totalChunksDrawn / m_framesDrawn << " Chunks drawn, "
+                  << m_totalChunksCulled / m_framesDrawn << " outside the frustum and "
+                  << m_totalChunksOccluded / m_framesDrawn << " hidden per frame" << std::endl;
+    }
+    if(m_autosaves > 0) {
+        std::cout << "Autosave: " << m_autosaves << " autosaves, longest pause "
+                  << m_maxAutosaveFreezeMs << " ms" << std::endl;
+    }
+    if(m_totalUploads > 0) {
+        std::cout << "Uploads: " << m_totalUploads << " meshes, slowest frame "
+                  << m_maxUploadMs << " ms" << std::endl;
+    }
+    GpuArena::Stats a = m_arena.stats();
+    std::cout << "GPU arena: " << a.pages << " pages, " << (a.vertexBytesUsed >> 20) << " of "
+              << (a.vertexBytes >> 20) << " MB of vertices and " << (a.indexBytesUsed >> 20) << " of "
+              << (a.indexBytes >> 20) << " MB of indices in use, "
+              << static_cast<int>(100 * a.fragmentation) << "% fragmented";
+    if(m_framesDrawn > 0) {
+        std::cout << ", drawn with " << (a.multiDraw ? "multi-draw" : "one draw per Chunk");
+    }
+    std::cout << std::endl;
+    std::cout << "Mesh RAM: " << (cpuMeshBytes() >> 20) << " MB of CPU copies for "
+              << ((a.vertexBytesUsed + a.indexBytesUsed) >> 20) << " MB of meshes on the GPU" << std::endl;
+    if(mp_meshCache != nullptr) {
+        MeshCache::Stats m = mp_meshCache->stats();
+        std::cout << "Mesh cache: " << m.hits << " hits, " << m.misses << " misses, "
+                  << m.unanswered << " not read in time, " << m.stores << " stored, "
+                  << m.storesSkipped << " already cached, "
+                  << (m.bytesRead >> 10) << " KB read, " << (m.bytesWritten >> 10) << " KB written" << std::endl;
+    }
 }
 
 // Combine two 32-bit ints into one 64-bit int
@@ -107,6 +209,12 @@ const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
     return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
 }
 
+Chunk* Terrain::findChunkAt(int x, int z) const {
+    // & ~15 floors to the nearest multiple of 16, negative numbers included
+    auto it = m_chunks.find(toKey(x & ~15, z & ~15));
+    return it == m_chunks.end() ? nullptr : it->second.get();
+}
+
 void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 {
     if(hasChunkAt(x, z)) {
@@ -116,6 +224,7 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
                       static_cast<unsigned int>(y),
                       static_cast<unsigned int>(z - chunkOrigin.y),
                       t);
+        recordEdit(c.get(), x, y, z, t);
         //To ensure new block is placed/broken in draw
         m_blockDataLock.lock();
         m_chunksThatHaveBlockData.insert(c.get());
@@ -128,8 +237,54 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
     }
 }
 
+std::optional<BlockType> Terrain::tryGetBlockAt(int x, int y, int z) const
+{
+    const Chunk *c = findChunkAt(x, z);
+    if(c == nullptr) {
+        return std::nullopt;
+    }
+    // Same height rule as getBlockAt
+    if(y < 0 || y >= 256) {
+        return EMPTY;
+    }
+    return c->getBlockAtUnchecked(x & 15, y, z & 15);
+}
+
+BlockType Terrain::getBlockAtOrDefault(int x, int y, int z) const
+{
+    return tryGetBlockAt(x, y, z).value_or(m_unloadedBlockType);
+}
+
+bool Terrain::trySetBlockAt(int x, int y, int z, BlockType t)
+{
+    Chunk *c = findChunkAt(x, z);
+    if(c == nullptr || y < 0 || y >= 256) {
+        return false;
+    }
+    c->setBlockAt(static_cast<unsigned int>(x & 15),
+                  static_cast<unsigned int>(y),
+                  static_cast<unsigned int>(z & 15),
+                  t);
+    recordEdit(c, x, y, z, t);
+    //To ensure new block is placed/broken in draw
+    m_blockDataLock.lock();
+    m_chunksThatHaveBlockData.insert(c);
+    m_blockDataLock.unlock();
+    return true;
+}
+
+void Terrain::setUnloadedBlockType(BlockType t)
+{
+    m_unloadedBlockType = t;
+}
+
+BlockType Terrain::getUnloadedBlockType() const
+{
+    return m_unloadedBlockType;
+}
+
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
-    uPtr<Chunk> chunk = mkU<Chunk>(this->mp_context, x, z);
+    uPtr<Chunk> chunk = mkU<Chunk>(this->mp_context, &m_arena, x, z);
     Chunk *cPtr = chunk.get();
     m_chunks[toKey(x, z)] = std::move(chunk);
     // Set the neighbor pointers of itself and its neighbors
@@ -152,23 +307,494 @@ Chunk* Terrain::instantiateChunkAt(int x, int z) {
     return cPtr;
 }
 
+void Terrain::recordEdit(Chunk *c, int x, int y, int z, BlockType t)
+{
+    int64_t key = toKey(c->m_xChunk, c->m_zChunk);
+    editsFor(key).record(x & 15, y, z & 15, t);
+    m_uncheckpointed.insert(key);
+    if(mp_journal != nullptr) {
+        mp_journal->append(x, y, z, t);
+    }
+}
+
+ChunkDelta& Terrain::editsFor(int64_t key)
+{
+    // Saved edits are merged in when the Chunk's zone is loaded
+    // (mergeSavedEdits) or by the next autosave, never read here
+    return m_edits[key];
+}
+
+void Terrain::mergeSavedEdits(int64_t key, ChunkDelta &&saved)
+{
+    auto it = m_edits.find(key);
+    if(it == m_edits.end()) {
+        m_edits.emplace(key, std::move(saved));
+    }
+    else if(m_editsMerged.count(key) == 0) {
+        saved.overlay(it->second);
+        it->second = std::move(saved);
+    }
+    m_editsMerged.insert(key);
+}
+
+void Terrain::applyEdits(Chunk *c)
+{
+    int64_t key = toKey(c->m_xChunk, c->m_zChunk);
+    auto it = m_edits.find(key);
+    if(it != m_edits.end()) {
+        it->second.applyTo(*c);
+    }
+}
+
+void Terrain::applySavedBlocks(Chunk *c)
+{
+    int64_t key = toKey(c->m_xChunk, c->m_zChunk);
+    auto it = m_savedChunks.find(key);
+    if(it != m_savedChunks.end()) {
+        SavedChunk &saved = it->second;
+        if(saved.hasBlocks) {
+            decodeChunkBlocks(saved.blocks.data(), saved.blocks.size(), *c);
+            c->m_generated = false;
+            m_editsMerged.insert(key);
+        }
+        // Edits from an earlier session, under any made since
+        else if(saved.hasEdits) {
+            mergeSavedEdits(key, std::move(saved.edits));
+        }
+        m_savedChunks.erase(it);
+    }
+    applyEdits(c);
+}
+
+bool Terrain::autosaveRunning()
+{
+    if(mp_autosave == nullptr) {
+        return false;
+    }
+    QMutexLocker locker(&mp_autosave->lock);
+    return !mp_autosave->done;
+}
+
+bool Terrain::startAutosave()
+{
+    m_lastAutosave = steady_clock::now();
+    if(mp_journal == nullptr || autosaveRunning()) {
+        return false;
+    }
+    // The last autosave kept the journal for these; try them again
+    if(mp_autosave != nullptr) {
+        for(const glm::ivec2 &c : mp_autosave->failed) {
+            m_uncheckpointed.insert(toKey(c.x, c.y));
+        }
+        m_autosaveBytes = mp_autosave->bytes;
+        m_autosaveSerializeMs = static_cast<float>(mp_autosave->serializeMs);
+        mp_autosave = nullptr;
+    }
+    if(m_uncheckpointed.empty()) {
+        return false;
+    }
+
+    // Everything up to the first SaveWorker starting happens between
+    // ticks, so keep it to copies: the edits are shared copy-on-write,
+    // and only Chunks saved whole (not the generated ones) are copied.
+    auto start = steady_clock::now();
+    sPtr<AutosaveBatch> batch = mkS<AutosaveBatch>();
+    batch->journal = mp_journal.get();
+    batch->storage = mp_world.get();
+    batch->mark = mp_journal->mark();
+    batch->start = start;
+    batch->bytes = 0;
+    batch->serializeMs = 0;
+    batch->done = false;
+
+    std::vector<std::vector<ChunkSaveSnapshot>> work(1);
+    for(int64_t key : m_uncheckpointed) {
+        if(work.back().size() == CHUNKS_PER_SAVE_WORKER) {
+            work.emplace_back();
+        }
+        glm::ivec2 coords = toCoords(key);
+        ChunkSaveSnapshot snap;
+        snap.x = coords.x;
+        snap.z = coords.y;
+        snap.edits = editsFor(key);
+        snap.mergeSaved = mp_world != nullptr && m_editsMerged.count(key) == 0;
+        const Chunk *c = findChunkAt(coords.x, coords.y);
+        if(c != nullptr && !c->m_awaitingBlocks && !c->m_generated) {
+            snap.blocks = mkU<ChunkBlocks>(*c);
+        }
+        work.back().push_back(std::move(snap));
+    }
+    m_autosaveChunks = m_uncheckpointed.size();
+    m_uncheckpointed.clear();
+
+    batch->workersLeft = static_cast<int>(work.size());
+    mp_autosave = batch;
+    for(auto &snapshots : work) {
+        mp_io->startBackground(new SaveWorker(std::move(snapshots), batch));
+    }
+    m_autosaves++;
+    m_autosaveFreezeMs = duration<float, std::milli>(steady_clock::now() - start).count();
+    m_maxAutosaveFreezeMs = glm::max(m_maxAutosaveFreezeMs, m_autosaveFreezeMs);
+    return true;
+}
+
+Terrain::AutosaveStats Terrain::autosaveStats() const
+{
+    AutosaveStats s{m_autosaves, m_autosaveChunks, m_autosaveFreezeMs, m_maxAutosaveFreezeMs,
+                    m_autosaveBytes, m_autosaveSerializeMs};
+    // Not collected until the next autosave starts
+    if(mp_autosave != nullptr) {
+        QMutexLocker locker(&mp_autosave->lock);
+        if(mp_autosave->done) {
+            s.bytes = mp_autosave->bytes;
+            s.serializeMs = static_cast<float>(mp_autosave->serializeMs);
+        }
+    }
+    return s;
+}
+
+void Terrain::setAutosaveInterval(int seconds)
+{
+    m_autosaveSeconds = seconds;
+}
+
+void Terrain::setMeshCacheEnabled(bool enabled)
+{
+    m_useMeshCache = enabled;
+}
+
+void Terrain::setResidencyBudget(std::size_t hotBytes, std::size_t compressedBytes,
+                                 std::size_t diskBytes)
+{
+    m_hotBudget = hotBytes;
+    m_residency.setBudgets(compressedBytes, diskBytes);
+}
+
+Terrain::ResidencyStats Terrain::residencyStats() const
+{
+    ResidencyStats s{};
+    s.hotChunks = Chunk::poolStats().inUse;
+    s.hotBytes = s.hotChunks * sizeof(Chunk);
+    ChunkResidency::Stats r = m_residency.stats();
+    s.compressedChunks = r.compressedChunks;
+    s.compressedBytes = r.compressedBytes;
+    s.diskChunks = r.diskChunks;
+    s.diskBytes = r.diskBytes;
+    s.chunksDropped = r.dropped;
+    s.lastPromotionMs = r.lastPromotionMs;
+    s.avgPromotionMs = r.avgPromotionMs;
+    s.maxPromotionMs = r.maxPromotionMs;
+    s.editedChunks = m_edits.size();
+    for(auto &kv : m_edits) {
+        s.editedBlocks += kv.second.size();
+        s.editBytes += kv.second.memoryBytes();
+    }
+    s.zonesEvicted = m_zonesEvicted;
+    s.zonesRehydrated = m_zonesRehydrated;
+    return s;
+}
+
+void Terrain::setSeed(uint32_t seed)
+{
+    m_seed = seed;
+}
+
+uint32_t Terrain::getSeed() const
+{
+    return m_seed;
+}
+
+bool Terrain::canEvict(const Chunk *c) const
+{
+    if(c->m_awaitingBlocks || c->m_meshJobs > 0) {
+        return false;
+    }
+    // A neighbor's VBOWorker may be reading this Chunk's border
+    for(Direction d : {XPOS, XNEG, ZPOS, ZNEG}) {
+        const Chunk *n = c->getNeighbor(d);
+        if(n != nullptr && n->m_meshJobs > 0) {
+            return false;
+        }
+    }
+    // Edited, but not yet handed to a VBOWorker
+    return m_chunksThatHaveBlockData.count(const_cast<Chunk*>(c)) == 0;
+}
+
+void Terrain::evictZone(int64_t id)
+{
+    glm::ivec2 coords = toCoords(id);
+    for(int x = coords.x; x < coords.x + 64; x+=16) {
+        for(int z = coords.y; z < coords.y + 64; z+=16) {
+            auto it = m_chunks.find(toKey(x, z));
+            if(it == m_chunks.end() || it->second == nullptr) {
+                continue;
+            }
+            // Its edits stay in m_edits (and the journal) too, for
+            // when it has to be regenerated
+            Chunk *c = it->second.get();
+            m_residency.demote(it->first, *c, c->m_generated);
+            removeFromRenderList(c);
+            c->destroyVBOdata();
+            c->unlinkNeighbors();
+            // Returns the Chunk's slot to the pool
+            m_chunks.erase(it);
+        }
+    }
+    m_generatedTerrain.erase(id);
+    m_zonesEvicted++;
+}
+
+bool Terrain::rehydrateZone(int64_t id)
+{
+    glm::ivec2 coords = toCoords(id);
+    bool complete = true;
+    for(int x = coords.x; x < coords.x + 64; x+=16) {
+        for(int z = coords.y; z < coords.y + 64; z+=16) {
+            complete = complete && m_residency.contains(toKey(x, z));
+        }
+    }
+    if(!complete) {
+        //some were dropped: load the whole zone afresh
+        for(int x = coords.x; x < coords.x + 64; x+=16) {
+            for(int z = coords.y; z < coords.y + 64; z+=16) {
+                m_residency.forget(toKey(x, z));
+            }
+        }
+        return false;
+    }
+
+    this->m_generatedTerrain.insert(id);
+    std::vector<Chunk*> chunksToFill;
+    for(int x = coords.x; x < coords.x + 64; x+=16) {
+        for(int z = coords.y; z < coords.y + 64; z+=16) {
+            Chunk* chunk = instantiateChunkAt(x,z);
+            chunk->m_count = 0;
+            chunk->m_awaitingBlocks = true;
+            chunksToFill.push_back(chunk);
+        }
+    }
+    RehydrateWorker* worker = new RehydrateWorker(&m_residency, id, chunksToFill,
+                                                  &m_chunksThatHaveBlockData,
+                                                  &m_zonesLost, &m_blockDataLock);
+    //same priority as generating it would have had
+    int dist = glm::max(glm::abs(coords.x - m_playerZone.x),
+                        glm::abs(coords.y - m_playerZone.y)) / 64;
+    QThreadPool::globalInstance()->start(worker, -1 - dist);
+    m_zonesRehydrated++;
+    return true;
+}
+
+void Terrain::reloadLostZones()
+{
+    m_blockDataLock.lock();
+    std::vector<int64_t> lost;
+    lost.swap(m_zonesLost);
+    m_blockDataLock.unlock();
+
+    std::vector<int64_t> waiting;
+    for(int64_t id : lost) {
+        glm::ivec2 coords = toCoords(id);
+        std::vector<int64_t> keys;
+        bool busy = false;
+        for(int x = coords.x; x < coords.x + 64; x+=16) {
+            for(int z = coords.y; z < coords.y + 64; z+=16) {
+                keys.push_back(toKey(x, z));
+                auto it = m_chunks.find(keys.back());
+                if(it == m_chunks.end() || it->second == nullptr) {
+                    continue;
+                }
+                // A neighbor's VBOWorker may be reading its border
+                for(Direction d : {XPOS, XNEG, ZPOS, ZNEG}) {
+                    const Chunk *n = it->second->getNeighbor(d);
+                    busy = busy || (n != nullptr && n->m_meshJobs > 0);
+                }
+            }
+        }
+        if(busy) {
+            waiting.push_back(id);
+            continue;
+        }
+        // Never handed over, so never meshed or drawn
+        for(int64_t key : keys) {
+            auto it = m_chunks.find(key);
+            if(it != m_chunks.end() && it->second != nullptr) {
+                it->second->unlinkNeighbors();
+                m_chunks.erase(it);
+            }
+            // Whatever the worker left behind would be stale
+            m_residency.forget(key);
+        }
+        m_generatedTerrain.erase(id);
+        int dist = glm::max(glm::abs(coords.x - m_playerZone.x),
+                            glm::abs(coords.y - m_playerZone.y)) / 64;
+        requestTerrainZone(id, dist);
+    }
+
+    m_blockDataLock.lock();
+    m_zonesLost.insert(m_zonesLost.end(), waiting.begin(), waiting.end());
+    m_blockDataLock.unlock();
+}
+
+void Terrain::enforceResidencyBudget()
+{
+    std::size_t hotBytes = Chunk::poolStats().inUse * sizeof(Chunk);
+    if(hotBytes <= m_hotBudget) {
+        return;
+    }
+
+    // Zones farthest from the player first. Keep the rendered zones
+    // and the ring around them, whose blocks the rendered Chunks'
+    // meshes depend on.
+    std::vector<std::pair<int, int64_t>> candidates;
+    m_blockDataLock.lock();
+    for(int64_t id : m_generatedTerrain) {
+        glm::ivec2 coords = toCoords(id);
+        int dist = glm::max(glm::abs(coords.x - m_playerZone.x),
+                            glm::abs(coords.y - m_playerZone.y)) / 64;
+        if(dist <= TERRAIN_UNLOAD_RADIUS || m_prefetchedZones.count(id) != 0) {
+            continue;
+        }
+        bool evictable = true;
+        for(int x = coords.x; evictable && x < coords.x + 64; x+=16) {
+            for(int z = coords.y; evictable && z < coords.y + 64; z+=16) {
+                const Chunk *c = findChunkAt(x, z);
+                evictable = c != nullptr && canEvict(c);
+            }
+        }
+        if(evictable) {
+            candidates.push_back({dist, id});
+        }
+    }
+    m_blockDataLock.unlock();
+    if(candidates.empty()) {
+        return;
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<int, int64_t> &a, const std::pair<int, int64_t> &b) {
+                  return a.first > b.first;
+              });
+
+    for(auto &cand : candidates) {
+        if(hotBytes <= m_hotBudget) {
+            break;
+        }
+        evictZone(cand.second);
+        hotBytes -= 16 * sizeof(Chunk);
+    }
+}
+
 //TODO: m3: draw chunk border?
-void Terrain::draw(int currX, int currZ, ShaderProgram *shaderProgram)
+void Terrain::draw(int currX, int currZ, const glm::mat4 &viewProj, glm::vec3 eye,
+                   ShaderProgram *shaderProgram)
 {
     //for all terrains being rendered
     // so 3 terrains in each direction + self
     // so 7*7 = 49 terrains
     // 49*4*4 = 784 Chunks
     // 784*16*16 = 200,704 blocks in entire render
-    int rad = TERRAIN_ZONE_RADIUS;
-    for(int x = currX - 64*rad; x < currX + 64*(rad+1); x += 16) {
-        for(int z = currZ - 64*rad; z < currZ + 64*(rad+1); z += 16) {
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-            if(chunk!=nullptr) {
-                shaderProgram->drawInter(*chunk);
+    // The render list also holds the unload ring and prefetched zones
+    const int rad = TERRAIN_ZONE_RADIUS;
+    const int side = 2*rad + 1;
+    int minX = currX - 64*rad, maxX = currX + 64*(rad+1);
+    int minZ = currZ - 64*rad, maxZ = currZ + 64*(rad+1);
+    Frustum frustum(viewProj);
+    m_cullZones = m_cullZonesCulled = 0;
+    m_cullChunks = m_cullChunksCulled = m_cullChunksOccluded = 0;
+
+    // A zone entirely off screen takes its 16 Chunks with it
+    std::array<bool, side*side> zoneVisible;
+    for(int zi = 0; zi < side; zi++) {
+        for(int xi = 0; xi < side; xi++) {
+            glm::vec3 lo(minX + 64*xi, 0, minZ + 64*zi);
+            bool visible = frustum.intersects(lo, lo + glm::vec3(64, 256, 64));
+            zoneVisible[zi*side + xi] = visible;
+            m_cullZones++;
+            if(!visible) {
+                m_cullZonesCulled++;
             }
         }
     }
+
+    // Sections behind solid terrain, as seen from the camera's section
+    // last frame; this frame's camera starts the next fill. The fill
+    // looks every way, so only this frame's frustum culls.
+    m_occlusion.update(eye, minX, minZ, maxX, maxZ, [this](int x, int z) {
+        Chunk *c = findChunkAt(x, z);
+        return (c != nullptr && c->m_renderIndex >= 0) ? &c->m_sections : nullptr;
+    });
+
+    m_drawOrder.clear();
+    for(Chunk *chunk : m_renderList) {
+        if(chunk->m_xChunk < minX || chunk->m_xChunk >= maxX ||
+                chunk->m_zChunk < minZ || chunk->m_zChunk >= maxZ) {
+            continue;
+        }
+        m_cullChunks++;
+        int xi = (chunk->m_xChunk - minX) / 64, zi = (chunk->m_zChunk - minZ) / 64;
+        glm::vec3 lo(chunk->m_xChunk, chunk->m_gpuMinY, chunk->m_zChunk);
+        glm::vec3 hi(chunk->m_xChunk + 16, chunk->m_gpuMaxY, chunk->m_zChunk + 16);
+        if(chunk->m_gpuMinY >= chunk->m_gpuMaxY || !zoneVisible[zi*side + xi] ||
+                !frustum.intersects(lo, hi)) {
+            m_cullChunksCulled++;
+            continue;
+        }
+        if(m_occlusion.visibleSections(chunk->m_xChunk, chunk->m_zChunk) == 0) {
+            m_cullChunksOccluded++;
+            continue;
+        }
+        glm::vec3 offset = 0.5f * (lo + hi) - eye;
+        m_drawOrder.emplace_back(glm::dot(offset, offset), chunk);
+    }
+
+    // Nearest first. The one sort serves both passes: the transparent
+    // pass walks it backwards.
+    std::sort(m_drawOrder.begin(), m_drawOrder.end(),
+              [](const std::pair<float, Chunk*> &a, const std::pair<float, Chunk*> &b) {
+        return a.first < b.first;
+    });
+
+    // Opaque faces front to back, so nearer Chunks fill the depth
+    // buffer first, with nothing to blend
+    for(const auto &entry : m_drawOrder) {
+        const Chunk *c = entry.second;
+        m_arena.queue(c->m_mesh, 0, c->m_gpuOpaque);
+    }
+    mp_context->glDisable(GL_BLEND);
+    m_arena.drawQueued(*shaderProgram);
+    mp_context->glEnable(GL_BLEND);
+
+    // Then water, ice and lava back to front, blended over what's
+    // behind them. They are depth tested against the opaque faces but
+    // don't write depth, so they never hide each other.
+    m_cullChunksTransparent = 0;
+    for(auto it = m_drawOrder.rbegin(); it != m_drawOrder.rend(); ++it) {
+        const Chunk *c = it->second;
+        if(c->m_gpuTrans > 0) {
+            m_arena.queue(c->m_mesh, c->m_gpuOpaque, c->m_gpuTrans);
+            m_cullChunksTransparent++;
+        }
+    }
+    if(m_cullChunksTransparent > 0) {
+        mp_context->glDepthMask(GL_FALSE);
+        m_arena.drawQueued(*shaderProgram, true);
+        mp_context->glDepthMask(GL_TRUE);
+    }
+    m_cullChunksDrawn = m_drawOrder.size();
+    m_framesDrawn++;
+    m_totalChunksDrawn += m_cullChunksDrawn;
+    m_totalChunksCulled += m_cullChunksCulled;
+    m_totalChunksOccluded += m_cullChunksOccluded;
+}
+
+GpuArena::Stats Terrain::arenaStats() const
+{
+    return m_arena.stats();
+}
+
+Terrain::CullStats Terrain::cullStats() const
+{
+    return {m_cullZones, m_cullZonesCulled, m_cullChunks, m_cullChunksCulled,
+            m_cullChunksOccluded, m_cullChunksDrawn, m_cullChunksTransparent, m_framesDrawn};
 }
 
 bool Terrain::terrainZoneExists(int64_t id)
@@ -198,11 +824,35 @@ void Terrain::spawnVBOWorker(Chunk* chunk, int time)
     /*
     //spawn vbo worker
     */
+    chunk->m_meshJobs++;
+    glm::ivec2 zone(64 * static_cast<int>(glm::floor(chunk->m_xChunk / 64.f)),
+                    64 * static_cast<int>(glm::floor(chunk->m_zChunk / 64.f)));
+    int dist = glm::max(glm::abs(zone.x - m_playerZone.x),
+                        glm::abs(zone.y - m_playerZone.y)) / 64;
+    //meshing in the ring goes ahead of all generation (priority 0);
+    //prefetched zones queue by distance like their generation, so
+    //they never hold up work near the player
+    int priority = m_prefetchedZones.count(toKey(zone.x, zone.y)) != 0 ? -1 - dist : 0;
+    sPtr<MeshCache::Lookup> lookup = nullptr;
+    if(mp_meshCache != nullptr) {
+        //the cached mesh is read on the I/O threads, and the
+        //worker only queues once the read has answered
+        lookup = mkS<MeshCache::Lookup>();
+        mp_io->startRead(mp_meshCache->readJob(chunk->m_xChunk, chunk->m_zChunk, lookup), dist);
+    }
     VBOWorker* worker = new VBOWorker(chunk,
                                   &m_chunksThatHaveVBOData,
                                   &m_vboDataLock,
-                                  time);
-    QThreadPool::globalInstance()->start(worker);
+                                  time,
+                                  mp_meshCache.get(),
+                                  lookup,
+                                  mp_io.get());
+    if(mp_meshCache != nullptr) {
+        mp_meshCache->startWhenAnswered(lookup, worker, priority);
+    }
+    else {
+        QThreadPool::globalInstance()->start(worker, priority);
+    }
 }
 
 //creating chunks from scratch
@@ -221,95 +871,428 @@ void Terrain::spawnFBMWorker(int64_t terrZoneId)
 //            chunk->m_countTrans = 0;
 //            chunk->m_countOpaque = 0;
             chunk->m_count = 0;
+            chunk->m_awaitingBlocks = true;
             chunksThatNeedBlockType.push_back(chunk);
         }
     }
     //FBM worker calls
-    FBMWorker* worker = new FBMWorker(coords.x, coords.y,
+    FBMWorker* worker = new FBMWorker(coords.x, coords.y, m_seed,
                                       chunksThatNeedBlockType,
                                       &m_chunksThatHaveBlockData,
                                       &m_blockDataLock);
-    QThreadPool::globalInstance()->start(worker);
+    //nearer zones first, so prefetched ones never hold up the ring;
+    //meshing (priority 0) goes ahead of all generation
+    int dist = glm::max(glm::abs(coords.x - m_playerZone.x),
+                        glm::abs(coords.y - m_playerZone.y)) / 64;
+    QThreadPool::globalInstance()->start(worker, -1 - dist);
 }
 
 
-//loading initial terrain with respect to
-//initial position @ (x=52,z=42) => terrain origin @ (0,0)
-//terrain: 7*7 terrain zones
-void Terrain::loadInitialTerrain()
+bool Terrain::openWorld(const std::string &dir)
 {
-    glm::ivec2 currZonePos(0,0);
-    std::unordered_set<int64_t> currZoneArea = findTerrainZoneArea(currZonePos, TERRAIN_ZONE_RADIUS);
-    std::cout << "Zones: " << currZoneArea.size() << std::endl;
+    uPtr<WorldStorage> world = mkU<WorldStorage>(dir, m_seed);
+    if(!world->isOpen()) {
+        return false;
+    }
+    m_seed = world->seed();
+    mp_world = std::move(world);
+    mp_io = mkU<ChunkIO>(mp_world.get(), CHUNK_IO_THREADS);
+    if(m_useMeshCache) {
+        mp_meshCache = mkU<MeshCache>(dir);
+    }
+
+    // Edits made after the last checkpoint of an earlier session
+    mp_journal = mkU<EditJournal>(dir + "/edits.journal", mp_world.get());
+    std::vector<EditJournal::Record> replayed = mp_journal->replay();
+    for(const EditJournal::Record &r : replayed) {
+        int64_t key = toKey(r.x & ~15, r.z & ~15);
+        editsFor(key).record(r.x & 15, r.y, r.z & 15, r.type);
+        m_uncheckpointed.insert(key);
+    }
+    if(!replayed.empty()) {
+        std::cout << "Replayed " << replayed.size() << " journaled edits" << std::endl;
+    }
+    mp_journal->start();
+    return true;
+}
 
-    for(auto id: currZoneArea)
+void Terrain::saveWorld()
+{
+    if(mp_world == nullptr) {
+        return;
+    }
+    // Two autosaves in flight could land out of order
+    if(autosaveRunning()) {
+        mp_io->waitForDone();
+    }
+    startAutosave();
+}
+
+void Terrain::requestTerrainZone(int64_t id, int distance)
+{
+    //evicted earlier: no need to read or generate it
+    if(rehydrateZone(id)) {
+        return;
+    }
+    if(mp_io == nullptr) {
         spawnFBMWorker(id);
+        return;
+    }
+    // Claimed now so the zone isn't requested twice while it's read
+    this->m_generatedTerrain.insert(id);
+    mp_io->loadZone(id, distance);
 }
 
-/*
- * spawn FBM worker for border IDs,
- * storing in a different chunksTHBlockData vector
- * Create VBOs for all, area and border
- * But don't pass border to GPU
- * During try expansion -
- * If expansion needed
- *  destroy outside range
- *
- */
+void Terrain::receiveLoadedZones()
+{
+    if(mp_io == nullptr) {
+        return;
+    }
+    for(ChunkIO::ZoneLoad &load : mp_io->takeCompleted()) {
+        if(loadTerrainZone(load)) {
+            continue;
+        }
+        // Generated, then patched with whatever was saved
+        for(SavedChunk &saved : load.chunks) {
+            int64_t key = toKey(saved.x, saved.z);
+            if(saved.hasBlocks || saved.hasEdits) {
+                m_savedChunks[key] = std::move(saved);
+            }
+            else {
+                //nothing saved: nothing to merge
+                m_editsMerged.insert(key);
+            }
+        }
+        spawnFBMWorker(load.zoneId);
+    }
+}
 
-void Terrain::tryExpansion(glm::vec3 prevPos, glm::vec3 currPos, int time)
+bool Terrain::loadTerrainZone(ChunkIO::ZoneLoad &load)
 {
-    if(prevPos==currPos)
+    for(const SavedChunk &saved : load.chunks) {
+        if(!saved.hasBlocks)
+            return false;
+    }
+
+    std::vector<Chunk*> loaded;
+    for(SavedChunk &saved : load.chunks) {
+        Chunk* chunk = instantiateChunkAt(saved.x, saved.z);
+        chunk->m_count = 0;
+        chunk->m_generated = false;
+        decodeChunkBlocks(saved.blocks.data(), saved.blocks.size(), *chunk);
+        m_editsMerged.insert(toKey(saved.x, saved.z));
+        applyEdits(chunk);
+        loaded.push_back(chunk);
+    }
+    //mesh them alongside freshly generated chunks
+    m_blockDataLock.lock();
+    m_chunksThatHaveBlockData.insert(loaded.begin(), loaded.end());
+    m_blockDataLock.unlock();
+    return true;
+}
+
+void Terrain::streamZoneIn(int64_t id, int distance, int time)
+{
+    m_streamedZones.insert(id);
+    if(m_prefetchedZones.erase(id) != 0) {
+        //generated and meshed (or on its way) already
+        m_prefetchHits++;
+        return;
+    }
+    if(!terrainZoneExists(id)) {
+        requestTerrainZone(id, distance);
         return;
+    }
+    glm::ivec2 coord = toCoords(id);
+    for(int x = coord.x; x < coord.x + 64; x+=16) {
+        for(int z = coord.y; z < coord.y + 64; z+=16) {
+            //still being read from the world
+            Chunk *chunk = findChunkAt(x,z);
+            //meshed once its blocks are in
+            if(chunk == nullptr || chunk->m_awaitingBlocks)
+                continue;
+            chunk->m_count = 0;
+            //this should reallocate VBOs
+            spawnVBOWorker(chunk, time);
+        }
+    }
+}
 
-    //check if moved to a new terrain zone since last tick
-    glm::ivec2 prevZonePos(64*static_cast<int>(glm::floor(prevPos.x / 64.f)),
-                        64*static_cast<int>(glm::floor(prevPos.z / 64.f)));
-    glm::ivec2 currZonePos(64*static_cast<int>(glm::floor(currPos.x / 64.f)),
-                        64*static_cast<int>(glm::floor(currPos.z / 64.f)));
-
-    //Terrain Zone Radius SET TO 3 FOR NOW
-    //USING RADIUS+1 to account for border VBO (not rendered)
-    std::unordered_set<int64_t> currZoneArea = findTerrainZoneArea(currZonePos, TERRAIN_ZONE_RADIUS);
-    std::unordered_set<int64_t> prevZoneArea = findTerrainZoneArea(prevZonePos, TERRAIN_ZONE_RADIUS);
-
-    //destroying terrain zones/chunks that are not in radius anymore
-    for(auto id: prevZoneArea) {
-        //not in new terrain zones
-        if(currZoneArea.count(id)==0)
-        {
-            glm::ivec2 coord = toCoords(id);
-            for(int x = coord.x; x < coord.x + 64; x++) {
-                for(int z = coord.y; z < coord.y + 64; z++) {
-                    auto &chunk = getChunkAt(x,z);
-                    chunk->destroyVBOdata();
-                }
+void Terrain::streamZoneOut(int64_t id)
+{
+    glm::ivec2 coord = toCoords(id);
+    for(int x = coord.x; x < coord.x + 64; x+=16) {
+        for(int z = coord.y; z < coord.y + 64; z+=16) {
+            Chunk *chunk = findChunkAt(x,z);
+            if(chunk != nullptr) {
+                removeFromRenderList(chunk);
+                chunk->destroyVBOdata();
             }
         }
     }
+}
+
+void Terrain::uploadPendingMeshes()
+{
+    m_uploads = m_uploadBytes = 0;
+    m_uploadMs = 0.f;
+    if(m_pendingUploads.empty())
+        return;
+
+    glm::vec2 viewer(m_viewerPos.x, m_viewerPos.z);
+    auto distance2 = [&viewer](const Chunk *c) {
+        glm::vec2 d = glm::vec2(c->m_xChunk + 8, c->m_zChunk + 8) - viewer;
+        return glm::dot(d, d);
+    };
+    std::sort(m_pendingUploads.begin(), m_pendingUploads.end(),
+              [&distance2](const ChunkVBOData &a, const ChunkVBOData &b) {
+        return distance2(a.m_chunk) < distance2(b.m_chunk);
+    });
 
-    //assigning VBO Data to terrain zones that
-    //have been visited before but their VBO data was destroyed
-    //- By default, We can assume the VBO data was destroyed
-    // because as coded above, the program will destroy any VBO data outside the zone
-    for(auto id: currZoneArea) {
-        if(terrainZoneExists(id)) {
-            if(prevZoneArea.count(id)==0) {
-                glm::ivec2 coord = toCoords(id);
-                for(int x = coord.x; x < coord.x + 64; x+=16) {
-                    for(int z = coord.y; z < coord.y + 64; z+=16) {
-                        auto &chunk = getChunkAt(x,z);
+    auto start = steady_clock::now();
+    std::size_t kept = 0;
+    for(std::size_t i = 0; i < m_pendingUploads.size(); i++) {
+        ChunkVBOData &c = m_pendingUploads[i];
+        Chunk *chunk = c.m_chunk;
+        //left the streaming ring while it was queued: remeshed
+        //if it comes back
+        bool wanted = isStreamed(chunk);
+        float ms = duration<float, std::milli>(steady_clock::now() - start).count();
+        bool overBudget = m_uploads > 0 &&
+                (ms >= m_uploadBudgetMs || m_uploadBytes >= m_uploadBudgetBytes);
+        //a worker is still writing a newer mesh into the Chunk
+        bool remeshing = chunk->m_meshJobs > 1;
+        if(wanted && (overBudget || remeshing)) {
+            if(kept != i) {
+                m_pendingUploads[kept] = std::move(c);
+            }
+            kept++;
+            continue;
+        }
+        if(wanted) {
+            chunk->createVBOdata();
+            chunk->m_sections = c.m_sections;
+            addToRenderList(chunk);
+            m_uploads++;
+            m_uploadBytes += chunk->m_mesh.vertexCount * 4 * sizeof(glm::vec4) +
+                    chunk->m_mesh.indexCount * sizeof(GLuint);
+            //no other worker is meshing this Chunk (see above), so
+            //nothing else is using these
+            if(!m_keepCpuMeshes) {
+                chunk->releaseCpuMesh();
+            }
+        }
+        chunk->m_uploadPending = false;
+        chunk->m_meshJobs--;
+    }
+    m_pendingUploads.resize(kept, ChunkVBOData(nullptr));
+    m_uploadMs = duration<float, std::milli>(steady_clock::now() - start).count();
+    m_maxUploadMs = glm::max(m_maxUploadMs, m_uploadMs);
+    m_totalUploads += m_uploads;
+}
+
+void Terrain::setUploadBudget(float ms, std::size_t bytes)
+{
+    m_uploadBudgetMs = ms;
+    m_uploadBudgetBytes = bytes;
+}
+
+void Terrain::setKeepCpuMeshes(bool keep)
+{
+    m_keepCpuMeshes = keep;
+}
+
+std::size_t Terrain::cpuMeshBytes() const
+{
+    std::size_t bytes = 0;
+    for(const auto &kv : m_chunks) {
+        bytes += kv.second->cpuMeshBytes();
+    }
+    return bytes;
+}
+
+Terrain::UploadStats Terrain::uploadStats() const
+{
+    return {m_pendingUploads.size(), m_uploads, m_uploadBytes, m_uploadMs,
+            m_totalUploads, m_maxUploadMs};
+}
+
+void Terrain::addToRenderList(Chunk *c)
+{
+    if(c->m_renderIndex >= 0)
+        return;
+    c->m_renderIndex = static_cast<int>(m_renderList.size());
+    m_renderList.push_back(c);
+}
+
+void Terrain::removeFromRenderList(Chunk *c)
+{
+    if(c->m_renderIndex < 0)
+        return;
+    Chunk *last = m_renderList.back();
+    m_renderList[c->m_renderIndex] = last;
+    last->m_renderIndex = c->m_renderIndex;
+    m_renderList.pop_back();
+    c->m_renderIndex = -1;
+}
+
+bool Terrain::isStreamed(const Chunk *c) const
+{
+    int64_t id = toKey(c->m_xChunk & ~63, c->m_zChunk & ~63);
+    return m_streamedZones.count(id) != 0 || m_prefetchedZones.count(id) != 0;
+}
+
+void Terrain::dropPrefetchedZone(int64_t id)
+{
+    m_prefetchedZones.erase(id);
+    streamZoneOut(id);
+    m_prefetchMisses++;
+}
+
+void Terrain::prefetchAlong(glm::vec3 pos, glm::vec3 velocity, glm::vec3 look, int time)
+{
+    glm::vec2 vel(velocity.x, velocity.z);
+    float speed = glm::length(vel);
+    if(speed < PREFETCH_MIN_SPEED)
+        return;
+    //mostly where the player is going, bent towards where they're looking
+    glm::vec2 dir = vel / speed;
+    glm::vec2 lookDir(look.x, look.z);
+    if(glm::length(lookDir) > 0.01f)
+        dir = glm::normalize(dir + 0.5f * glm::normalize(lookDir));
+    glm::vec2 here(pos.x, pos.z);
+
+    auto zoneDist = [](glm::ivec2 a, glm::ivec2 b) {
+        return glm::max(glm::abs(a.x - b.x), glm::abs(a.y - b.y)) / 64;
+    };
+
+    //zones left behind by a change of course won't be reached
+    std::vector<int64_t> behind;
+    for(int64_t id : m_prefetchedZones) {
+        glm::ivec2 zone = toCoords(id);
+        glm::vec2 toZone = glm::vec2(zone) + glm::vec2(32.f) - here;
+        if(zoneDist(zone, m_playerZone) > PREFETCH_MAX_RADIUS + 1 ||
+                (glm::dot(toZone, dir) < 0 && zoneDist(zone, m_playerZone) > TERRAIN_UNLOAD_RADIUS))
+            behind.push_back(id);
+    }
+    for(int64_t id : behind)
+        dropPrefetchedZone(id);
+
+    //walk the predicted path a quarter zone at a time, nearest first,
+    //prefetching whatever the ring will need when the player gets there
+    int started = 0;
+    float reach = glm::min(speed * PREFETCH_SECONDS, 64.f * PREFETCH_MAX_RADIUS);
+    int load = TERRAIN_LOAD_RADIUS;
+    for(float s = 16.f; s <= reach; s += 16.f) {
+        glm::vec2 p = here + dir * s;
+        glm::ivec2 center(64*static_cast<int>(glm::floor(p.x / 64.f)),
+                          64*static_cast<int>(glm::floor(p.y / 64.f)));
+        for(int dx = -load; dx <= load; dx++) {
+            for(int dz = -load; dz <= load; dz++) {
+                if(started == PREFETCH_ZONES_PER_TICK ||
+                        m_prefetchedZones.size() >= PREFETCH_MAX_ZONES)
+                    return;
+                glm::ivec2 zone = center + 64 * glm::ivec2(dx, dz);
+                int dist = zoneDist(zone, m_playerZone);
+                if(dist <= load || dist > PREFETCH_MAX_RADIUS)
+                    continue;
+                int64_t id = toKey(zone.x, zone.y);
+                if(m_streamedZones.count(id) != 0 || m_prefetchedZones.count(id) != 0)
+                    continue;
+                //counted as streamed so its meshes get uploaded; queued
+                //behind nearer zones because it is farther away
+                m_prefetchedZones.insert(id);
+                m_prefetchCount++;
+                started++;
+                if(!terrainZoneExists(id)) {
+                    requestTerrainZone(id, dist);
+                    continue;
+                }
+                for(int x = zone.x; x < zone.x + 64; x+=16) {
+                    for(int z = zone.y; z < zone.y + 64; z+=16) {
+                        Chunk *chunk = findChunkAt(x,z);
+                        if(chunk == nullptr || chunk->m_awaitingBlocks)
+                            continue;
                         chunk->m_count = 0;
-                        //this should reallocate VBOs
-                        spawnVBOWorker(chunk.get(), time);
+                        spawnVBOWorker(chunk, time);
                     }
                 }
             }
         }
-        //creating blocktype Data for terrain zones/chunks that
-        //have NEVER been visited before - from scratch
-        else {
-            spawnFBMWorker(id);
+    }
+}
+
+Terrain::PrefetchStats Terrain::prefetchStats() const
+{
+    return PrefetchStats{m_prefetchCount, m_prefetchHits, m_prefetchMisses};
+}
+
+//loading initial terrain with respect to
+//initial position @ (x=52,z=42) => terrain origin @ (0,0)
+//terrain: 7*7 terrain zones
+void Terrain::loadInitialTerrain()
+{
+    m_playerZone = glm::ivec2(0,0);
+    int rad = TERRAIN_LOAD_RADIUS;
+    for(int dx = -rad; dx <= rad; dx++) {
+        for(int dz = -rad; dz <= rad; dz++) {
+            streamZoneIn(toKey(64*dx, 64*dz), glm::max(glm::abs(dx), glm::abs(dz)), 0);
+        }
+    }
+    std::cout << "Zones: " << m_streamedZones.size() << std::endl;
+    if(mp_io != nullptr) {
+        std::cout << "Reading " << mp_io->pendingLoads() << " zones from "
+                  << mp_world->directory() << std::endl;
+    }
+}
+
+// Moves the streaming ring with the player. Nothing happens until the
+// player enters another zone; then only the zones along the ring's edges
+// are looked at: the ones the load radius has just reached, and the ones
+// the unload radius has just left behind.
+void Terrain::tryExpansion(glm::vec3 prevPos, glm::vec3 currPos, int time)
+{
+    m_viewerPos = currPos;
+    if(prevPos==currPos)
+        return;
+
+    glm::ivec2 currZonePos(64*static_cast<int>(glm::floor(currPos.x / 64.f)),
+                           64*static_cast<int>(glm::floor(currPos.z / 64.f)));
+    if(currZonePos == m_playerZone)
+        return;
+    glm::ivec2 prevZonePos = m_playerZone;
+    m_playerZone = currZonePos;
+
+    //Chebyshev distance in zones between two zone corners
+    auto zoneDist = [](glm::ivec2 a, glm::ivec2 b) {
+        return glm::max(glm::abs(a.x - b.x), glm::abs(a.y - b.y)) / 64;
+    };
+
+    //entering edge: everything within the load radius of the previous
+    //zone is streamed already
+    int load = TERRAIN_LOAD_RADIUS;
+    for(int dx = -load; dx <= load; dx++) {
+        for(int dz = -load; dz <= load; dz++) {
+            glm::ivec2 zone = currZonePos + 64 * glm::ivec2(dx, dz);
+            if(zoneDist(zone, prevZonePos) <= load)
+                continue;
+            int64_t id = toKey(zone.x, zone.y);
+            if(m_streamedZones.count(id) == 0)
+                streamZoneIn(id, glm::max(glm::abs(dx), glm::abs(dz)), time);
+        }
+    }
+
+    //leaving edge: nothing beyond the unload radius of the previous
+    //zone is streamed
+    int unload = TERRAIN_UNLOAD_RADIUS;
+    for(int dx = -unload; dx <= unload; dx++) {
+        for(int dz = -unload; dz <= unload; dz++) {
+            glm::ivec2 zone = prevZonePos + 64 * glm::ivec2(dx, dz);
+            if(zoneDist(zone, currZonePos) <= unload)
+                continue;
+            int64_t id = toKey(zone.x, zone.y);
+            if(m_streamedZones.erase(id) != 0)
+                streamZoneOut(id);
         }
     }
 }
@@ -322,18 +1305,53 @@ void Terrain::checkThreadResults(int time)
     //Adds to m_chunksThatHaveVBOData bts
     //createChunkVBOdata called here and
     // chunksThatHaveVBOData is populated
+    receiveLoadedZones();
+    reloadLostZones();
+    if(mp_meshCache != nullptr) {
+        mp_meshCache->startOverdue();
+    }
     this->m_blockDataLock.lock();
-    for(auto chunk: m_chunksThatHaveBlockData)
+    for(auto chunk: m_chunksThatHaveBlockData) {
+        if(chunk->m_awaitingBlocks) {
+            //freshly generated: restore what the player changed
+            applySavedBlocks(chunk);
+            chunk->m_awaitingBlocks = false;
+        }
         spawnVBOWorker(chunk, time);
+    }
     m_chunksThatHaveBlockData.clear();
     this->m_blockDataLock.unlock();
 
-    //Now, all chunks that have VBO data and can be sent to GPU
+    //Now, all chunks that have VBO data are queued for the GPU
     this->m_vboDataLock.lock();
     for(ChunkVBOData& c: m_chunksThatHaveVBOData)
     {
-        c.m_chunk->createVBOdata();
+        if(!c.m_chunk->m_uploadPending) {
+            c.m_chunk->m_uploadPending = true;
+            m_pendingUploads.push_back(std::move(c));
+            continue;
+        }
+        //remeshed before the last mesh went up: the Chunk holds the
+        //newer mesh, so the queued entry just takes its sections
+        for(ChunkVBOData &queued : m_pendingUploads) {
+            if(queued.m_chunk == c.m_chunk) {
+                queued.m_sections = c.m_sections;
+                break;
+            }
+        }
+        c.m_chunk->m_meshJobs--;
     }
     m_chunksThatHaveVBOData.clear();
     this->m_vboDataLock.unlock();
+    uploadPendingMeshes();
+
+    //Far away chunks that no worker is using can now be evicted
+    enforceResidencyBudget();
+
+    //Fold journaled edits into the region files now and then,
+    //at a tick boundary
+    if(m_autosaveSeconds > 0 &&
+            steady_clock::now() - m_lastAutosave > seconds(m_autosaveSeconds)) {
+        startAutosave();
+    }
 }
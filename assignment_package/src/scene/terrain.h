@@ -2,13 +2,24 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include "chunk.h"
+#include "worldstorage.h"
+#include "chunkdelta.h"
+#include "chunkresidency.h"
+#include "editjournal.h"
+#include "chunkio.h"
+#include "meshcache.h"
+#include "gpuarena.h"
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
+#include <optional>
+#include <chrono>
 #include "shaderprogram.h"
 #include "cube.h"
 #include <QMutex>
 
+struct AutosaveBatch;
+
 //using namespace std;
 
 // Helper functions to convert (x, z) to and from hash map key
@@ -16,11 +27,16 @@ int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
 
 // The container class for all of the Chunks in the game.
-// Ultimately, while Terrain will always store all Chunks,
-// not all Chunks will be drawn at any given time as the world
-// expands.
+// Only the Chunks near the player are drawn, and only those within
+// the memory budget stay instantiated: once it is exceeded, the
+// farthest zones are evicted into m_residency's colder tiers and
+// brought back (or loaded afresh) when the player returns.
 class Terrain {
 private:
+    // Holds every Chunk's mesh on the GPU; declared first so it
+    // outlives the Chunks
+    GpuArena m_arena;
+
     // Stores every Chunk according to the location of its lower-left corner
     // in world space.
     // We combine the X and Z coordinates of the Chunk's corner into one 64-bit int
@@ -38,20 +54,186 @@ private:
     // one 64 x 64 area with its lower-left corner at (0, 0).
     // When milestone 1 has been implemented, the Player can move around the
     // world to add more "terrain generation zone" IDs to this set.
-    // While only the 3 x 3 collection of terrain generation zones
-    // surrounding the Player should be rendered, the Chunks
-    // in the Terrain will never be deleted until the program is terminated.
+    // Only the zones in the streaming ring around the Player are
+    // rendered (see m_streamedZones). A zone leaves this set when it is
+    // evicted (see evictZone), and its Chunks are deleted; it's added
+    // back when it is rehydrated or loaded again.
     std::unordered_set<int64_t> m_generatedTerrain;
 
+    // Every Chunk whose mesh is on the GPU, in no particular order.
+    // Changes only when a mesh is uploaded or freed, so drawing walks
+    // this instead of looking Chunks up. See Chunk::m_renderIndex.
+    std::vector<Chunk*> m_renderList;
+    // The Chunks draw() found on screen this frame, with their squared
+    // distance from the camera, sorted nearest first. Kept between
+    // frames so sorting doesn't allocate.
+    std::vector<std::pair<float, Chunk*>> m_drawOrder;
+
     //terrain area actually rendered
     std::unordered_set<Chunk*> m_chunksThatHaveBlockData;
+    // Zones a RehydrateWorker couldn't bring back whole, for
+    // reloadLostZones; also guarded by m_blockDataLock
+    std::vector<int64_t> m_zonesLost;
     QMutex m_blockDataLock;
     std::vector<ChunkVBOData> m_chunksThatHaveVBOData;
     QMutex m_vboDataLock;
+    // Finished meshes waiting for their turn to be uploaded, at most
+    // one per Chunk. Each frame uploads the nearest ones until the
+    // budget runs out.
+    std::vector<ChunkVBOData> m_pendingUploads;
+    float m_uploadBudgetMs;
+    std::size_t m_uploadBudgetBytes;
+    // Uploads and time spent in the last frame, and overall
+    float m_uploadMs, m_maxUploadMs;
+    std::size_t m_uploads, m_uploadBytes, m_totalUploads;
+    // Keep each Chunk's mesh in RAM after it's uploaded
+    bool m_keepCpuMeshes;
+
+    // The most memory instantiated Chunks may use before the terrain
+    // zones farthest from the player are evicted. Evicted Chunks are
+    // kept compressed in m_residency (in RAM, or spilled to disk), and
+    // promoted back if the player returns; zones the residency had to
+    // drop a Chunk of are loaded from the world or regenerated.
+    std::size_t m_hotBudget;
+    std::size_t m_zonesEvicted, m_zonesRehydrated;
+    ChunkResidency m_residency;
+
+    // What draw() culled last frame (see CullStats), and totals over
+    // every frame for the averages printed at shutdown
+    std::size_t m_cullZones, m_cullZonesCulled;
+    std::size_t m_cullChunks, m_cullChunksCulled, m_cullChunksOccluded;
+    std::size_t m_cullChunksDrawn, m_cullChunksTransparent;
+    std::size_t m_framesDrawn, m_totalChunksDrawn, m_totalChunksCulled, m_totalChunksOccluded;
+    // Finds the sections hidden behind terrain, on a worker, a frame
+    // behind the camera
+    AsyncOcclusionCuller m_occlusion;
+    // Every block the player has set in a generated Chunk, so that
+    // regenerating the Chunk can restore them. Kept for evicted
+    // Chunks too; this is the only state they have.
+    std::unordered_map<int64_t, ChunkDelta> m_edits;
+    // Keys whose entry in m_edits includes whatever an earlier session
+    // saved for that Chunk. Saved edits arrive with the zone load, and
+    // edits recorded before then (e.g. replayed from the journal) are
+    // merged on top of them; until then, autosaves merge them on the
+    // I/O thread. The main thread never reads edits from mp_world.
+    std::unordered_set<int64_t> m_editsMerged;
+    // Seeds the terrain generator
+    uint32_t m_seed;
+    // Lower-left corner of the terrain zone the player was last seen in,
+    // which the streaming ring is centered on
+    glm::ivec2 m_playerZone;
+    // Where the player was last seen; nearer meshes upload first
+    glm::vec3 m_viewerPos;
+    // Zones in the streaming ring: their Chunks are meshed and on the
+    // GPU, or will be once generated. Always includes every zone within
+    // the load radius of m_playerZone, and nothing beyond its unload
+    // radius; zones in between stay as they are, so walking back and
+    // forth over a zone border streams nothing.
+    std::unordered_set<int64_t> m_streamedZones;
+    // Zones outside the ring generated and meshed ahead of the player
+    // by prefetchAlong. They join the ring (a hit) if the player gets
+    // close enough, or are dropped (a miss) once the player heads away.
+    std::unordered_set<int64_t> m_prefetchedZones;
+    std::size_t m_prefetchCount, m_prefetchHits, m_prefetchMisses;
+
+    // The saved world Chunks are loaded from and saved to,
+    // or nullptr if this session isn't backed by one
+    uPtr<WorldStorage> mp_world;
+    // Write-ahead log of edits for mp_world; declared after it
+    // so it's destroyed (and finishes writing) first
+    uPtr<EditJournal> mp_journal;
+    // Keys of Chunks edited since the last autosave
+    std::unordered_set<int64_t> m_uncheckpointed;
+    std::chrono::steady_clock::time_point m_lastAutosave;
+    // Seconds between autosaves, 0 for none
+    int m_autosaveSeconds;
+    // The autosave whose SaveWorkers may still be running
+    sPtr<AutosaveBatch> mp_autosave;
+    // Autosaves started; Chunks frozen for the last one, and how long
+    // it and the slowest one held up the main thread
+    std::size_t m_autosaves, m_autosaveChunks;
+    float m_autosaveFreezeMs, m_maxAutosaveFreezeMs;
+    // What the last finished autosave serialized, and how long it took
+    std::size_t m_autosaveBytes;
+    float m_autosaveSerializeMs;
+    // Reads and autosaves mp_world off the main thread; declared
+    // after both so its threads stop first
+    uPtr<ChunkIO> mp_io;
+    // What was saved for the Chunks of zones that loaded from
+    // mp_world but have to be generated, taken by applySavedBlocks
+    // once each Chunk's generated blocks are in
+    std::unordered_map<int64_t, SavedChunk> m_savedChunks;
+    // Meshes saved with mp_world, if enabled; used by VBOWorkers
+    uPtr<MeshCache> mp_meshCache;
+    bool m_useMeshCache;
+
+    // What the non-throwing queries report for space whose
+    // Chunk has not been generated yet
+    BlockType m_unloadedBlockType;
 
     //removed geoomCube
     OpenGLContext* mp_context;
 
+    // Could this Chunk be dropped right now without pulling it out
+    // from under a worker thread or the renderer?
+    bool canEvict(const Chunk *c) const;
+    // Demotes all 16 Chunks of a terrain zone into m_residency
+    // and drops them
+    void evictZone(int64_t id);
+    // Instantiates an evicted zone again from m_residency, on a
+    // worker. Returns false, and does nothing, unless every one of
+    // its Chunks is still there.
+    bool rehydrateZone(int64_t id);
+    // Drops the Chunks of each zone in m_zonesLost and requests the
+    // zone again, from mp_world or the generator. Zones whose Chunks
+    // a VBOWorker may still be reading wait for a later tick.
+    void reloadLostZones();
+    // Evicts the farthest evictable zones until instantiated
+    // Chunks fit their budget again
+    void enforceResidencyBudget();
+    // Records an edit made through setBlockAt or trySetBlockAt
+    void recordEdit(Chunk *c, int x, int y, int z, BlockType t);
+    // Called once a freshly generated Chunk's blocks are in: replaces
+    // them with the saved Chunk if there is one, then applies edits
+    void applySavedBlocks(Chunk *c);
+    // The edits recorded for the Chunk under key this session, plus
+    // those saved by earlier ones once they've been merged in
+    ChunkDelta& editsFor(int64_t key);
+    // Puts the edits saved for the Chunk under key underneath any
+    // recorded this session
+    void mergeSavedEdits(int64_t key, ChunkDelta &&saved);
+    // Applies the edits recorded for c, if any
+    void applyEdits(Chunk *c);
+    // Freezes every Chunk edited since the last autosave and starts
+    // SaveWorkers to encode them and checkpoint the journal. Returns
+    // false without doing anything while the previous one is running.
+    bool startAutosave();
+    bool autosaveRunning();
+    // Creates a terrain zone that has never been visited (or was
+    // evicted): through mp_io if there is a saved world, distance
+    // zones from the player, otherwise straight to an FBMWorker
+    void requestTerrainZone(int64_t id, int distance);
+    // Takes the zones mp_io has finished reading and instantiates them
+    void receiveLoadedZones();
+    // Adds a zone to the streaming ring: remeshes its Chunks, or
+    // creates them if the zone doesn't exist
+    void streamZoneIn(int64_t id, int distance, int time);
+    // Takes a zone out of the streaming ring, freeing its Chunks' VBOs
+    void streamZoneOut(int64_t id);
+    bool isStreamed(const Chunk *c) const;
+    // Uploads queued meshes, nearest the player first, within the
+    // per-frame budget
+    void uploadPendingMeshes();
+    void addToRenderList(Chunk *c);
+    // Swaps c out with the last entry
+    void removeFromRenderList(Chunk *c);
+    // Takes a prefetched zone the player didn't come to out again
+    void dropPrefetchedZone(int64_t id);
+    // Instantiates a terrain zone's 16 Chunks from what was read and
+    // queues them for meshing. Returns false, and instantiates
+    // nothing, unless every one of them was saved whole.
+    bool loadTerrainZone(ChunkIO::ZoneLoad &load);
+
 public:
     Terrain(OpenGLContext *context);
     ~Terrain();
@@ -61,7 +243,7 @@ public:
     // Returns a pointer to the created Chunk.
     Chunk* instantiateChunkAt(int x, int z);
     // Do these world-space coordinates lie within
-    // a Chunk that exists?
+    // a Chunk that exists and is currently in memory?
     bool hasChunkAt(int x, int z) const;
     // Assuming a Chunk exists at these coords,
     // return a mutable reference to it
@@ -69,6 +251,10 @@ public:
     // Assuming a Chunk exists at these coords,
     // return a const reference to it
     const uPtr<Chunk>& getChunkAt(int x, int z) const;
+    // The Chunk containing these world-space coordinates,
+    // or nullptr if it has not been instantiated. Unlike
+    // getChunkAt, this never throws or inserts into m_chunks.
+    Chunk* findChunkAt(int x, int z) const;
     // Given a world-space coordinate (which may have negative
     // values) return the block stored at that point in space.
     BlockType getBlockAt(int x, int y, int z) const;
@@ -78,16 +264,135 @@ public:
     // given type.
     void setBlockAt(int x, int y, int z, BlockType t);
 
-    // Draws every Chunk in a terrain zone radius around (x,z)
-    void draw(int x, int z, ShaderProgram *shaderProgram);
+    // Non-throwing versions of the above for per-frame code
+    // (rendering, physics) that may look at Chunks which haven't
+    // been generated yet. tryGetBlockAt returns nothing for a
+    // missing Chunk; getBlockAtOrDefault returns the configured
+    // unloaded block type instead. trySetBlockAt returns false,
+    // and changes nothing, if there is no Chunk or y is out of range.
+    std::optional<BlockType> tryGetBlockAt(int x, int y, int z) const;
+    BlockType getBlockAtOrDefault(int x, int y, int z) const;
+    bool trySetBlockAt(int x, int y, int z, BlockType t);
+    // EMPTY by default. Setting this to e.g. STONE makes ungenerated
+    // space solid to anything reading it through the queries above
+    // or through a BlockCursor.
+    void setUnloadedBlockType(BlockType t);
+    BlockType getUnloadedBlockType() const;
+
+    // Memory budgets for instantiated Chunks, for evicted Chunks
+    // compressed in RAM, and for the file they spill to after that
+    void setResidencyBudget(std::size_t hotBytes, std::size_t compressedBytes,
+                            std::size_t diskBytes);
+    struct ResidencyStats {
+        std::size_t hotChunks, hotBytes;
+        // Evicted Chunks in each of the colder tiers (see ChunkResidency)
+        std::size_t compressedChunks, compressedBytes;
+        std::size_t diskChunks, diskBytes;
+        // Chunks with edits, blocks edited, and what that costs in RAM
+        std::size_t editedChunks, editedBlocks, editBytes;
+        // Zones evicted, and brought back from the colder tiers rather
+        // than regenerated; Chunks the colder tiers had to drop
+        std::size_t zonesEvicted, zonesRehydrated, chunksDropped;
+        double lastPromotionMs, avgPromotionMs, maxPromotionMs;
+    };
+    ResidencyStats residencyStats() const;
+
+    // The seed new terrain is generated from. openWorld replaces
+    // it with the world's own seed.
+    void setSeed(uint32_t seed);
+    uint32_t getSeed() const;
+
+    // Backs this Terrain with the world saved in dir (created if it
+    // doesn't exist). Call before loadInitialTerrain. Saved edits are
+    // applied to regenerated Chunks, and zones saved whole are loaded
+    // instead of generated.
+    bool openWorld(const std::string &dir);
+    // Saves every edit not yet in the region files. Edits are
+    // journaled as they happen and autosaved periodically anyway;
+    // this is for shutdown.
+    void saveWorld();
+    // How often edits are autosaved into the region files; 0 turns
+    // autosave off (edits are still journaled)
+    void setAutosaveInterval(int seconds);
+    struct AutosaveStats {
+        // Autosaves started, and Chunks frozen for the last one
+        std::size_t autosaves, chunks;
+        // Main thread time taken freezing the last autosave's Chunks,
+        // and the most any autosave has taken
+        float freezeMs, maxFreezeMs;
+        // Bytes serialized by the last finished autosave, and the time
+        // from freezing its Chunks to handing them to the journal
+        std::size_t bytes;
+        float serializeMs;
+    };
+    AutosaveStats autosaveStats() const;
+    // Keep finished meshes with the world, so explored areas that
+    // haven't changed skip meshing. Call before openWorld; off by default.
+    void setMeshCacheEnabled(bool enabled);
+
+    // Draws every Chunk in a terrain zone radius around (x,z) that is
+    // inside viewProj's frustum and not hidden behind terrain from eye.
+    // Opaque faces go first, unblended and nearest eye first so the
+    // depth test rejects hidden fragments early; then transparent
+    // faces, farthest first, blended and without writing depth.
+    // Whole zones are culled before their Chunks are tested.
+    // Expects blending to be on, and leaves it on.
+    void draw(int x, int z, const glm::mat4 &viewProj, glm::vec3 eye,
+              ShaderProgram *shaderProgram);
+    struct CullStats {
+        // Zones and Chunks in the draw radius, how many of each the
+        // frustum threw away, and how many Chunks inside it were
+        // hidden behind terrain, last frame
+        std::size_t zones, zonesCulled;
+        std::size_t chunks, chunksCulled, chunksOccluded;
+        // Chunks drawn last frame, how many of them had transparent
+        // faces, and frames drawn in all
+        std::size_t chunksDrawn, chunksTransparent, frames;
+    };
+    CullStats cullStats() const;
+    // Occupancy of the GPU memory Chunk meshes are drawn from
+    GpuArena::Stats arenaStats() const;
 
     bool terrainZoneExists(int64_t id);
     std::unordered_set<int64_t> findTerrainZoneArea(glm::ivec2, int radius);
+    // Queues a Chunk's meshing; a prefetched zone's queues behind
+    // everything near the player
     void spawnVBOWorker(Chunk*, int);
     void spawnFBMWorker(int64_t id);
     void checkThreadResults(int time);
+    // How long, and how many bytes of meshes, checkThreadResults may
+    // spend uploading each frame. At least one mesh is always uploaded.
+    void setUploadBudget(float ms, std::size_t bytes);
+    struct UploadStats {
+        // Meshes waiting to be uploaded
+        std::size_t queued;
+        // Meshes, bytes and milliseconds uploaded last frame
+        std::size_t uploads, bytes;
+        float ms;
+        // Over every frame
+        std::size_t totalUploads;
+        float maxMs;
+    };
+    UploadStats uploadStats() const;
+    // Chunks' meshes are freed from RAM once they are on the GPU, and
+    // rebuilt by meshing the Chunk again if they're needed. Pass true
+    // to keep them instead.
+    void setKeepCpuMeshes(bool keep);
+    // RAM held by Chunks' copies of their meshes
+    std::size_t cpuMeshBytes() const;
     void loadInitialTerrain();
     void tryExpansion(glm::vec3 prevPos, glm::vec3 currPos, int time);
+    // Generates and meshes zones along the path the player is predicted
+    // to take, from their velocity and look direction, so fast movement
+    // doesn't outrun the streaming ring. Within a budget, and always
+    // behind work near the player. Call every tick after tryExpansion.
+    void prefetchAlong(glm::vec3 pos, glm::vec3 velocity, glm::vec3 look, int time);
+    struct PrefetchStats {
+        // Zones prefetched, and how many of them the player did or
+        // didn't reach
+        std::size_t prefetched, hits, misses;
+    };
+    PrefetchStats prefetchStats() const;
 
     // Initializes the Chunks that store the 64 x 256 x 64 block scene you
     // see when the base code is run.
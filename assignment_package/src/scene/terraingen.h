@@ -0,0 +1,38 @@
+#pragma once
+#include "chunkblocks.h"
+#include <cstdint>
+
+// The procedural terrain: bedrock, Perlin caves and lava, then grassland
+// and mountain biomes blended by Worley noise, with water filling the
+// low ground. Needs nothing from Qt or OpenGL, so FBMWorkers and the
+// offline pregeneration tool (tools/pregen) share it.
+//
+// Generation is deterministic: the same seed and Chunk origin always
+// give the same blocks, which is what lets worlds store only edits.
+class TerrainGenerator
+{
+public:
+    // The layers every generated column is built from, also used by
+    // the heightmap importer (tools/heightmap) so imported terrain
+    // looks like generated terrain
+    static constexpr int BED_LEVEL = 100;
+    static constexpr int BASE_HEIGHT = 128;
+    static constexpr int WATER_LEVEL = 148;
+    static constexpr int SNOW_LEVEL = 220;
+
+    // Builds the fractal mountain heightmap for seed
+    TerrainGenerator(uint32_t seed);
+    ~TerrainGenerator();
+    TerrainGenerator(const TerrainGenerator&) = delete;
+    TerrainGenerator& operator=(const TerrainGenerator&) = delete;
+
+    // Generates the Chunk whose lower-left corner is at (xChunk, zChunk)
+    // into blocks, which should start out EMPTY
+    void fillChunk(ChunkBlocks &blocks, int xChunk, int zChunk) const;
+
+private:
+    static constexpr int HEIGHT_LEVELS = 9;
+    // (m_size + 1) x (m_size + 1) mountain heights
+    double **mp_height;
+    int m_size;
+};
@@ -0,0 +1,277 @@
+#include "worldstorage.h"
+#include "chunkcodec.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+// Region files kept open at once. Each holds a file handle and a
+// mapping, so walking across a huge world (e.g. an import) must not
+// keep every region it has touched open.
+#define MAX_OPEN_REGIONS 64
+
+// Chunk origin to region index, flooring for negative coordinates
+static int regionIndex(int v) {
+    return v >> 9;
+}
+// Chunk origin to Chunk index within its region
+static int localIndex(int v) {
+    return (v >> 4) & (RegionFile::CHUNKS_PER_SIDE - 1);
+}
+static int64_t regionKey(int rx, int rz) {
+    return (static_cast<int64_t>(rx) << 32) | static_cast<uint32_t>(rz);
+}
+
+WorldStorage::WorldStorage(const std::string &dir, uint32_t seedIfNew)
+    : m_dir(dir), m_open(false), m_seed(seedIfNew), m_regions(), m_regionOrder(),
+      m_closedSyncFailed(false), m_stats{}, m_lock()
+{
+    std::error_code err;
+    fs::create_directories(fs::path(dir) / "region", err);
+    if(err) {
+        std::cout << "Could not create world directory " << dir << ": " << err.message() << std::endl;
+        return;
+    }
+
+    fs::path info = fs::path(dir) / "world.txt";
+    if(fs::exists(info)) {
+        std::ifstream in(info);
+        std::string game, kind, seedLabel;
+        int version = 0;
+        in >> game >> kind >> version >> seedLabel >> m_seed;
+        if(version != FORMAT_VERSION || seedLabel != "seed" || !in) {
+            std::cout << "World " << dir << " has unsupported format version " << version << std::endl;
+            return;
+        }
+    }
+    else {
+        std::ofstream out(info);
+        out << "miniMinecraft world " << FORMAT_VERSION << std::endl;
+        out << "seed " << m_seed << std::endl;
+        if(!out) {
+            return;
+        }
+    }
+    m_open = true;
+}
+
+bool WorldStorage::isOpen() const
+{
+    return m_open;
+}
+
+const std::string& WorldStorage::directory() const
+{
+    return m_dir;
+}
+
+std::string WorldStorage::regionPath(int rx, int rz) const
+{
+    return (fs::path(m_dir) / "region" /
+            ("r." + std::to_string(rx) + "." + std::to_string(rz) + ".mmr")).string();
+}
+
+RegionFile* WorldStorage::regionFor(int x, int z, bool create)
+{
+    int rx = regionIndex(x), rz = regionIndex(z);
+    int64_t key = regionKey(rx, rz);
+    auto it = m_regions.find(key);
+    if(it != m_regions.end()) {
+        // Now the most recently used
+        m_regionOrder.splice(m_regionOrder.end(), m_regionOrder, it->second.order);
+        return it->second.file.get();
+    }
+    std::string path = regionPath(rx, rz);
+    if(!create && !fs::exists(path)) {
+        return nullptr;
+    }
+    uPtr<RegionFile> region = mkU<RegionFile>(path);
+    if(!region->isOpen()) {
+        std::cout << "Could not open region file " << path << std::endl;
+        return nullptr;
+    }
+    if(m_regions.size() >= MAX_OPEN_REGIONS) {
+        closeOldestRegion();
+    }
+    RegionFile *r = region.get();
+    OpenRegion &open = m_regions[key];
+    open.file = std::move(region);
+    open.order = m_regionOrder.insert(m_regionOrder.end(), key);
+    open.unsynced = false;
+    return r;
+}
+
+void WorldStorage::closeOldestRegion()
+{
+    auto it = m_regions.find(m_regionOrder.front());
+    // Its writes must be on disk before sync() can vouch for them,
+    // and once it is closed sync() no longer sees it
+    if(!it->second.unsynced) {
+        it->second.file->flush();
+    }
+    else if(!it->second.file->sync()) {
+        m_closedSyncFailed = true;
+    }
+    m_regionOrder.pop_front();
+    m_regions.erase(it);
+    m_stats.regionsClosed++;
+}
+
+uint32_t WorldStorage::seed() const
+{
+    return m_seed;
+}
+
+bool WorldStorage::hasChunk(int x, int z)
+{
+    QMutexLocker locker(&m_lock);
+    if(!m_open) {
+        return false;
+    }
+    RegionFile *r = regionFor(x, z, false);
+    return r != nullptr && r->hasChunk(localIndex(x), localIndex(z));
+}
+
+bool WorldStorage::hasFullChunk(int x, int z)
+{
+    QMutexLocker locker(&m_lock);
+    const unsigned char *data;
+    std::size_t size;
+    return readPayload(x, z, FULL_CHUNK, data, size);
+}
+
+bool WorldStorage::readPayload(int x, int z, PayloadKind kind,
+                               const unsigned char *&data, std::size_t &size)
+{
+    if(!m_open) {
+        return false;
+    }
+    RegionFile *r = regionFor(x, z, false);
+    if(r == nullptr || !r->readPayload(localIndex(x), localIndex(z), data, size) ||
+            size == 0 || data[0] != kind) {
+        return false;
+    }
+    data++;
+    size--;
+    return true;
+}
+
+bool WorldStorage::writePayload(int x, int z, PayloadKind kind, const std::vector<unsigned char> &body)
+{
+    QMutexLocker locker(&m_lock);
+    if(!m_open) {
+        return false;
+    }
+    auto start = steady_clock::now();
+    RegionFile *r = regionFor(x, z, true);
+    std::vector<unsigned char> payload;
+    payload.reserve(body.size() + 1);
+    payload.push_back(kind);
+    payload.insert(payload.end(), body.begin(), body.end());
+    bool ok = r != nullptr && r->writePayload(localIndex(x), localIndex(z), payload);
+    if(r != nullptr) {
+        m_regions[regionKey(regionIndex(x), regionIndex(z))].unsynced = true;
+    }
+    if(ok) {
+        m_stats.chunksSaved++;
+        m_stats.bytesSaved += payload.size();
+        m_stats.saveMs += duration<double, std::milli>(steady_clock::now() - start).count();
+    }
+    return ok;
+}
+
+bool WorldStorage::loadChunk(int x, int z, ChunkBlocks &out)
+{
+    QMutexLocker locker(&m_lock);
+    auto start = steady_clock::now();
+    const unsigned char *data;
+    std::size_t size;
+    bool ok = readPayload(x, z, FULL_CHUNK, data, size) &&
+              decodeChunkBlocks(data, size, out);
+    if(ok) {
+        m_stats.chunksLoaded++;
+        m_stats.loadMs += duration<double, std::milli>(steady_clock::now() - start).count();
+    }
+    return ok;
+}
+
+bool WorldStorage::loadEdits(int x, int z, ChunkDelta &out)
+{
+    QMutexLocker locker(&m_lock);
+    auto start = steady_clock::now();
+    const unsigned char *data;
+    std::size_t size;
+    bool ok = readPayload(x, z, CHUNK_EDITS, data, size) && out.decode(data, size);
+    if(ok) {
+        m_stats.chunksLoaded++;
+        m_stats.loadMs += duration<double, std::milli>(steady_clock::now() - start).count();
+    }
+    return ok;
+}
+
+void WorldStorage::loadBatch(std::vector<SavedChunk> &batch)
+{
+    QMutexLocker locker(&m_lock);
+    auto start = steady_clock::now();
+    for(SavedChunk &saved : batch) {
+        saved.hasBlocks = false;
+        saved.blocks.clear();
+        saved.hasEdits = false;
+        const unsigned char *data;
+        std::size_t size;
+        if(readPayload(saved.x, saved.z, FULL_CHUNK, data, size)) {
+            //unreadable counts as never saved
+            if(chunkBlocksValid(data, size)) {
+                saved.hasBlocks = true;
+                saved.blocks.assign(data, data + size);
+                m_stats.chunksLoaded++;
+            }
+        }
+        else if(readPayload(saved.x, saved.z, CHUNK_EDITS, data, size)) {
+            saved.hasEdits = saved.edits.decode(data, size);
+            m_stats.chunksLoaded++;
+        }
+    }
+    m_stats.loadMs += duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+bool WorldStorage::saveChunk(int x, int z, const ChunkBlocks &blocks)
+{
+    return writePayload(x, z, FULL_CHUNK, encodeChunkBlocks(blocks));
+}
+
+bool WorldStorage::saveEdits(int x, int z, const ChunkDelta &edits)
+{
+    return writePayload(x, z, CHUNK_EDITS, edits.encode());
+}
+
+void WorldStorage::flush()
+{
+    QMutexLocker locker(&m_lock);
+    for(auto &kv : m_regions) {
+        kv.second.file->flush();
+    }
+}
+
+bool WorldStorage::sync()
+{
+    QMutexLocker locker(&m_lock);
+    bool ok = !m_closedSyncFailed;
+    m_closedSyncFailed = false;
+    for(auto &kv : m_regions) {
+        bool synced = kv.second.file->sync();
+        // Left marked so a later sync() or close retries it
+        kv.second.unsynced = !synced;
+        ok = synced && ok;
+    }
+    return ok;
+}
+
+WorldStorage::Stats WorldStorage::stats() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_stats;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "regionfile.h"
+#include "chunkdelta.h"
+#include "smartpointerhelp.h"
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <QMutex>
+
+// Everything saved for one Chunk, as read by WorldStorage::loadBatch
+struct SavedChunk
+{
+    int x, z;
+    // The Chunk, if it was saved whole, still encoded (see chunkcodec.h)
+    // so that it's decoded straight into the Chunk that takes it.
+    // loadBatch has checked that it decodes.
+    bool hasBlocks;
+    std::vector<unsigned char> blocks;
+    // Edits over the generated Chunk, if any were saved
+    bool hasEdits;
+    ChunkDelta edits;
+};
+
+// A saved world on disk. The directory layout is:
+//   <world>/
+//     world.txt                 "miniMinecraft world <format version>"
+//                               "seed <generator seed>"
+//     region/
+//       r.<rx>.<rz>.mmr         see regionfile.h
+// where rx = floor(chunk origin x / 512), likewise rz.
+//
+// Generated Chunks are never stored whole: the seed regenerates them, and
+// only the player's edits are saved (see ChunkDelta). Chunks that didn't
+// come from the generator (e.g. imported terrain) are stored whole.
+//
+// Chunks are addressed by the world-space coordinates of their
+// lower-left corner, like Terrain's map keys. Region files are opened
+// on first use and kept open, up to a limit past which the least
+// recently used one is closed, after syncing it if it was written to
+// since the last sync(). Every call locks the
+// storage, so the main thread can load while the edit journal's
+// thread saves.
+class WorldStorage
+{
+public:
+    static constexpr int FORMAT_VERSION = 2;
+
+    // The first byte of every region payload
+    enum PayloadKind : unsigned char {
+        FULL_CHUNK = 0, CHUNK_EDITS = 1
+    };
+
+    // Opens the world at dir, creating the directories and world.txt
+    // (recording seedIfNew) if needed. Check isOpen() afterwards.
+    WorldStorage(const std::string &dir, uint32_t seedIfNew);
+
+    // False if the directory couldn't be created, or it holds a
+    // world saved in a format version this code doesn't know
+    bool isOpen() const;
+    const std::string& directory() const;
+
+    // The seed the world's terrain is generated from
+    uint32_t seed() const;
+
+    // Has anything been saved for the Chunk at (x, z)?
+    bool hasChunk(int x, int z);
+    // Has the Chunk at (x, z) been saved whole?
+    bool hasFullChunk(int x, int z);
+    // Each returns false if nothing of that kind is saved for the Chunk
+    bool loadChunk(int x, int z, ChunkBlocks &out);
+    bool loadEdits(int x, int z, ChunkDelta &out);
+    // Fills in whatever is saved for each Chunk of batch (x and z
+    // set by the caller), taking the lock once for all of them. A
+    // payload that can't be read back is left out, as if never saved.
+    void loadBatch(std::vector<SavedChunk> &batch);
+    bool saveChunk(int x, int z, const ChunkBlocks &blocks);
+    bool saveEdits(int x, int z, const ChunkDelta &edits);
+    // Stores an already encoded payload body (without the kind byte)
+    bool writePayload(int x, int z, PayloadKind kind, const std::vector<unsigned char> &body);
+
+    // Flushes every open region file
+    void flush();
+    // Flushes and forces every open region file to stable storage.
+    // False if any of them couldn't be synced, or a region written to
+    // since the last call couldn't be synced when it was closed.
+    bool sync();
+
+    // Totals since the world was opened
+    struct Stats {
+        std::size_t chunksLoaded, chunksSaved, bytesSaved;
+        // Region files closed to stay under the open file limit
+        std::size_t regionsClosed;
+        double loadMs, saveMs;
+    };
+    Stats stats() const;
+
+private:
+    // The region containing the Chunk at (x, z), or nullptr if
+    // create is false and its file doesn't exist yet
+    RegionFile* regionFor(int x, int z, bool create);
+    // Closes the least recently used region file, syncing it first
+    // if it has unsynced writes
+    void closeOldestRegion();
+    std::string regionPath(int rx, int rz) const;
+    // Finds the Chunk's payload if it is of the given kind, skipping
+    // past the kind byte
+    bool readPayload(int x, int z, PayloadKind kind, const unsigned char *&data, std::size_t &size);
+
+    std::string m_dir;
+    bool m_open;
+    uint32_t m_seed;
+    struct OpenRegion {
+        uPtr<RegionFile> file;
+        // Position in m_regionOrder, for O(1) reordering
+        std::list<int64_t>::iterator order;
+        // Written to since it was last synced
+        bool unsynced;
+    };
+    // Keyed like Terrain's Chunks, by (rx, rz)
+    std::unordered_map<int64_t, OpenRegion> m_regions;
+    // Least recently used region at the front
+    std::list<int64_t> m_regionOrder;
+    // A region closed since the last sync() failed to sync
+    bool m_closedSyncFailed;
+    Stats m_stats;
+    mutable QMutex m_lock;
+};
@@ -10,9 +10,54 @@ ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
       attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1), unifSampler2D(-1), unifTime(-1), unifDimensions(-1),
-    unifBlckType(-1), context(context)
+    unifBlckType(-1),
+    m_time(), m_blckType(), m_dimensions(), m_model(), m_viewProj(), m_color(),
+    context(context)
 {}
 
+GLuint ShaderProgram::s_boundProgram = 0;
+GLuint ShaderProgram::s_boundVao = ShaderProgram::UNKNOWN_BINDING;
+ShaderProgram::StateStats ShaderProgram::s_stats = {};
+
+template<typename T>
+bool ShaderProgram::changed(std::optional<T> &cached, const T &value)
+{
+    if(cached.has_value() && *cached == value) {
+        s_stats.uniformUploadsSkipped++;
+        return false;
+    }
+    cached = value;
+    s_stats.uniformUploads++;
+    return true;
+}
+
+ShaderProgram::StateStats ShaderProgram::stateStats()
+{
+    return s_stats;
+}
+
+void ShaderProgram::forgetBoundState()
+{
+    s_boundProgram = 0;
+    s_boundVao = UNKNOWN_BINDING;
+}
+
+void ShaderProgram::bindVertexArray(OpenGLContext *context, GLuint vao)
+{
+    if(s_boundVao == vao) {
+        s_stats.vaoBindsSkipped++;
+        return;
+    }
+    context->glBindVertexArray(vao);
+    s_boundVao = vao;
+    s_stats.vaoBinds++;
+}
+
+GLuint ShaderProgram::boundVertexArray()
+{
+    return s_boundVao;
+}
+
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
 {
     context->printGLErrorLog();
@@ -78,44 +123,59 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifDimensions = context->glGetUniformLocation(prog, "u_Dimensions");
     unifBlckType = context->glGetUniformLocation(prog, "u_BlckType");
 
+    // A new program starts with none of the values we cached
+    m_time.reset();
+    m_blckType.reset();
+    m_dimensions.reset();
+    m_model.reset();
+    m_viewProj.reset();
+    m_color.reset();
+
     context->printGLErrorLog();
 }
 
 void ShaderProgram::useMe()
 {
+    if(s_boundProgram == prog) {
+        s_stats.programBindsSkipped++;
+        return;
+    }
     context->glUseProgram(prog);
+    s_boundProgram = prog;
+    s_stats.programBinds++;
 }
 
 void ShaderProgram::setTime(int t)
 {
-    useMe();
-
-    if(unifTime != -1)
+    if(unifTime != -1 && changed(m_time, t))
     {
+        useMe();
         context->glUniform1i(unifTime, t);
     }
 }
 
 void ShaderProgram::setDimensions(glm::ivec2 dims){
-    useMe();
-
-    if(unifDimensions != -1)
+    if(unifDimensions != -1 && changed(m_dimensions, dims))
     {
+        useMe();
         context->glUniform2i(unifDimensions, dims.x, dims.y);
     }
 }
 
 void ShaderProgram::setBlckType(int blck_type){
-    useMe();
-
-    if(unifBlckType != -1)
+    if(unifBlckType != -1 && changed(m_blckType, blck_type))
     {
+        useMe();
         context->glUniform1i(unifBlckType, blck_type);
     }
 }
 
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 {
+    // u_ModelInvTr only ever changes along with u_Model
+    if((unifModel == -1 && unifModelInvTr == -1) || !changed(m_model, model)) {
+        return;
+    }
     useMe();
 
     if (unifModel != -1) {
@@ -146,28 +206,27 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 
 void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
 {
-    // Tell OpenGL to use this shader program for subsequent function calls
-    useMe();
+    if(unifViewProj != -1 && changed(m_viewProj, vp)) {
+        // Tell OpenGL to use this shader program for subsequent function calls
+        useMe();
 
-    if(unifViewProj != -1) {
-    // Pass a 4x4 matrix into a uniform variable in our shader
-                    // Handle to the matrix variable on the GPU
-    context->glUniformMatrix4fv(unifViewProj,
-                    // How many matrices to pass
-                       1,
-                    // Transpose the matrix? OpenGL uses column-major, so no.
-                       GL_FALSE,
-                    // Pointer to the first element of the matrix
-                       &vp[0][0]);
+        // Pass a 4x4 matrix into a uniform variable in our shader
+                        // Handle to the matrix variable on the GPU
+        context->glUniformMatrix4fv(unifViewProj,
+                        // How many matrices to pass
+                           1,
+                        // Transpose the matrix? OpenGL uses column-major, so no.
+                           GL_FALSE,
+                        // Pointer to the first element of the matrix
+                           &vp[0][0]);
     }
 }
 
 void ShaderProgram::setGeometryColor(glm::vec4 color)
 {
-    useMe();
-
-    if(unifColor != -1)
+    if(unifColor != -1 && changed(m_color, color))
     {
+        useMe();
         context->glUniform4fv(unifColor, 1, &color[0]);
     }
 }
@@ -264,32 +323,9 @@ void ShaderProgram::drawInter(Drawable &d)
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
     }
 
-    /*
-     * For VBO data that is stored as:
-     * <vec4>pos, <vec4>nor, <vec4>col
-     */
     if (d.bindVBO())
     {
-        if(attrPos != -1)
-        {
-            context->glEnableVertexAttribArray(attrPos);
-            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)0);
-        }
-        if(attrCol != -1)
-        {
-            context->glEnableVertexAttribArray(attrCol);
-            context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)sizeof(glm::vec4));
-        }
-        if(attrUV != -1)
-        {
-            context->glEnableVertexAttribArray(attrUV);
-            context->glVertexAttribPointer(attrUV, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(2*sizeof(glm::vec4)));
-        }
-        if(attrNor != -1)
-        {
-            context->glEnableVertexAttribArray(attrNor);
-            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(3*sizeof(glm::vec4)));
-        }
+        enableInterleavedAttribs();
     }
 
     // Bind the index buffer and then draw shapes from it.
@@ -297,12 +333,45 @@ void ShaderProgram::drawInter(Drawable &d)
     d.bindIdx();
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
+    disableInterleavedAttribs();
+
+    context->printGLErrorLog();
+}
+
+void ShaderProgram::enableInterleavedAttribs()
+{
+    /*
+     * For VBO data that is stored as:
+     * <vec4>pos, <vec4>col, <vec4>uv, <vec4>nor
+     */
+    if(attrPos != -1)
+    {
+        context->glEnableVertexAttribArray(attrPos);
+        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)0);
+    }
+    if(attrCol != -1)
+    {
+        context->glEnableVertexAttribArray(attrCol);
+        context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)sizeof(glm::vec4));
+    }
+    if(attrUV != -1)
+    {
+        context->glEnableVertexAttribArray(attrUV);
+        context->glVertexAttribPointer(attrUV, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(2*sizeof(glm::vec4)));
+    }
+    if(attrNor != -1)
+    {
+        context->glEnableVertexAttribArray(attrNor);
+        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 4*sizeof(glm::vec4), (void*)(3*sizeof(glm::vec4)));
+    }
+}
+
+void ShaderProgram::disableInterleavedAttribs()
+{
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
     if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
     if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-
-    context->printGLErrorLog();
 }
 
 void ShaderProgram::drawInstanced(InstancedDrawable &d)
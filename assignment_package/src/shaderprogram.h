@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include "drawable.h"
+#include <optional>
 
 
 class ShaderProgram
@@ -34,7 +35,9 @@ public:
     ShaderProgram(OpenGLContext* context);
     // Sets up the requisite GL data and shaders from the given .glsl files
     void create(const char *vertfile, const char *fragfile);
-    // Tells our OpenGL context to use this shader to draw things
+    // Tells our OpenGL context to use this shader to draw things.
+    // Skipped if it already is; the setters below likewise skip
+    // uniforms that already hold the value given.
     void useMe();
     // Pass the given model matrix to this shader on the GPU
     void setModelMatrix(const glm::mat4 &model);
@@ -47,6 +50,10 @@ public:
     void draw(Drawable &d, int textureSlot=0);
     // Draw the given object to our screen using interleaved VBO
     void drawInter(Drawable &d);
+    // Point this shader's attributes into the bound GL_ARRAY_BUFFER,
+    // laid out as drawInter expects, and turn them back off
+    void enableInterleavedAttribs();
+    void disableInterleavedAttribs();
     // Draw the given object to our screen multiple times using instanced rendering
     void drawInstanced(InstancedDrawable &d);
     // Utility function used in create()
@@ -62,7 +69,45 @@ public:
 
     QString qTextFileRead(const char*);
 
+    // GL calls made and skipped by the render-state cache, across all
+    // ShaderPrograms, since the program started
+    struct StateStats {
+        std::size_t programBinds, programBindsSkipped;
+        std::size_t uniformUploads, uniformUploadsSkipped;
+        std::size_t vaoBinds, vaoBindsSkipped;
+    };
+    static StateStats stateStats();
+    // Makes the next useMe and bindVertexArray bind whatever the cache
+    // says. Call at the start of each frame, since Qt may draw with
+    // programs and VAOs of its own in our context between frames.
+    static void forgetBoundState();
+
+    // glBindVertexArray, skipped if vao is bound already. Every VAO
+    // change must go through here for the cache to stay right.
+    static void bindVertexArray(OpenGLContext *context, GLuint vao);
+    // The VAO bound through bindVertexArray, or UNKNOWN_BINDING if
+    // none has been since forgetBoundState
+    static GLuint boundVertexArray();
+    static constexpr GLuint UNKNOWN_BINDING = ~0u;
+
 private:
+    // Whether value differs from what cached says the uniform holds,
+    // recording it if so
+    template<typename T>
+    static bool changed(std::optional<T> &cached, const T &value);
+
+    // The program glUseProgram was last called with. Every program
+    // change goes through useMe, so this is what GL has bound.
+    static GLuint s_boundProgram;
+    // Likewise for glBindVertexArray and bindVertexArray
+    static GLuint s_boundVao;
+    static StateStats s_stats;
+    // The last values uploaded to this program's uniforms
+    std::optional<int> m_time, m_blckType;
+    std::optional<glm::ivec2> m_dimensions;
+    std::optional<glm::mat4> m_model, m_viewProj;
+    std::optional<glm::vec4> m_color;
+
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
@@ -22,6 +22,23 @@ SOURCES += \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
+    $$PWD/scene/chunkdelta.cpp \
+    $$PWD/scene/chunkresidency.cpp \
+    $$PWD/scene/chunkio.cpp \
+    $$PWD/scene/frustum.cpp \
+    $$PWD/scene/occlusion.cpp \
+    $$PWD/scene/rangeallocator.cpp \
+    $$PWD/scene/gpuarena.cpp \
+    $$PWD/scene/meshcache.cpp \
+    $$PWD/scene/terraingen.cpp \
+    $$PWD/scene/editjournal.cpp \
+    $$PWD/scene/filesync.cpp \
+    $$PWD/scene/regionfile.cpp \
+    $$PWD/scene/worldstorage.cpp \
+    $$PWD/scene/chunkcodec.cpp \
+    $$PWD/scene/chunkblocks.cpp \
+    $$PWD/scene/chunkpool.cpp \
+    $$PWD/scene/paddedchunkview.cpp \
     $$PWD/texture.cpp
 
 HEADERS += \
@@ -46,4 +63,23 @@ HEADERS += \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
+    $$PWD/scene/chunkdelta.h \
+    $$PWD/scene/chunkresidency.h \
+    $$PWD/scene/chunkio.h \
+    $$PWD/scene/frustum.h \
+    $$PWD/scene/occlusion.h \
+    $$PWD/scene/rangeallocator.h \
+    $$PWD/scene/gpuarena.h \
+    $$PWD/scene/meshcache.h \
+    $$PWD/scene/terraingen.h \
+    $$PWD/scene/editjournal.h \
+    $$PWD/scene/filesync.h \
+    $$PWD/scene/regionfile.h \
+    $$PWD/scene/worldstorage.h \
+    $$PWD/scene/chunkcodec.h \
+    $$PWD/scene/chunkblocks.h \
+    $$PWD/scene/chunklayout.h \
+    $$PWD/scene/chunkpool.h \
+    $$PWD/scene/blockcursor.h \
+    $$PWD/scene/paddedchunkview.h \
     $$PWD/texture.h
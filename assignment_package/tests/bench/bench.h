@@ -0,0 +1,17 @@
+#pragma once
+#include <chrono>
+
+// Each benchmark prints its own results and returns 0, or nonzero if
+// it couldn't run. See main.cpp for the list.
+int benchLayout();
+int benchLayoutPath();
+int benchRegionCache();
+int benchMeshRam();
+int benchMeshCache();
+
+using BenchClock = std::chrono::steady_clock;
+
+inline double msSince(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
@@ -0,0 +1,75 @@
+# Benchmarks: a console program with no GUI or OpenGL context; GL
+# calls go to the counting shim in common/glshim. Build it in release
+# mode, since the numbers mean nothing at -O0. To time another voxel
+# layout through the real code ("layoutpath"), rebuild with e.g.
+# DEFINES += CHUNK_VOXEL_LAYOUT=RowLayout.
+QT = core gui
+
+TARGET = bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++1z
+CONFIG += release
+CONFIG += warn_on
+
+SRC = $$PWD/../../src
+
+# The shim must shadow src/openglcontext.h
+INCLUDEPATH += $$PWD/../common/glshim
+INCLUDEPATH += $$PWD/../../include
+INCLUDEPATH += $$SRC $$SRC/scene
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/layoutbench.cpp \
+    $$PWD/layoutpathbench.cpp \
+    $$PWD/meshcachebench.cpp \
+    $$PWD/meshrambench.cpp \
+    $$PWD/regionbench.cpp \
+    $$SRC/drawable.cpp \
+    $$SRC/shaderprogram.cpp \
+    $$SRC/scene/chunk.cpp \
+    $$SRC/scene/chunkblocks.cpp \
+    $$SRC/scene/chunkcodec.cpp \
+    $$SRC/scene/chunkdelta.cpp \
+    $$SRC/scene/chunkpool.cpp \
+    $$SRC/scene/filesync.cpp \
+    $$SRC/scene/frustum.cpp \
+    $$SRC/scene/gpuarena.cpp \
+    $$SRC/scene/meshcache.cpp \
+    $$SRC/scene/occlusion.cpp \
+    $$SRC/scene/paddedchunkview.cpp \
+    $$SRC/scene/rangeallocator.cpp \
+    $$SRC/scene/regionfile.cpp \
+    $$SRC/scene/terraingen.cpp \
+    $$SRC/scene/worldstorage.cpp
+
+HEADERS += \
+    $$PWD/bench.h \
+    $$PWD/../common/glshim/openglcontext.h \
+    $$SRC/drawable.h \
+    $$SRC/shaderprogram.h \
+    $$SRC/scene/chunk.h \
+    $$SRC/scene/chunkblocks.h \
+    $$SRC/scene/chunkcodec.h \
+    $$SRC/scene/chunkdelta.h \
+    $$SRC/scene/chunkio.h \
+    $$SRC/scene/chunklayout.h \
+    $$SRC/scene/chunkpool.h \
+    $$SRC/scene/filesync.h \
+    $$SRC/scene/frustum.h \
+    $$SRC/scene/gpuarena.h \
+    $$SRC/scene/meshcache.h \
+    $$SRC/scene/occlusion.h \
+    $$SRC/scene/paddedchunkview.h \
+    $$SRC/scene/rangeallocator.h \
+    $$SRC/scene/regionfile.h \
+    $$SRC/scene/terraingen.h \
+    $$SRC/scene/worldstorage.h
@@ -0,0 +1,117 @@
+// Compares the voxel layouts in chunklayout.h on the three access
+// patterns that matter: terrain generation writing whole columns,
+// PaddedChunkView::fill copying a Chunk (z, then x, then y), and
+// scattered single-block reads such as raycasts and physics.
+//
+// The layouts are compared side by side in one build, on plain byte
+// arrays indexed by each policy, rather than through ChunkBlocks, whose
+// layout is fixed when it is compiled.
+#include "bench.h"
+#include "chunklayout.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Chunks per pass, and passes over them for the streaming patterns
+#define LAYOUT_BENCH_CHUNKS 64
+#define LAYOUT_BENCH_PASSES 20
+#define LAYOUT_BENCH_RANDOM_READS (1 << 22)
+// Each layout is timed this many times and the best run is reported
+#define LAYOUT_BENCH_RUNS 2
+
+// Same indexing as PaddedChunkView, which can't be used here since it
+// fills from a Chunk
+static constexpr int paddedIndex(int x, int y, int z)
+{
+    return (y + 1) + 258 * (x + 1) + 258 * 18 * (z + 1);
+}
+
+struct LayoutTimes
+{
+    double generation, viewFill, randomReads;
+};
+
+template<class Layout>
+static LayoutTimes timeLayout(uint64_t &sink)
+{
+    std::vector<std::vector<uint8_t>> chunks(LAYOUT_BENCH_CHUNKS, std::vector<uint8_t>(65536));
+    LayoutTimes times;
+
+    // Generation: every column filled bottom to top up to a varying height
+    auto start = BenchClock::now();
+    for(int pass = 0; pass < LAYOUT_BENCH_PASSES; pass++) {
+        for(std::vector<uint8_t> &c : chunks) {
+            for(int x = 0; x < 16; x++) {
+                for(int z = 0; z < 16; z++) {
+                    int height = 100 + (x * 7 + z * 13 + pass) % 60;
+                    for(int y = 0; y < height; y++) {
+                        c[Layout::index(x, y, z)] = static_cast<uint8_t>(1 + (y & 3));
+                    }
+                }
+            }
+        }
+    }
+    times.generation = msSince(start);
+
+    // View fill: the interior of a padded view, in PaddedChunkView::fill's order
+    std::vector<uint8_t> view(18 * 258 * 18);
+    start = BenchClock::now();
+    for(int pass = 0; pass < LAYOUT_BENCH_PASSES; pass++) {
+        for(const std::vector<uint8_t> &c : chunks) {
+            for(int z = 0; z < 16; z++) {
+                for(int x = 0; x < 16; x++) {
+                    for(int y = 0; y < 256; y++) {
+                        view[paddedIndex(x, y, z)] = c[Layout::index(x, y, z)];
+                    }
+                }
+            }
+            sink += view[paddedIndex(8, 128, 8)];
+        }
+    }
+    times.viewFill = msSince(start);
+
+    // Random reads; the coordinates are drawn up front so only the reads are timed
+    std::mt19937 rng(5);
+    std::vector<uint32_t> queries(LAYOUT_BENCH_RANDOM_READS);
+    for(uint32_t &q : queries) {
+        q = rng();
+    }
+    start = BenchClock::now();
+    for(uint32_t q : queries) {
+        const std::vector<uint8_t> &c = chunks[q % LAYOUT_BENCH_CHUNKS];
+        sink += c[Layout::index((q >> 6) & 15, (q >> 10) & 255, (q >> 18) & 15)];
+    }
+    times.randomReads = msSince(start);
+    return times;
+}
+
+template<class Layout>
+static void reportLayout(const char *name, uint64_t &sink)
+{
+    LayoutTimes best = timeLayout<Layout>(sink);
+    for(int run = 1; run < LAYOUT_BENCH_RUNS; run++) {
+        LayoutTimes t = timeLayout<Layout>(sink);
+        best.generation = std::min(best.generation, t.generation);
+        best.viewFill = std::min(best.viewFill, t.viewFill);
+        best.randomReads = std::min(best.randomReads, t.randomReads);
+    }
+    std::printf("  %-7s %9.1f ms %10.1f ms %12.1f ms\n",
+                name, best.generation, best.viewFill, best.randomReads);
+}
+
+int benchLayout()
+{
+    std::printf("  %d chunks, %d passes, %d random reads; best of %d\n",
+                LAYOUT_BENCH_CHUNKS, LAYOUT_BENCH_PASSES, LAYOUT_BENCH_RANDOM_READS,
+                LAYOUT_BENCH_RUNS);
+    std::printf("  layout  generation    view fill  random reads\n");
+    // Keeps the compiler from discarding the reads
+    uint64_t sink = 0;
+    reportLayout<RowLayout>("row", sink);
+    reportLayout<ColumnLayout>("column", sink);
+    reportLayout<MortonLayout>("morton", sink);
+    std::printf("  (checksum %llu)\n", static_cast<unsigned long long>(sink));
+    return 0;
+}
@@ -0,0 +1,117 @@
+// The voxel layout compiled into ChunkBlocks, timed through the code
+// that uses it: TerrainGenerator::fillChunk, decodeChunkBlocks (how
+// Chunks come back from the saved world and the residency tiers), then
+// PaddedChunkView::fill and Chunk::createChunkVBOdata as a VBOWorker
+// runs them.
+//
+// ChunkBlocks has one layout per build, so compare layouts by building
+// the bench once per layout (DEFINES += CHUNK_VOXEL_LAYOUT=RowLayout,
+// for example) and running "layoutpath" in each. The "layout" bench
+// compares all of them in one build, but on plain arrays.
+#include "bench.h"
+#include "chunk.h"
+#include "chunkcodec.h"
+#include "gpuarena.h"
+#include "paddedchunkview.h"
+#include "terraingen.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Chunks per side of the area, and the seed Terrain defaults to
+#define LAYOUT_PATH_SIDE 8
+#define LAYOUT_PATH_SEED 1337u
+// Each phase is timed this many times and the best run is reported;
+// view fills are averaged over several passes within each run
+#define LAYOUT_PATH_RUNS 3
+#define LAYOUT_PATH_FILL_PASSES 50
+
+#define LAYOUT_PATH_STRING(x) #x
+#define LAYOUT_PATH_NAME(x) LAYOUT_PATH_STRING(x)
+
+struct PathTimes
+{
+    double generation, decoding, viewFill, meshing;
+};
+
+static PathTimes timeArea(std::size_t &sink)
+{
+    OpenGLContext gl;
+    GpuArena arena(&gl);
+    TerrainGenerator generator(LAYOUT_PATH_SEED);
+    PathTimes times;
+
+    std::vector<uPtr<Chunk>> chunks(LAYOUT_PATH_SIDE * LAYOUT_PATH_SIDE);
+    for(int z = 0; z < LAYOUT_PATH_SIDE; z++) {
+        for(int x = 0; x < LAYOUT_PATH_SIDE; x++) {
+            uPtr<Chunk> &c = chunks[z * LAYOUT_PATH_SIDE + x];
+            c = mkU<Chunk>(&gl, &arena, 16 * x, 16 * z);
+            if(x > 0) {
+                c->linkNeighbor(chunks[z * LAYOUT_PATH_SIDE + x - 1], XNEG);
+            }
+            if(z > 0) {
+                c->linkNeighbor(chunks[(z - 1) * LAYOUT_PATH_SIDE + x], ZNEG);
+            }
+        }
+    }
+
+    auto start = BenchClock::now();
+    for(uPtr<Chunk> &c : chunks) {
+        generator.fillChunk(*c, c->m_xChunk, c->m_zChunk);
+    }
+    times.generation = msSince(start);
+
+    std::vector<std::vector<unsigned char>> encoded;
+    for(uPtr<Chunk> &c : chunks) {
+        encoded.push_back(encodeChunkBlocks(*c));
+    }
+    start = BenchClock::now();
+    for(std::size_t i = 0; i < chunks.size(); i++) {
+        sink += decodeChunkBlocks(encoded[i].data(), encoded[i].size(), *chunks[i]);
+    }
+    times.decoding = msSince(start);
+
+    // One view and scratch, like one VBOWorker thread. A fill is much
+    // cheaper than the rest, so it's timed over several passes.
+    PaddedChunkView view;
+    start = BenchClock::now();
+    for(int pass = 0; pass < LAYOUT_PATH_FILL_PASSES; pass++) {
+        for(uPtr<Chunk> &c : chunks) {
+            view.fill(*c);
+            sink += view.getBlockAt(8, 128, 8);
+        }
+    }
+    times.viewFill = msSince(start) / LAYOUT_PATH_FILL_PASSES;
+
+    ChunkVBOData scratch(nullptr);
+    times.meshing = 0;
+    for(uPtr<Chunk> &c : chunks) {
+        view.fill(*c);
+        start = BenchClock::now();
+        c->createChunkVBOdata(scratch, view, 0);
+        times.meshing += msSince(start);
+        sink += c->cpuMeshBytes();
+    }
+    return times;
+}
+
+int benchLayoutPath()
+{
+    std::size_t sink = 0;
+    PathTimes best = timeArea(sink);
+    for(int run = 1; run < LAYOUT_PATH_RUNS; run++) {
+        PathTimes t = timeArea(sink);
+        best.generation = std::min(best.generation, t.generation);
+        best.decoding = std::min(best.decoding, t.decoding);
+        best.viewFill = std::min(best.viewFill, t.viewFill);
+        best.meshing = std::min(best.meshing, t.meshing);
+    }
+    std::printf("  %s; %d x %d chunks, seed %u; best of %d\n",
+                LAYOUT_PATH_NAME(CHUNK_VOXEL_LAYOUT), LAYOUT_PATH_SIDE, LAYOUT_PATH_SIDE,
+                LAYOUT_PATH_SEED, LAYOUT_PATH_RUNS);
+    std::printf("  fillChunk %9.1f ms   decode %6.1f ms   view fill %6.1f ms   "
+                "createChunkVBOdata %7.1f ms\n",
+                best.generation, best.decoding, best.viewFill, best.meshing);
+    std::printf("  (checksum %zu)\n", sink);
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Reruns the benchmarks quoted in commit messages.
+//
+//   bench [name...]
+//
+// With no names, every benchmark runs. Timings are best of a few runs
+// where that's cheap; expect them to vary between machines, but the
+// ratios between the variants measured should hold.
+#include "bench.h"
+#include <cstdio>
+#include <cstring>
+
+struct Benchmark
+{
+    const char *name;
+    const char *description;
+    int (*run)();
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"layout", "Chunk voxel layouts (row, column, Morton): generation, view fill, random reads",
+     benchLayout},
+    {"layoutpath", "The layout this build uses, through generation, decoding, view fill and meshing",
+     benchLayoutPath},
+    {"region", "Loading Chunks from region files: cold and warm page cache, re-entry",
+     benchRegionCache},
+    {"meshram", "RAM held by CPU copies of uploaded meshes, with and without releasing them",
+     benchMeshRam},
+    {"meshcache", "Mesh cache hits re-entering an area while zones stream in",
+     benchMeshCache},
+};
+
+static void printUsage()
+{
+    std::printf("usage: bench [name...]\n");
+    for(const Benchmark &b : BENCHMARKS) {
+        std::printf("  %-10s %s\n", b.name, b.description);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int failures = 0;
+    if(argc < 2) {
+        for(const Benchmark &b : BENCHMARKS) {
+            std::printf("== %s\n", b.name);
+            failures += b.run() != 0;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+    for(int i = 1; i < argc; i++) {
+        const Benchmark *found = nullptr;
+        for(const Benchmark &b : BENCHMARKS) {
+            if(std::strcmp(argv[i], b.name) == 0) {
+                found = &b;
+            }
+        }
+        if(found == nullptr) {
+            printUsage();
+            return 1;
+        }
+        std::printf("== %s\n", found->name);
+        failures += found->run() != 0;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+// How many meshes MeshCache serves when re-entering an area while the
+// I/O threads are busy streaming zones in, with VBOWorkers queued
+// straight away and with ones parked until their lookup has been read
+// (see MeshCache::startWhenAnswered).
+//
+// Each pass meshes the same 16 x 16 Chunks the way Terrain does: every
+// Chunk gets a cache read on two I/O threads, queued among the zone
+// loads of the area, and a meshing job on the global pool. The first
+// pass fills the cache. MeshJob mirrors VBOWorker::run, which can't be
+// linked here without Terrain.
+#include "bench.h"
+#include "chunk.h"
+#include "chunkio.h"
+#include "gpuarena.h"
+#include "meshcache.h"
+#include "paddedchunkview.h"
+#include "terraingen.h"
+#include "worldstorage.h"
+#include <QRunnable>
+#include <QThreadPool>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+// Chunks per side of the area: 4 x 4 terrain zones
+#define MESH_CACHE_SIDE 16
+#define MESH_CACHE_SEED 1337u
+// Terrain's CHUNK_IO_THREADS
+#define MESH_CACHE_IO_THREADS 2
+
+namespace fs = std::filesystem;
+
+// Reads one terrain zone's saved Chunks, like ChunkIO's ZoneReader
+class ZoneLoadJob : public QRunnable
+{
+private:
+    WorldStorage *mp_world;
+    int m_x, m_z;
+public:
+    ZoneLoadJob(WorldStorage *world, int x, int z)
+        : mp_world(world), m_x(x), m_z(z)
+    {}
+
+    void run() override {
+        std::vector<SavedChunk> batch(16);
+        for(int i = 0; i < 16; i++) {
+            batch[i].x = m_x + 16 * (i / 4);
+            batch[i].z = m_z + 16 * (i % 4);
+        }
+        mp_world->loadBatch(batch);
+    }
+};
+
+// VBOWorker::run's use of the cache, without handing the mesh on
+class MeshJob : public QRunnable
+{
+private:
+    Chunk *mp_chunk;
+    MeshCache *mp_cache;
+    sPtr<MeshCache::Lookup> mp_lookup;
+    QThreadPool *mp_io;
+    std::atomic<int> *mp_done;
+public:
+    MeshJob(Chunk *chunk, MeshCache *cache, sPtr<MeshCache::Lookup> lookup,
+            QThreadPool *io, std::atomic<int> *done)
+        : mp_chunk(chunk), mp_cache(cache), mp_lookup(lookup), mp_io(io), mp_done(done)
+    {}
+
+    void run() override {
+        static thread_local PaddedChunkView view;
+        static thread_local ChunkVBOData scratch(nullptr);
+        view.fill(*mp_chunk);
+        uint64_t hash = MeshCache::hashView(view);
+        if(!mp_cache->take(*mp_lookup, hash, *mp_chunk)) {
+            mp_chunk->createChunkVBOdata(scratch, view, 0);
+            mp_io->start(mp_cache->writeJob(mp_chunk->m_xChunk, mp_chunk->m_zChunk, hash,
+                                            MeshCache::encode(*mp_chunk, hash)),
+                         ChunkIO::BACKGROUND);
+        }
+        (*mp_done)++;
+    }
+};
+
+// Meshes every Chunk once, with the area's zones loading alongside.
+// Returns the milliseconds until every mesh was built.
+static double meshArea(std::vector<uPtr<Chunk>> &chunks, WorldStorage &world,
+                       MeshCache &cache, bool wait)
+{
+    QThreadPool io;
+    io.setMaxThreadCount(MESH_CACHE_IO_THREADS);
+    auto start = BenchClock::now();
+    // The zones stream in nearest first, as Terrain requests them
+    for(int z = 0; z < MESH_CACHE_SIDE; z += 4) {
+        for(int x = 0; x < MESH_CACHE_SIDE; x += 4) {
+            io.start(new ZoneLoadJob(&world, 16 * x, 16 * z), ChunkIO::LOAD - (x + z) / 4);
+        }
+    }
+    std::atomic<int> done(0);
+    for(uPtr<Chunk> &c : chunks) {
+        c->releaseCpuMesh();
+        sPtr<MeshCache::Lookup> lookup = mkS<MeshCache::Lookup>();
+        int dist = (c->m_xChunk + c->m_zChunk) / 64;
+        io.start(cache.readJob(c->m_xChunk, c->m_zChunk, lookup), ChunkIO::LOAD - dist);
+        MeshJob *job = new MeshJob(c.get(), &cache, lookup, &io, &done);
+        if(wait) {
+            cache.startWhenAnswered(lookup, job, 0);
+        }
+        else {
+            QThreadPool::globalInstance()->start(job);
+        }
+    }
+    // Terrain releases overdue workers once a tick
+    while(done < static_cast<int>(chunks.size())) {
+        cache.startOverdue();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    QThreadPool::globalInstance()->waitForDone();
+    double ms = msSince(start);
+    io.waitForDone();
+    return ms;
+}
+
+static void printPass(const char *name, double ms, const MeshCache::Stats &before,
+                      const MeshCache::Stats &after)
+{
+    std::printf("  %-28s %4zu hits, %4zu misses, %4zu not read in time   %6.0f ms\n", name,
+                after.hits - before.hits, after.misses - before.misses,
+                after.unanswered - before.unanswered, ms);
+}
+
+int benchMeshCache()
+{
+    std::string dir = (fs::temp_directory_path() / "minecraft-meshcache-bench").string();
+    std::error_code err;
+    fs::remove_all(dir, err);
+
+    int result = 0;
+    {
+        OpenGLContext gl;
+        GpuArena arena(&gl);
+        TerrainGenerator generator(MESH_CACHE_SEED);
+        WorldStorage world(dir, MESH_CACHE_SEED);
+        if(!world.isOpen()) {
+            std::printf("  could not create %s\n", dir.c_str());
+            return 1;
+        }
+
+        // Saved whole, so the zone loads have real reading to do
+        std::vector<uPtr<Chunk>> chunks(MESH_CACHE_SIDE * MESH_CACHE_SIDE);
+        for(int z = 0; z < MESH_CACHE_SIDE; z++) {
+            for(int x = 0; x < MESH_CACHE_SIDE; x++) {
+                uPtr<Chunk> &c = chunks[z * MESH_CACHE_SIDE + x];
+                c = mkU<Chunk>(&gl, &arena, 16 * x, 16 * z);
+                generator.fillChunk(*c, 16 * x, 16 * z);
+                world.saveChunk(16 * x, 16 * z, *c);
+                if(x > 0) {
+                    c->linkNeighbor(chunks[z * MESH_CACHE_SIDE + x - 1], XNEG);
+                }
+                if(z > 0) {
+                    c->linkNeighbor(chunks[(z - 1) * MESH_CACHE_SIDE + x], ZNEG);
+                }
+            }
+        }
+        world.flush();
+
+        MeshCache cache(dir);
+        MeshCache::Stats s0 = cache.stats();
+        double firstMs = meshArea(chunks, world, cache, true);
+        MeshCache::Stats s1 = cache.stats();
+        double eagerMs = meshArea(chunks, world, cache, false);
+        MeshCache::Stats s2 = cache.stats();
+        double waitMs = meshArea(chunks, world, cache, true);
+        MeshCache::Stats s3 = cache.stats();
+
+        std::printf("  %d x %d chunks, seed %u, %d I/O threads, %d meshing threads\n",
+                    MESH_CACHE_SIDE, MESH_CACHE_SIDE, MESH_CACHE_SEED, MESH_CACHE_IO_THREADS,
+                    QThreadPool::globalInstance()->maxThreadCount());
+        printPass("first visit", firstMs, s0, s1);
+        printPass("re-entry, queued at once", eagerMs, s1, s2);
+        printPass("re-entry, parked until read", waitMs, s2, s3);
+        if(s1.stores == 0 || s3.hits == s2.hits) {
+            result = 1;
+        }
+    }
+    fs::remove_all(dir, err);
+    return result;
+}
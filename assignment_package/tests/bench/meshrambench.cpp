@@ -0,0 +1,88 @@
+// RAM held by CPU copies of Chunk meshes once they're on the GPU, with
+// and without Chunk::releaseCpuMesh, over the 7 x 7 terrain zones
+// (28 x 28 Chunks) Terrain keeps loaded around the player.
+//
+// Chunks are generated and meshed as Terrain's workers would, then
+// uploaded to a GpuArena through the counting GL shim
+// (tests/common/glshim), so no context is needed.
+#include "bench.h"
+#include "chunk.h"
+#include "gpuarena.h"
+#include "paddedchunkview.h"
+#include "terraingen.h"
+#include <cstdio>
+#include <vector>
+
+// Chunks per side of the loaded area, and the seed Terrain defaults to
+#define MESH_RAM_SIDE 28
+#define MESH_RAM_SEED 1337u
+
+static double toMB(std::size_t bytes)
+{
+    return bytes / 1048576.0;
+}
+
+// Generates, links and meshes the area around the origin, uploading
+// every mesh and releasing the CPU copies if release is set. Returns
+// the CPU mesh bytes left in the Chunks.
+static std::size_t loadArea(bool release, std::size_t &gpuBytes, std::size_t &scratchBytes,
+                            double &ms)
+{
+    OpenGLContext gl;
+    GpuArena arena(&gl);
+    TerrainGenerator generator(MESH_RAM_SEED);
+    auto start = BenchClock::now();
+
+    std::vector<uPtr<Chunk>> chunks(MESH_RAM_SIDE * MESH_RAM_SIDE);
+    for(int z = 0; z < MESH_RAM_SIDE; z++) {
+        for(int x = 0; x < MESH_RAM_SIDE; x++) {
+            uPtr<Chunk> &c = chunks[z * MESH_RAM_SIDE + x];
+            c = mkU<Chunk>(&gl, &arena, 16 * x, 16 * z);
+            generator.fillChunk(*c, 16 * x, 16 * z);
+            if(x > 0) {
+                c->linkNeighbor(chunks[z * MESH_RAM_SIDE + x - 1], XNEG);
+            }
+            if(z > 0) {
+                c->linkNeighbor(chunks[(z - 1) * MESH_RAM_SIDE + x], ZNEG);
+            }
+        }
+    }
+
+    // One view and scratch, like one VBOWorker thread
+    PaddedChunkView view;
+    ChunkVBOData scratch(nullptr);
+    for(uPtr<Chunk> &c : chunks) {
+        view.fill(*c);
+        c->createChunkVBOdata(scratch, view, 0);
+        c->createVBOdata();
+        if(release) {
+            c->releaseCpuMesh();
+        }
+    }
+    ms = msSince(start);
+
+    std::size_t cpuBytes = 0;
+    for(const uPtr<Chunk> &c : chunks) {
+        cpuBytes += c->cpuMeshBytes();
+    }
+    GpuArena::Stats a = arena.stats();
+    gpuBytes = a.vertexBytesUsed + a.indexBytesUsed;
+    scratchBytes = (scratch.m_vboOpaque.capacity() + scratch.m_vboTrans.capacity()) * sizeof(glm::vec4) +
+                   (scratch.m_idxOpaque.capacity() + scratch.m_idxTrans.capacity()) * sizeof(GLuint);
+    return cpuBytes;
+}
+
+int benchMeshRam()
+{
+    std::size_t gpuBytes = 0, scratchBytes = 0;
+    double keptMs = 0, releasedMs = 0;
+    std::size_t kept = loadArea(false, gpuBytes, scratchBytes, keptMs);
+    std::size_t released = loadArea(true, gpuBytes, scratchBytes, releasedMs);
+
+    std::printf("  %d x %d chunks, seed %u; %.1f MB of meshes on the GPU\n",
+                MESH_RAM_SIDE, MESH_RAM_SIDE, MESH_RAM_SEED, toMB(gpuBytes));
+    std::printf("  CPU mesh copies kept      %8.1f MB   (load %.0f ms)\n", toMB(kept), keptMs);
+    std::printf("  CPU mesh copies released  %8.1f MB   (load %.0f ms)\n", toMB(released), releasedMs);
+    std::printf("  meshing scratch, per worker thread %.1f MB\n", toMB(scratchBytes));
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Loading Chunks saved whole from region files, which decode straight
+// from a memory mapping (see RegionFile): from a cold page cache, from
+// a warm one through a freshly opened WorldStorage, and re-entering an
+// area with the mappings still open.
+//
+// Dropping the page cache needs posix_fadvise, so the cold case is only
+// measured where that exists; elsewhere it is reported as skipped.
+#include "bench.h"
+#include "worldstorage.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Chunks per side of the saved square: 64 x 64 Chunks fill 4 regions
+#define REGION_BENCH_SIDE 64
+#define REGION_BENCH_CHUNKS (REGION_BENCH_SIDE * REGION_BENCH_SIDE)
+
+namespace fs = std::filesystem;
+
+// Rolling terrain with water, a grass top and scattered caves, so
+// payloads are about as long as real ones
+static void fillTerrain(ChunkBlocks &blocks, int cx, int cz)
+{
+    blocks.clearBlocks();
+    for(unsigned int z = 0; z < 16; z++) {
+        for(unsigned int x = 0; x < 16; x++) {
+            int wx = cx * 16 + x, wz = cz * 16 + z;
+            unsigned int height = 128 + static_cast<int>(20 * std::sin(wx * 0.05) +
+                                                         15 * std::cos(wz * 0.07));
+            blocks.setBlockAt(x, 100u, z, BEDROCK);
+            for(unsigned int y = 101; y < height; y++) {
+                bool cave = (wx * 7 + y * 13 + wz * 3) % 97 == 0;
+                blocks.setBlockAt(x, y, z, cave ? EMPTY : STONE);
+            }
+            for(unsigned int y = height; y < 148; y++) {
+                blocks.setBlockAt(x, y, z, WATER);
+            }
+            blocks.setBlockAt(x, height, z, GRASS);
+        }
+    }
+}
+
+// Evicts the region files from the page cache; false if that isn't possible
+static bool dropPageCache(const std::string &dir)
+{
+#if defined(__unix__) && defined(POSIX_FADV_DONTNEED)
+    for(const fs::directory_entry &e : fs::directory_iterator(fs::path(dir) / "region")) {
+        int fd = open(e.path().c_str(), O_RDONLY);
+        if(fd < 0) {
+            return false;
+        }
+        fdatasync(fd);
+        bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        close(fd);
+        if(!dropped) {
+            return false;
+        }
+    }
+    return true;
+#else
+    (void)dir;
+    return false;
+#endif
+}
+
+// Milliseconds to load every saved Chunk, or a negative number on failure
+static double loadAll(WorldStorage &world)
+{
+    ChunkBlocks blocks;
+    auto start = BenchClock::now();
+    for(int cz = 0; cz < REGION_BENCH_SIDE; cz++) {
+        for(int cx = 0; cx < REGION_BENCH_SIDE; cx++) {
+            if(!world.loadChunk(cx * 16, cz * 16, blocks)) {
+                return -1;
+            }
+        }
+    }
+    return msSince(start);
+}
+
+static void report(const char *label, double ms)
+{
+    std::printf("  %-28s %8.1f ms  %6.1f us/chunk\n",
+                label, ms, 1000 * ms / REGION_BENCH_CHUNKS);
+}
+
+int benchRegionCache()
+{
+    std::string dir = (fs::temp_directory_path() / "mm-bench-region").string();
+    std::error_code err;
+    fs::remove_all(dir, err);
+    {
+        WorldStorage world(dir, 1u);
+        if(!world.isOpen()) {
+            std::printf("  could not create a world in %s\n", dir.c_str());
+            return 1;
+        }
+        ChunkBlocks blocks;
+        for(int cz = 0; cz < REGION_BENCH_SIDE; cz++) {
+            for(int cx = 0; cx < REGION_BENCH_SIDE; cx++) {
+                fillTerrain(blocks, cx, cz);
+                world.saveChunk(cx * 16, cz * 16, blocks);
+            }
+        }
+        world.sync();
+    }
+    std::uintmax_t bytes = 0;
+    for(const fs::directory_entry &e : fs::directory_iterator(fs::path(dir) / "region")) {
+        bytes += e.file_size();
+    }
+    std::printf("  %d chunks in %.1f MB of region files; best of 2 where repeated\n",
+                REGION_BENCH_CHUNKS, bytes / 1048576.0);
+
+    // Best of the runs; negative until measured
+    double cold = -1, warm = -1, reentry = -1;
+    bool failed = false;
+    auto keepBest = [&failed](double &best, double ms) {
+        failed = failed || ms < 0;
+        best = best < 0 || ms < best ? ms : best;
+    };
+    for(int run = 0; run < 2; run++) {
+        if(dropPageCache(dir)) {
+            WorldStorage world(dir, 1u);
+            keepBest(cold, loadAll(world));
+        }
+        WorldStorage world(dir, 1u);
+        keepBest(warm, loadAll(world));
+        keepBest(reentry, loadAll(world));
+    }
+    if(failed) {
+        std::printf("  a saved chunk failed to load\n");
+    }
+    if(cold >= 0) {
+        report("cold (page cache dropped)", cold);
+    }
+    else {
+        std::printf("  cold: skipped, the page cache can't be dropped here\n");
+    }
+    report("warm, fresh WorldStorage", warm);
+    report("re-entry, mappings open", reentry);
+
+    fs::remove_all(dir, err);
+    return failed ? 1 : 0;
+}
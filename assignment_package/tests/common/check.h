@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+// A minimal test harness, so the test programs need nothing beyond
+// QtCore. TEST(name) defines a test case that registers itself; CHECK
+// records a failure and carries on, so one run reports every broken
+// expectation. testmain.cpp runs the cases and exits nonzero if any
+// CHECK failed.
+//
+//   TEST(regionRoundTrip) {
+//       CHECK(decoded == original);
+//   }
+
+struct TestRegistrar
+{
+    TestRegistrar(const char *name, void (*run)());
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) checkCondition((condition), #condition, __FILE__, __LINE__)
+
+bool checkCondition(bool passed, const char *expression, const char *file, int line);
+
+// A fresh, empty directory under the system's temporary directory,
+// named after the running test. Removed when the test ends.
+std::string scratchDirectory();
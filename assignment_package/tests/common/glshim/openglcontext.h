@@ -0,0 +1,103 @@
+#pragma once
+#include <qopengl.h>
+#include <QString>
+#include <map>
+#include <string>
+// The real header gets these through Qt's widget headers
+#include <vector>
+
+// Stands in for src/openglcontext.h in headless test programs: the GL
+// calls the renderer makes do nothing but count themselves, so a test
+// can check which calls a frame makes without a window or a driver.
+// Put this directory ahead of src/ on the include path.
+//
+// Object names (buffers, VAOs, programs, shaders) count up from 1, and
+// every attribute and uniform lookup finds one, so every code path that
+// uploads or binds is taken. Shaders always compile and link.
+
+#ifndef QOPENGLF_APIENTRYP
+#define QOPENGLF_APIENTRYP *
+#endif
+
+// A GL call that only counts itself
+#define GLSHIM_COUNTED(name) \
+    template<typename... Args> void name(Args...) { m_calls[#name]++; }
+
+class OpenGLContext
+{
+public:
+    OpenGLContext() : m_calls(), m_nextName(1), m_nextLocation(0) {}
+
+    // Calls made to the GL function name since the last resetCalls
+    int callCount(const std::string &name) const {
+        auto it = m_calls.find(name);
+        return it == m_calls.end() ? 0 : it->second;
+    }
+    // Calls to every GL function together
+    int totalCalls() const {
+        int total = 0;
+        for(const auto &kv : m_calls) {
+            total += kv.second;
+        }
+        return total;
+    }
+    void resetCalls() {
+        m_calls.clear();
+    }
+
+    // Nothing to resolve: the arena falls back to one draw per mesh
+    typedef void (*ProcAddress)();
+    OpenGLContext* context() { return this; }
+    ProcAddress getProcAddress(const char*) { return nullptr; }
+
+    void printGLErrorLog() {}
+    void printLinkInfoLog(int) {}
+    void printShaderInfoLog(int) {}
+
+    void glGenBuffers(GLsizei n, GLuint *names) { generate("glGenBuffers", n, names); }
+    void glGenVertexArrays(GLsizei n, GLuint *names) { generate("glGenVertexArrays", n, names); }
+    GLuint glCreateShader(GLenum) { m_calls["glCreateShader"]++; return m_nextName++; }
+    GLuint glCreateProgram() { m_calls["glCreateProgram"]++; return m_nextName++; }
+    GLint glGetAttribLocation(GLuint, const char*) { m_calls["glGetAttribLocation"]++; return m_nextLocation++; }
+    GLint glGetUniformLocation(GLuint, const char*) { m_calls["glGetUniformLocation"]++; return m_nextLocation++; }
+    void glGetShaderiv(GLuint, GLenum, GLint *out) { m_calls["glGetShaderiv"]++; *out = GL_TRUE; }
+    void glGetProgramiv(GLuint, GLenum, GLint *out) { m_calls["glGetProgramiv"]++; *out = GL_TRUE; }
+    void glGetIntegerv(GLenum, GLint *out) { m_calls["glGetIntegerv"]++; *out = 0; }
+
+    GLSHIM_COUNTED(glAttachShader)
+    GLSHIM_COUNTED(glBindBuffer)
+    GLSHIM_COUNTED(glBindVertexArray)
+    GLSHIM_COUNTED(glBufferData)
+    GLSHIM_COUNTED(glBufferSubData)
+    GLSHIM_COUNTED(glCompileShader)
+    GLSHIM_COUNTED(glDeleteBuffers)
+    GLSHIM_COUNTED(glDeleteVertexArrays)
+    GLSHIM_COUNTED(glDisableVertexAttribArray)
+    GLSHIM_COUNTED(glDrawElements)
+    GLSHIM_COUNTED(glDrawElementsBaseVertex)
+    GLSHIM_COUNTED(glDrawElementsInstanced)
+    GLSHIM_COUNTED(glEnableVertexAttribArray)
+    GLSHIM_COUNTED(glGetProgramInfoLog)
+    GLSHIM_COUNTED(glGetShaderInfoLog)
+    GLSHIM_COUNTED(glLinkProgram)
+    GLSHIM_COUNTED(glShaderSource)
+    GLSHIM_COUNTED(glUniform1i)
+    GLSHIM_COUNTED(glUniform2i)
+    GLSHIM_COUNTED(glUniform4fv)
+    GLSHIM_COUNTED(glUniformMatrix4fv)
+    GLSHIM_COUNTED(glUseProgram)
+    GLSHIM_COUNTED(glVertexAttribDivisor)
+    GLSHIM_COUNTED(glVertexAttribPointer)
+
+private:
+    void generate(const char *call, GLsizei n, GLuint *names) {
+        m_calls[call]++;
+        for(GLsizei i = 0; i < n; i++) {
+            names[i] = m_nextName++;
+        }
+    }
+
+    std::map<std::string, int> m_calls;
+    GLuint m_nextName;
+    GLint m_nextLocation;
+};
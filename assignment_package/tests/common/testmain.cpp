@@ -0,0 +1,84 @@
+// Runs the TEST cases linked into the program.
+//
+//   <test program> [name...]
+//
+// With no names, every case runs. Exits nonzero if any CHECK failed.
+#include "check.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct TestCase
+{
+    const char *name;
+    void (*run)();
+};
+
+// Function-local, since registrars run during static initialization
+static std::vector<TestCase>& testCases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+static const char *s_currentTest = "";
+static int s_failures = 0;
+static std::vector<fs::path> s_scratch;
+
+TestRegistrar::TestRegistrar(const char *name, void (*run)())
+{
+    testCases().push_back(TestCase{name, run});
+}
+
+bool checkCondition(bool passed, const char *expression, const char *file, int line)
+{
+    if(!passed) {
+        std::printf("  FAIL %s: %s (%s:%d)\n", s_currentTest, expression, file, line);
+        s_failures++;
+    }
+    return passed;
+}
+
+std::string scratchDirectory()
+{
+    fs::path dir = fs::temp_directory_path() /
+                   ("mm-test-" + std::string(s_currentTest) + "-" + std::to_string(s_scratch.size()));
+    std::error_code err;
+    fs::remove_all(dir, err);
+    fs::create_directories(dir, err);
+    s_scratch.push_back(dir);
+    return dir.string();
+}
+
+static void runTest(const TestCase &test)
+{
+    s_currentTest = test.name;
+    int before = s_failures;
+    test.run();
+    for(const fs::path &dir : s_scratch) {
+        std::error_code err;
+        fs::remove_all(dir, err);
+    }
+    s_scratch.clear();
+    std::printf("%s %s\n", s_failures == before ? "pass" : "FAIL", test.name);
+}
+
+int main(int argc, char *argv[])
+{
+    int run = 0;
+    for(const TestCase &test : testCases()) {
+        bool selected = argc < 2;
+        for(int i = 1; i < argc; i++) {
+            selected = selected || std::strcmp(argv[i], test.name) == 0;
+        }
+        if(selected) {
+            runTest(test);
+            run++;
+        }
+    }
+    std::printf("%d tests, %d failed checks\n", run, s_failures);
+    return s_failures == 0 && run > 0 ? 0 : 1;
+}
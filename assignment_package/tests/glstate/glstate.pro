@@ -0,0 +1,41 @@
+# Counts the GL calls the renderer makes, headlessly: the programs'
+# sources are built against tests/common/glshim/openglcontext.h, whose
+# GL calls only count themselves. Exits nonzero if any check fails.
+QT = core gui
+
+TARGET = glstate
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++1z
+CONFIG += warn_on
+
+SRC = $$PWD/../../src
+
+# The shim must shadow src/openglcontext.h
+INCLUDEPATH += $$PWD/../common/glshim
+INCLUDEPATH += $$PWD/../../include
+INCLUDEPATH += $$SRC $$SRC/scene
+INCLUDEPATH += $$PWD/../common
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+
+SOURCES += \
+    $$PWD/../common/testmain.cpp \
+    $$PWD/glstatetest.cpp \
+    $$SRC/drawable.cpp \
+    $$SRC/shaderprogram.cpp \
+    $$SRC/scene/gpuarena.cpp \
+    $$SRC/scene/rangeallocator.cpp
+
+HEADERS += \
+    $$PWD/../common/check.h \
+    $$PWD/../common/glshim/openglcontext.h \
+    $$SRC/drawable.h \
+    $$SRC/shaderprogram.h \
+    $$SRC/scene/gpuarena.h \
+    $$SRC/scene/rangeallocator.h
@@ -0,0 +1,149 @@
+// The GL calls a frame makes, counted through the shim in
+// tests/common/glshim: ShaderProgram's program, uniform and VAO caches,
+// and GpuArena's pages.
+#include "check.h"
+#include "gpuarena.h"
+#include "shaderprogram.h"
+
+// A mesh of quads: 4 vertices (of 4 vec4s each) and 6 indices per quad
+static void quads(uint32_t count, std::vector<glm::vec4> &interleaved, std::vector<GLuint> &indices)
+{
+    interleaved.assign(16 * static_cast<std::size_t>(count), glm::vec4(1.f));
+    indices.resize(6 * static_cast<std::size_t>(count));
+    for(uint32_t q = 0; q < count; q++) {
+        const GLuint corners[6] = {0, 1, 2, 0, 2, 3};
+        for(int i = 0; i < 6; i++) {
+            indices[6 * q + i] = 4 * q + corners[i];
+        }
+    }
+}
+
+// What MyGL::paintGL and Terrain::draw do each frame: reset the caches,
+// bind MyGL's VAO, set the uniforms, then draw the arena's meshes in an
+// opaque pass and a transparent pass
+static void drawFrame(OpenGLContext &gl, GLuint vao, int time, ShaderProgram &lambert,
+                      ShaderProgram &flat, GpuArena &arena,
+                      const std::vector<GpuArena::Allocation> &meshes)
+{
+    glm::mat4 viewProj = glm::perspective(glm::radians(45.f), 1.5f, 0.1f, 1000.f);
+    ShaderProgram::forgetBoundState();
+    ShaderProgram::bindVertexArray(&gl, vao);
+    lambert.setTime(time);
+    flat.setViewProjMatrix(viewProj);
+    lambert.setViewProjMatrix(viewProj);
+    lambert.setModelMatrix(glm::mat4(1.f));
+    for(const GpuArena::Allocation &m : meshes) {
+        arena.queue(m);
+    }
+    arena.drawQueued(lambert);
+    for(const GpuArena::Allocation &m : meshes) {
+        arena.queue(m);
+    }
+    arena.drawQueued(lambert, true);
+}
+
+TEST(secondFrameSkipsUnchangedState)
+{
+    OpenGLContext gl;
+    GLuint vao;
+    gl.glGenVertexArrays(1, &vao);
+    ShaderProgram lambert(&gl), flat(&gl);
+    lambert.create("lambert.vert.glsl", "lambert.frag.glsl");
+    flat.create("flat.vert.glsl", "flat.frag.glsl");
+
+    GpuArena arena(&gl);
+    std::vector<GpuArena::Allocation> meshes(3);
+    std::vector<glm::vec4> interleaved;
+    std::vector<GLuint> indices;
+    for(std::size_t i = 0; i < meshes.size(); i++) {
+        quads(100 + 50 * i, interleaved, indices);
+        arena.upload(meshes[i], interleaved, indices);
+    }
+    CHECK(arena.stats().pages == 1);
+
+    gl.resetCalls();
+    ShaderProgram::StateStats before = ShaderProgram::stateStats();
+    drawFrame(gl, vao, 0, lambert, flat, arena, meshes);
+    ShaderProgram::StateStats after = ShaderProgram::stateStats();
+    // lambert for u_Time, flat for its u_ViewProj, lambert again
+    CHECK(gl.callCount("glUseProgram") == 3);
+    CHECK(after.programBinds - before.programBinds == 3);
+    CHECK(gl.callCount("glUniform1i") == 1);
+    // Both view-projections, then the model matrix and its inverse transpose
+    CHECK(gl.callCount("glUniformMatrix4fv") == 4);
+    // MyGL's VAO, then per pass the page's VAO and MyGL's back again
+    CHECK(gl.callCount("glBindVertexArray") == 5);
+    CHECK(gl.callCount("glDrawElementsBaseVertex") == 6);
+    // The page's attribute layout is set up once, in its VAO
+    CHECK(gl.callCount("glVertexAttribPointer") > 0);
+    CHECK(gl.callCount("glGetIntegerv") == 0);
+
+    gl.resetCalls();
+    before = ShaderProgram::stateStats();
+    drawFrame(gl, vao, 1, lambert, flat, arena, meshes);
+    after = ShaderProgram::stateStats();
+    // Only the time changed: one program bind, for it, after the reset
+    CHECK(gl.callCount("glUseProgram") == 1);
+    CHECK(gl.callCount("glUniform1i") == 1);
+    CHECK(gl.callCount("glUniformMatrix4fv") == 0);
+    CHECK(after.uniformUploadsSkipped - before.uniformUploadsSkipped == 3);
+    CHECK(after.programBindsSkipped - before.programBindsSkipped > 0);
+    CHECK(gl.callCount("glBindVertexArray") == 5);
+    CHECK(gl.callCount("glVertexAttribPointer") == 0);
+    CHECK(gl.callCount("glDrawElementsBaseVertex") == 6);
+    CHECK(gl.callCount("glGetIntegerv") == 0);
+}
+
+TEST(vertexArrayBindsAreCached)
+{
+    OpenGLContext gl;
+    ShaderProgram::forgetBoundState();
+    CHECK(ShaderProgram::boundVertexArray() == ShaderProgram::UNKNOWN_BINDING);
+    ShaderProgram::bindVertexArray(&gl, 7);
+    ShaderProgram::bindVertexArray(&gl, 7);
+    CHECK(gl.callCount("glBindVertexArray") == 1);
+    CHECK(ShaderProgram::boundVertexArray() == 7);
+    // Binding 0 is a real binding, not the unknown one
+    ShaderProgram::bindVertexArray(&gl, 0);
+    ShaderProgram::bindVertexArray(&gl, 0);
+    CHECK(gl.callCount("glBindVertexArray") == 2);
+    // Forgotten, it binds again
+    ShaderProgram::forgetBoundState();
+    ShaderProgram::bindVertexArray(&gl, 0);
+    CHECK(gl.callCount("glBindVertexArray") == 3);
+}
+
+TEST(arenaOpensAPageWhenOneRunsOut)
+{
+    OpenGLContext gl;
+    ShaderProgram lambert(&gl);
+    lambert.create("lambert.vert.glsl", "lambert.frag.glsl");
+    GpuArena arena(&gl);
+    std::vector<glm::vec4> interleaved;
+    std::vector<GLuint> indices;
+    // 150000 quads are 600000 vertices, more than half a page
+    quads(150000, interleaved, indices);
+
+    GpuArena::Allocation a, b, c;
+    arena.upload(a, interleaved, indices);
+    CHECK(arena.stats().pages == 1);
+    arena.upload(b, interleaved, indices);
+    CHECK(arena.stats().pages == 2);
+    CHECK(a.page == 0 && b.page == 1);
+    CHECK(gl.callCount("glBufferData") == 4);
+
+    // Drawing both pages binds each page's VAO
+    ShaderProgram::forgetBoundState();
+    gl.resetCalls();
+    arena.queue(a);
+    arena.queue(b);
+    arena.drawQueued(lambert);
+    CHECK(arena.stats().drawCalls == 2);
+    CHECK(gl.callCount("glBindVertexArray") == 2);
+
+    // Room again on the first page once its mesh is released
+    arena.release(a);
+    arena.upload(c, interleaved, indices);
+    CHECK(c.page == 0);
+    CHECK(arena.stats().pages == 2);
+}
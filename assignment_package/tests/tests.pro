@@ -0,0 +1,10 @@
+# Test and benchmark programs. None of them open a window or need an
+# OpenGL context, so they run headless (qmake tests/tests.pro && make,
+# then run each program from its build directory).
+#   unit    unit tests for the GL-free code; exits nonzero on failure
+#   glstate the GL calls the renderer makes, counted through a shim
+#           (common/glshim); exits nonzero on failure
+#   bench   benchmarks behind the numbers quoted in commit messages;
+#           see bench/main.cpp for usage
+TEMPLATE = subdirs
+SUBDIRS = unit glstate bench
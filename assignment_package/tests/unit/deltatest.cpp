@@ -0,0 +1,50 @@
+// ChunkDelta: recording, copy-on-write snapshots, and overlaying this
+// session's edits on the ones saved by an earlier session.
+#include "check.h"
+#include "chunkdelta.h"
+
+TEST(deltaSnapshotIsCopyOnWrite)
+{
+    ChunkDelta edits;
+    edits.record(1, 2, 3, STONE);
+    ChunkDelta snapshot = edits;
+    edits.record(1, 2, 3, ICE);
+    edits.record(4, 5, 6, DIRT);
+
+    ChunkBlocks blocks;
+    snapshot.applyTo(blocks);
+    CHECK(snapshot.size() == 1);
+    CHECK(blocks.getBlockAt(1, 2, 3) == STONE);
+    CHECK(blocks.getBlockAt(4, 5, 6) == EMPTY);
+}
+
+TEST(deltaOverlayNewerWins)
+{
+    ChunkDelta saved;
+    saved.record(0, 10, 0, STONE);
+    saved.record(1, 10, 1, DIRT);
+    ChunkDelta session;
+    session.record(1, 10, 1, ICE);
+    session.record(2, 10, 2, LAVA);
+    ChunkDelta sessionCopy = session;
+
+    saved.overlay(session);
+    CHECK(saved.size() == 3);
+    ChunkBlocks blocks;
+    saved.applyTo(blocks);
+    CHECK(blocks.getBlockAt(0, 10, 0) == STONE);
+    CHECK(blocks.getBlockAt(1, 10, 1) == ICE);
+    CHECK(blocks.getBlockAt(2, 10, 2) == LAVA);
+    // The overlaid delta is left alone
+    CHECK(session.size() == 2 && sessionCopy.size() == 2);
+
+    // Into an empty delta, and round trip through the encoding
+    ChunkDelta empty;
+    empty.overlay(saved);
+    ChunkDelta decoded;
+    std::vector<unsigned char> encoded = empty.encode();
+    CHECK(decoded.decode(encoded.data(), encoded.size()));
+    CHECK(decoded.size() == 3);
+    empty.record(3, 3, 3, SNOW);
+    CHECK(saved.size() == 3);
+}
@@ -0,0 +1,67 @@
+// Frustum: boxes wholly inside, wholly outside each of the six planes,
+// and straddling each of them.
+#include "check.h"
+#include "frustum.h"
+
+// A camera at the origin looking down -z, 90 degrees each way, so at
+// depth d the view spans -d to d in x and y
+static Frustum straightAhead()
+{
+    glm::mat4 proj = glm::perspective(glm::radians(90.f), 1.f, 0.1f, 100.f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+    return Frustum(proj * view);
+}
+
+static bool boxVisible(const Frustum &f, glm::vec3 center, float halfSize)
+{
+    return f.intersects(center - glm::vec3(halfSize), center + glm::vec3(halfSize));
+}
+
+TEST(frustumKeepsBoxesInside)
+{
+    Frustum f = straightAhead();
+    CHECK(boxVisible(f, glm::vec3(0.f, 0.f, -10.f), 1.f));
+    CHECK(boxVisible(f, glm::vec3(7.f, -7.f, -20.f), 2.f));
+    CHECK(boxVisible(f, glm::vec3(0.f, 0.f, -99.f), 0.5f));
+    // A box the frustum lies entirely within
+    CHECK(boxVisible(f, glm::vec3(0.f, 0.f, -50.f), 500.f));
+}
+
+TEST(frustumRejectsBoxesOutsideEachPlane)
+{
+    Frustum f = straightAhead();
+    // Left, right, bottom, top: at depth 10 the view ends at +-10
+    CHECK(!boxVisible(f, glm::vec3(-15.f, 0.f, -10.f), 1.f));
+    CHECK(!boxVisible(f, glm::vec3(15.f, 0.f, -10.f), 1.f));
+    CHECK(!boxVisible(f, glm::vec3(0.f, -15.f, -10.f), 1.f));
+    CHECK(!boxVisible(f, glm::vec3(0.f, 15.f, -10.f), 1.f));
+    // Near: behind the camera. Far: past 100.
+    CHECK(!boxVisible(f, glm::vec3(0.f, 0.f, 5.f), 1.f));
+    CHECK(!boxVisible(f, glm::vec3(0.f, 0.f, -130.f), 10.f));
+}
+
+TEST(frustumKeepsBoxesStraddlingEachPlane)
+{
+    Frustum f = straightAhead();
+    CHECK(boxVisible(f, glm::vec3(-10.f, 0.f, -10.f), 1.f));
+    CHECK(boxVisible(f, glm::vec3(10.f, 0.f, -10.f), 1.f));
+    CHECK(boxVisible(f, glm::vec3(0.f, -10.f, -10.f), 1.f));
+    CHECK(boxVisible(f, glm::vec3(0.f, 10.f, -10.f), 1.f));
+    CHECK(boxVisible(f, glm::vec3(0.f, 0.f, 0.f), 0.5f));
+    CHECK(boxVisible(f, glm::vec3(0.f, 0.f, -100.f), 2.f));
+}
+
+TEST(frustumFollowsTheCamera)
+{
+    // Looking diagonally down at a Chunk, as the player does
+    glm::vec3 eye(100.f, 180.f, 100.f), target(8.f, 128.f, 8.f);
+    glm::mat4 proj = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 1000.f);
+    Frustum f(proj * glm::lookAt(eye, target, glm::vec3(0.f, 1.f, 0.f)));
+
+    CHECK(f.intersects(glm::vec3(0.f, 120.f, 0.f), glm::vec3(16.f, 136.f, 16.f)));
+    // The same Chunk mirrored behind the camera
+    glm::vec3 behind = 2.f * eye - target;
+    CHECK(!f.intersects(behind - glm::vec3(8.f), behind + glm::vec3(8.f)));
+    // Far off to the side
+    CHECK(!f.intersects(glm::vec3(400.f, 120.f, -200.f), glm::vec3(416.f, 136.f, -184.f)));
+}
@@ -0,0 +1,98 @@
+// EditJournal: checkpoints drop exactly the records they cover, and the
+// journal is always replaced whole.
+#include "check.h"
+#include "editjournal.h"
+#include <filesystem>
+
+TEST(journalCheckpointKeepsLaterEdits)
+{
+    std::string dir = scratchDirectory();
+    std::string path = dir + "/edits.journal";
+    WorldStorage world(dir, 1u);
+    {
+        EditJournal journal(path, &world);
+        CHECK(journal.replay().empty());
+        journal.start();
+        for(int i = 0; i < 5; i++) {
+            journal.append(i, 10, i, STONE);
+        }
+        uint64_t mark = journal.mark();
+        for(int i = 0; i < 3; i++) {
+            journal.append(100 + i, 11, i, ICE);
+        }
+        ChunkDelta edits;
+        edits.record(0, 10, 0, STONE);
+        std::vector<EditJournal::ChunkWrite> writes;
+        writes.push_back(EditJournal::ChunkWrite{0, 0, WorldStorage::CHUNK_EDITS, edits.encode()});
+        journal.commit(mark, std::move(writes));
+    }
+    CHECK(!std::filesystem::exists(path + ".tmp"));
+    CHECK(world.hasChunk(0, 0));
+
+    {
+        EditJournal journal(path, &world);
+        std::vector<EditJournal::Record> replayed = journal.replay();
+        CHECK(replayed.size() == 3);
+        CHECK(!replayed.empty() && replayed[0].x == 100 && replayed[0].type == ICE);
+        journal.start();
+        journal.append(7, 7, 7, DIRT);
+    }
+    // Replayed records are carried over, and new ones follow them
+    EditJournal journal(path, &world);
+    std::vector<EditJournal::Record> replayed = journal.replay();
+    CHECK(replayed.size() == 4);
+    CHECK(replayed.size() == 4 && replayed[3].type == DIRT);
+}
+
+TEST(journalIgnoresTornTail)
+{
+    std::string dir = scratchDirectory();
+    std::string path = dir + "/edits.journal";
+    WorldStorage world(dir, 1u);
+    {
+        EditJournal journal(path, &world);
+        journal.replay();
+        journal.start();
+        journal.append(1, 2, 3, GRASS);
+        journal.append(4, 5, 6, SNOW);
+    }
+    // Half of the last record made it to disk
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 6);
+    {
+        EditJournal journal(path, &world);
+        std::vector<EditJournal::Record> replayed = journal.replay();
+        CHECK(replayed.size() == 1);
+        journal.start();
+        journal.append(8, 9, 10, LAVA);
+    }
+    // The torn bytes were dropped when the journal was rewritten
+    EditJournal journal(path, &world);
+    std::vector<EditJournal::Record> replayed = journal.replay();
+    CHECK(replayed.size() == 2);
+    CHECK(replayed.size() == 2 && replayed[1].type == LAVA);
+}
+
+TEST(journalCommitWithoutMarkKeepsEveryEdit)
+{
+    std::string dir = scratchDirectory();
+    std::string path = dir + "/edits.journal";
+    WorldStorage world(dir, 1u);
+    {
+        EditJournal journal(path, &world);
+        journal.replay();
+        journal.start();
+        for(int i = 0; i < 5; i++) {
+            journal.append(i, 10, i, STONE);
+        }
+        // As an autosave that couldn't serialize every Chunk commits
+        ChunkDelta edits;
+        edits.record(0, 10, 0, STONE);
+        std::vector<EditJournal::ChunkWrite> writes;
+        writes.push_back(EditJournal::ChunkWrite{0, 0, WorldStorage::CHUNK_EDITS, edits.encode()});
+        journal.commit(0, std::move(writes));
+    }
+    CHECK(world.hasChunk(0, 0));
+
+    EditJournal journal(path, &world);
+    CHECK(journal.replay().size() == 5);
+}
@@ -0,0 +1,165 @@
+// SectionGraph, OcclusionCuller and AsyncOcclusionCuller, on a strip of
+// three Chunks along x with the camera in the first, looking down +x.
+#include "check.h"
+#include "occlusion.h"
+
+// Chunks with origins (0, 0), (16, 0) and (32, 0)
+#define STRIP_MAX_X 48
+#define STRIP_MAX_Z 16
+
+static glm::mat4 lookingDownX(glm::vec3 eye)
+{
+    glm::mat4 proj = glm::perspective(glm::radians(90.f), 1.f, 0.1f, 500.f);
+    return proj * glm::lookAt(eye, eye + glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+}
+
+static SectionGraph graphOf(BlockType fill)
+{
+    ChunkBlocks blocks;
+    for(int x = 0; x < 16; x++) {
+        for(int z = 0; z < 16; z++) {
+            for(int y = 0; y < 256; y++) {
+                blocks.setBlockAtUnchecked(x, y, z, fill);
+            }
+        }
+    }
+    SectionGraph graph;
+    graph.compute(blocks);
+    return graph;
+}
+
+TEST(sectionGraphLinksOpenFaces)
+{
+    SectionGraph solid = graphOf(STONE), open = graphOf(EMPTY);
+    CHECK(!solid.connects(3, XNEG, XPOS));
+    CHECK(open.connects(3, XNEG, XPOS));
+    CHECK(open.connects(15, YNEG, ZPOS));
+
+    // A stone floor at y = 40 splits section 2 into two halves that
+    // never see each other, and seals it from below
+    ChunkBlocks blocks;
+    for(int x = 0; x < 16; x++) {
+        for(int z = 0; z < 16; z++) {
+            blocks.setBlockAt(x, 40, z, STONE);
+        }
+    }
+    SectionGraph floor;
+    floor.compute(blocks);
+    CHECK(!floor.connects(2, YNEG, YPOS));
+    CHECK(floor.connects(2, XNEG, YPOS));
+    CHECK(floor.connects(2, XNEG, YNEG));
+    CHECK(floor.connects(1, YNEG, YPOS));
+}
+
+TEST(occlusionCullerStopsAtSolidChunks)
+{
+    SectionGraph open = graphOf(EMPTY), solid = graphOf(STONE);
+    glm::vec3 eye(8.f, 72.f, 8.f);
+    Frustum frustum(lookingDownX(eye));
+
+    OcclusionCuller culler;
+    culler.run(eye, frustum, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, [&](int x, int) {
+        return x == 16 ? &solid : &open;
+    });
+    // The camera's section, the wall it looks at, and nothing beyond
+    CHECK(culler.visibleSections(0, 0) & (1 << 4));
+    CHECK(culler.visibleSections(16, 0) & (1 << 4));
+    CHECK(culler.visibleSections(32, 0) == 0);
+    // Outside the area everything is visible
+    CHECK(culler.visibleSections(-16, 0) == 0xffff);
+
+    culler.run(eye, frustum, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, [&](int, int) {
+        return &open;
+    });
+    CHECK(culler.visibleSections(32, 0) & (1 << 4));
+    CHECK(culler.sectionsReached() > 0);
+
+    // Missing graphs are open space
+    culler.run(eye, frustum, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, [](int, int) {
+        return static_cast<const SectionGraph*>(nullptr);
+    });
+    CHECK(culler.visibleSections(32, 0) & (1 << 4));
+}
+
+TEST(occlusionCullerLeavesEverythingVisibleWithTheCameraOutside)
+{
+    SectionGraph solid = graphOf(STONE);
+    glm::vec3 eye(-100.f, 72.f, 8.f);
+    Frustum frustum(lookingDownX(eye));
+    OcclusionCuller culler;
+    culler.run(eye, frustum, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, [&](int, int) {
+        return &solid;
+    });
+    CHECK(culler.visibleSections(32, 0) == 0xffff);
+}
+
+TEST(asyncOcclusionCullerLagsOneFill)
+{
+    SectionGraph open = graphOf(EMPTY), solid = graphOf(STONE);
+    glm::vec3 eye(8.f, 72.f, 8.f);
+    SectionGraph wall = solid;
+    auto lookup = [&](int x, int) {
+        return x == 16 ? &wall : &open;
+    };
+
+    AsyncOcclusionCuller culler;
+    // Nothing has finished yet: everything is visible
+    culler.update(eye, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, lookup);
+    CHECK(culler.visibleSections(32, 0) == 0xffff);
+    CHECK(culler.fillsTaken() == 0);
+
+    // The wall is knocked down after the fill copied it; the next
+    // frame still uses what that fill found
+    wall = open;
+    culler.waitForFill();
+    culler.update(eye, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, lookup);
+    CHECK(culler.fillsTaken() == 1);
+    CHECK(culler.visibleSections(16, 0) & (1 << 4));
+    CHECK(culler.visibleSections(32, 0) == 0);
+
+    // and the frame after that sees through
+    culler.waitForFill();
+    culler.update(eye, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, lookup);
+    CHECK(culler.fillsTaken() == 2);
+    CHECK(culler.visibleSections(32, 0) & (1 << 4));
+}
+
+TEST(asyncOcclusionCullerFillsEveryDirection)
+{
+    // The camera stands in the middle Chunk of the strip; whichever way
+    // it turns before the next fill, both ends are already reached
+    SectionGraph open = graphOf(EMPTY);
+    glm::vec3 eye(24.f, 72.f, 8.f);
+    AsyncOcclusionCuller culler;
+    culler.update(eye, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, [&](int, int) {
+        return &open;
+    });
+    culler.waitForFill();
+    culler.update(eye, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, [&](int, int) {
+        return &open;
+    });
+    CHECK(culler.fillsTaken() == 1);
+    CHECK(culler.visibleSections(0, 0) & (1 << 4));
+    CHECK(culler.visibleSections(32, 0) & (1 << 4));
+    // Straight up and down too
+    CHECK(culler.visibleSections(16, 0) == 0xffff);
+}
+
+TEST(asyncOcclusionCullerSkipsFramesWhileFilling)
+{
+    SectionGraph open = graphOf(EMPTY);
+    glm::vec3 eye(8.f, 72.f, 8.f);
+    AsyncOcclusionCuller culler;
+    int lookups = 0;
+    for(int frame = 0; frame < 50; frame++) {
+        culler.update(eye, 0, 0, STRIP_MAX_X, STRIP_MAX_Z, [&](int, int) {
+            lookups++;
+            return &open;
+        });
+    }
+    culler.waitForFill();
+    // Each fill copies the area's three graphs once; frames drawn
+    // while one runs start nothing
+    CHECK(lookups % 3 == 0);
+    CHECK(static_cast<std::size_t>(lookups / 3) == culler.fillsTaken() + 1);
+}
@@ -0,0 +1,120 @@
+// RangeAllocator: best fit, merging freed ranges with the holes on
+// either side, fragmentation, and running out of space.
+#include "check.h"
+#include "rangeallocator.h"
+#include <stdexcept>
+
+TEST(rangeAllocatorPicksTheSmallestHoleThatFits)
+{
+    RangeAllocator r(1000);
+    uint32_t a = r.allocate(100), b = r.allocate(50), c = r.allocate(200), d = r.allocate(60);
+    r.allocate(10);
+    CHECK(a == 0 && b == 100 && c == 150 && d == 350);
+    // Holes of 100 at 0, 200 at 150 and the 580 left at the end
+    r.free(a, 100);
+    r.free(c, 200);
+    CHECK(r.holes() == 3);
+
+    // 150 fits the 200 hole and the tail; the 200 hole is smaller
+    CHECK(r.allocate(150) == 150);
+    // 90 fits the 100 hole best, not what's left of the 200 one
+    CHECK(r.allocate(90) == 0);
+    // An exact fit leaves no hole behind
+    CHECK(r.allocate(50) == 300);
+    CHECK(r.holes() == 2);
+    CHECK(r.used() == 90 + 50 + 150 + 50 + 60 + 10);
+}
+
+TEST(rangeAllocatorMergesFreedRangesBothWays)
+{
+    RangeAllocator r(300);
+    uint32_t a = r.allocate(100), b = r.allocate(100), c = r.allocate(100);
+    CHECK(r.holes() == 0);
+
+    // With the hole after it
+    r.free(c, 100);
+    r.free(b, 100);
+    CHECK(r.holes() == 1);
+    CHECK(r.largestFree() == 200);
+
+    // With the hole before it
+    uint32_t b2 = r.allocate(100), c2 = r.allocate(100);
+    CHECK(b2 == 100 && c2 == 200);
+    r.free(a, 100);
+    r.free(b2, 100);
+    CHECK(r.holes() == 1);
+    CHECK(r.largestFree() == 200);
+
+    // With the holes on both sides at once
+    RangeAllocator s(300);
+    uint32_t x = s.allocate(100), y = s.allocate(100), z = s.allocate(100);
+    s.free(x, 100);
+    s.free(z, 100);
+    CHECK(s.holes() == 2);
+    s.free(y, 100);
+    CHECK(s.holes() == 1);
+    CHECK(s.largestFree() == 300);
+    CHECK(s.used() == 0);
+    CHECK(s.allocate(300) == 0);
+}
+
+TEST(rangeAllocatorReportsFragmentation)
+{
+    RangeAllocator r(1000);
+    CHECK(r.fragmentation() == 0.f);
+
+    // Every other 100 freed: five holes of 100, none bigger
+    uint32_t offsets[10];
+    for(uint32_t &o : offsets) {
+        o = r.allocate(100);
+    }
+    CHECK(r.fragmentation() == 0.f);
+    for(int i = 0; i < 10; i += 2) {
+        r.free(offsets[i], 100);
+    }
+    CHECK(r.holes() == 5);
+    CHECK(r.largestFree() == 100);
+    CHECK(r.fragmentation() > 0.79f && r.fragmentation() < 0.81f);
+    // Too scattered for 200 even though 500 are free
+    CHECK(r.allocate(200) == RangeAllocator::NONE);
+
+    // Freeing the rest joins it all back into one hole
+    for(int i = 1; i < 10; i += 2) {
+        r.free(offsets[i], 100);
+    }
+    CHECK(r.holes() == 1);
+    CHECK(r.fragmentation() == 0.f);
+}
+
+TEST(rangeAllocatorRunsOutOfSpace)
+{
+    // One page's worth, filled exactly
+    RangeAllocator r(1024);
+    for(int i = 0; i < 8; i++) {
+        CHECK(r.allocate(128) == static_cast<uint32_t>(128 * i));
+    }
+    CHECK(r.used() == r.capacity());
+    CHECK(r.largestFree() == 0);
+    CHECK(r.holes() == 0);
+    CHECK(r.allocate(1) == RangeAllocator::NONE);
+    CHECK(r.allocate(0) == RangeAllocator::NONE);
+
+    // Room again once something is freed, and only that much
+    r.free(256, 128);
+    CHECK(r.allocate(129) == RangeAllocator::NONE);
+    CHECK(r.allocate(128) == 256);
+
+    // A range that never came from the page is refused
+    bool threw = false;
+    try {
+        r.free(1000, 100);
+    }
+    catch(const std::out_of_range&) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    RangeAllocator empty(0);
+    CHECK(empty.allocate(1) == RangeAllocator::NONE);
+    CHECK(empty.fragmentation() == 0.f);
+}
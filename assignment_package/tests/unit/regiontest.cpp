@@ -0,0 +1,282 @@
+// ChunkCodec, RegionFile and WorldStorage: what goes in comes back out,
+// across reopening, overwriting and compaction.
+#include "check.h"
+#include "chunkcodec.h"
+#include "regionfile.h"
+#include "worldstorage.h"
+#include <filesystem>
+#include <random>
+
+// Terrain-like blocks: stone up to a varying height, a grass top,
+// water up to sea level, with some random caves and ores
+static void fillTerrain(ChunkBlocks &blocks, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    blocks.clearBlocks();
+    for(unsigned int x = 0; x < 16; x++) {
+        for(unsigned int z = 0; z < 16; z++) {
+            unsigned int height = 120 + rng() % 40;
+            blocks.setBlockAt(x, 0u, z, BEDROCK);
+            for(unsigned int y = 1; y < height; y++) {
+                BlockType t = rng() % 50 == 0 ? EMPTY : rng() % 70 == 0 ? LAVA : STONE;
+                blocks.setBlockAt(x, y, z, t);
+            }
+            blocks.setBlockAt(x, height, z, GRASS);
+            for(unsigned int y = height + 1; y < 138; y++) {
+                blocks.setBlockAt(x, y, z, WATER);
+            }
+        }
+    }
+}
+
+static bool sameBlocks(const ChunkBlocks &a, const ChunkBlocks &b)
+{
+    for(int x = 0; x < 16; x++) {
+        for(int z = 0; z < 16; z++) {
+            for(int y = 0; y < 256; y++) {
+                if(a.getBlockAtUnchecked(x, y, z) != b.getBlockAtUnchecked(x, y, z)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static std::vector<unsigned char> payloadOf(int id, std::size_t size)
+{
+    std::vector<unsigned char> payload(size);
+    for(std::size_t i = 0; i < size; i++) {
+        payload[i] = static_cast<unsigned char>(id * 31 + i);
+    }
+    return payload;
+}
+
+static bool readsBack(RegionFile &region, int localX, int localZ,
+                      const std::vector<unsigned char> &expected)
+{
+    const unsigned char *data;
+    std::size_t size;
+    return region.readPayload(localX, localZ, data, size) &&
+           std::vector<unsigned char>(data, data + size) == expected;
+}
+
+TEST(codecRoundTrip)
+{
+    for(uint32_t seed = 1; seed <= 4; seed++) {
+        ChunkBlocks original, decoded;
+        fillTerrain(original, seed);
+        std::vector<unsigned char> encoded = encodeChunkBlocks(original);
+        CHECK(encoded.size() < 65536);
+        CHECK(decodeChunkBlocks(encoded.data(), encoded.size(), decoded));
+        CHECK(sameBlocks(original, decoded));
+    }
+
+    ChunkBlocks empty, decoded;
+    std::vector<unsigned char> encoded = encodeChunkBlocks(empty);
+    CHECK(decodeChunkBlocks(encoded.data(), encoded.size(), decoded));
+    CHECK(sameBlocks(empty, decoded));
+}
+
+TEST(codecRejectsMalformedData)
+{
+    ChunkBlocks original, decoded;
+    fillTerrain(original, 7);
+    std::vector<unsigned char> encoded = encodeChunkBlocks(original);
+
+    CHECK(chunkBlocksValid(encoded.data(), encoded.size()));
+    CHECK(!decodeChunkBlocks(encoded.data(), encoded.size() - 3, decoded));
+    CHECK(!chunkBlocksValid(encoded.data(), encoded.size() - 3));
+    std::vector<unsigned char> trailing = encoded;
+    trailing.push_back(0);
+    CHECK(!decodeChunkBlocks(trailing.data(), trailing.size(), decoded));
+    CHECK(!chunkBlocksValid(trailing.data(), trailing.size()));
+    std::vector<unsigned char> badType = encoded;
+    badType[2] = 200;
+    CHECK(!decodeChunkBlocks(badType.data(), badType.size(), decoded));
+    CHECK(!chunkBlocksValid(badType.data(), badType.size()));
+}
+
+TEST(regionFileRoundTrip)
+{
+    std::string path = scratchDirectory() + "/r.0.0.mmr";
+    {
+        RegionFile region(path);
+        CHECK(region.isOpen());
+        for(int i = 0; i < 40; i++) {
+            CHECK(region.writePayload(i % 32, i / 32, payloadOf(i, 100 + 37 * i)));
+        }
+        // Rewritten: the newer payload wins
+        CHECK(region.writePayload(5, 0, payloadOf(1000, 10)));
+        CHECK(readsBack(region, 5, 0, payloadOf(1000, 10)));
+        CHECK(!region.hasChunk(31, 31));
+    }
+
+    RegionFile reopened(path);
+    CHECK(reopened.isOpen());
+    for(int i = 0; i < 40; i++) {
+        std::vector<unsigned char> expected = i == 5 ? payloadOf(1000, 10) : payloadOf(i, 100 + 37 * i);
+        CHECK(reopened.hasChunk(i % 32, i / 32));
+        CHECK(readsBack(reopened, i % 32, i / 32, expected));
+    }
+    const unsigned char *data;
+    std::size_t size;
+    CHECK(!reopened.hasChunk(31, 31));
+    CHECK(!reopened.readPayload(31, 31, data, size));
+    CHECK(reopened.mappedReads() > 0);
+}
+
+TEST(regionFileCompact)
+{
+    std::string path = scratchDirectory() + "/r.0.0.mmr";
+    RegionFile region(path);
+    for(int i = 0; i < 8; i++) {
+        CHECK(region.writePayload(i, 0, payloadOf(i, 500)));
+    }
+    for(int i = 0; i < 4; i++) {
+        CHECK(region.writePayload(i, 0, payloadOf(100 + i, 300)));
+    }
+    CHECK(region.wastedBytes() == 4 * 500);
+    std::uintmax_t before = std::filesystem::file_size(path);
+
+    CHECK(region.compact());
+    CHECK(region.wastedBytes() == 0);
+    CHECK(std::filesystem::file_size(path) == before - 4 * 500);
+    CHECK(!std::filesystem::exists(path + ".tmp"));
+    for(int i = 0; i < 8; i++) {
+        CHECK(readsBack(region, i, 0, i < 4 ? payloadOf(100 + i, 300) : payloadOf(i, 500)));
+    }
+
+    // Still appendable, and all of it survives reopening
+    CHECK(region.writePayload(9, 0, payloadOf(9, 64)));
+    region.flush();
+    RegionFile reopened(path);
+    CHECK(readsBack(reopened, 9, 0, payloadOf(9, 64)));
+    CHECK(readsBack(reopened, 7, 0, payloadOf(7, 500)));
+}
+
+TEST(regionFileIgnoresTornAppend)
+{
+    std::string path = scratchDirectory() + "/r.0.0.mmr";
+    {
+        RegionFile region(path);
+        CHECK(region.writePayload(0, 0, payloadOf(0, 200)));
+        CHECK(region.writePayload(1, 0, payloadOf(1, 200)));
+    }
+    // As if the second payload's bytes never made it to disk
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 50);
+
+    RegionFile region(path);
+    CHECK(region.isOpen());
+    CHECK(readsBack(region, 0, 0, payloadOf(0, 200)));
+    CHECK(!region.hasChunk(1, 0));
+}
+
+TEST(worldStorageRoundTrip)
+{
+    std::string dir = scratchDirectory() + "/world";
+    ChunkBlocks whole;
+    fillTerrain(whole, 3);
+    ChunkDelta edits;
+    edits.record(1, 200, 2, ICE);
+    edits.record(15, 0, 15, EMPTY);
+    {
+        WorldStorage world(dir, 4242u);
+        CHECK(world.isOpen());
+        // Negative coordinates land in a different region
+        CHECK(world.saveChunk(-16, 512, whole));
+        CHECK(world.saveEdits(32, -48, edits));
+        CHECK(world.sync());
+    }
+
+    WorldStorage world(dir, 1u);
+    CHECK(world.isOpen());
+    CHECK(world.seed() == 4242u);
+    CHECK(world.hasFullChunk(-16, 512));
+    CHECK(!world.hasFullChunk(32, -48));
+    CHECK(world.hasChunk(32, -48));
+    CHECK(!world.hasChunk(0, 0));
+
+    ChunkBlocks loaded;
+    CHECK(world.loadChunk(-16, 512, loaded));
+    CHECK(sameBlocks(whole, loaded));
+
+    ChunkDelta loadedEdits;
+    CHECK(world.loadEdits(32, -48, loadedEdits));
+    CHECK(loadedEdits.size() == 2);
+    ChunkBlocks patched;
+    loadedEdits.applyTo(patched);
+    CHECK(patched.getBlockAt(1, 200, 2) == ICE);
+    // Edits aren't whole Chunks, and vice versa
+    CHECK(!world.loadChunk(32, -48, loaded));
+    CHECK(!world.loadEdits(-16, 512, loadedEdits));
+
+    std::vector<SavedChunk> batch(2);
+    batch[0].x = -16;
+    batch[0].z = 512;
+    batch[1].x = 32;
+    batch[1].z = -48;
+    world.loadBatch(batch);
+    ChunkBlocks batchLoaded;
+    CHECK(batch[0].hasBlocks &&
+          decodeChunkBlocks(batch[0].blocks.data(), batch[0].blocks.size(), batchLoaded) &&
+          sameBlocks(whole, batchLoaded));
+    CHECK(!batch[1].hasBlocks && batch[1].hasEdits && batch[1].edits.size() == 2);
+
+    // A whole Chunk that doesn't decode loads as if it was never saved
+    std::vector<unsigned char> truncated = encodeChunkBlocks(whole);
+    truncated.resize(truncated.size() - 3);
+    CHECK(world.writePayload(-32, 512, WorldStorage::FULL_CHUNK, truncated));
+    std::vector<SavedChunk> corrupt(1);
+    corrupt[0].x = -32;
+    corrupt[0].z = 512;
+    world.loadBatch(corrupt);
+    CHECK(!corrupt[0].hasBlocks && !corrupt[0].hasEdits);
+}
+
+TEST(worldStorageClosesLeastRecentlyUsedRegions)
+{
+    std::string dir = scratchDirectory() + "/world";
+    ChunkDelta edits;
+    edits.record(3, 64, 3, ICE);
+    // One Chunk in each of 100 regions, more than are kept open
+    {
+        WorldStorage world(dir, 1u);
+        for(int i = 0; i < 100; i++) {
+            CHECK(world.saveEdits(i * 512, 0, edits));
+        }
+        CHECK(world.stats().regionsClosed > 0);
+        // A region closed along the way is reopened, with its edits intact
+        CHECK(world.hasChunk(0, 0));
+    }
+
+    WorldStorage world(dir, 1u);
+    for(int i = 0; i < 100; i++) {
+        ChunkDelta loaded;
+        CHECK(world.loadEdits(i * 512, 0, loaded));
+        CHECK(loaded.size() == 1);
+    }
+}
+
+TEST(worldStorageSyncCoversClosedRegions)
+{
+    std::string dir = scratchDirectory() + "/world";
+    ChunkDelta edits;
+    edits.record(7, 90, 7, GRASS);
+    WorldStorage world(dir, 1u);
+    // Regions closed to stay under the limit are synced on the way out,
+    // so sync() vouches for all 100 even though most are no longer open
+    for(int i = 0; i < 100; i++) {
+        CHECK(world.saveEdits(0, i * 512, edits));
+    }
+    CHECK(world.stats().regionsClosed >= 100 - 64);
+    CHECK(world.sync());
+    // Nothing written since: syncing again has nothing to report
+    CHECK(world.sync());
+
+    for(int i = 0; i < 100; i++) {
+        ChunkDelta loaded;
+        CHECK(world.loadEdits(0, i * 512, loaded));
+        CHECK(loaded.size() == 1);
+    }
+}
@@ -0,0 +1,56 @@
+# Unit tests for code that needs no GUI or OpenGL: a console program
+# that runs every test (or the ones named on its command line) and
+# exits nonzero if any check fails.
+QT = core
+
+TARGET = unit
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++1z
+CONFIG += warn_on
+
+SRC = $$PWD/../../src
+
+INCLUDEPATH += $$PWD/../../include
+INCLUDEPATH += $$SRC $$SRC/scene
+INCLUDEPATH += $$PWD/../common
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+
+SOURCES += \
+    $$PWD/../common/testmain.cpp \
+    $$PWD/deltatest.cpp \
+    $$PWD/frustumtest.cpp \
+    $$PWD/journaltest.cpp \
+    $$PWD/occlusiontest.cpp \
+    $$PWD/rangetest.cpp \
+    $$PWD/regiontest.cpp \
+    $$SRC/scene/chunkblocks.cpp \
+    $$SRC/scene/chunkcodec.cpp \
+    $$SRC/scene/chunkdelta.cpp \
+    $$SRC/scene/editjournal.cpp \
+    $$SRC/scene/filesync.cpp \
+    $$SRC/scene/frustum.cpp \
+    $$SRC/scene/occlusion.cpp \
+    $$SRC/scene/rangeallocator.cpp \
+    $$SRC/scene/regionfile.cpp \
+    $$SRC/scene/worldstorage.cpp
+
+HEADERS += \
+    $$PWD/../common/check.h \
+    $$SRC/scene/chunkblocks.h \
+    $$SRC/scene/chunkcodec.h \
+    $$SRC/scene/chunkdelta.h \
+    $$SRC/scene/chunklayout.h \
+    $$SRC/scene/editjournal.h \
+    $$SRC/scene/filesync.h \
+    $$SRC/scene/frustum.h \
+    $$SRC/scene/occlusion.h \
+    $$SRC/scene/rangeallocator.h \
+    $$SRC/scene/regionfile.h \
+    $$SRC/scene/worldstorage.h
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Peak resident memory of this process so far, for the offline tools'
+// progress reports. Windows builds need psapi.
+inline std::size_t peakMemoryKB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize >> 10;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    // Bytes on macOS, kilobytes elsewhere
+    return usage.ru_maxrss >> 10;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
@@ -0,0 +1,54 @@
+# Heightmap PNG importer: a console program with no GUI or OpenGL.
+# Build it on its own (qmake tools/heightmap/heightmap.pro) and see main.cpp
+# for usage. Reads PNGs with libpng, which streams rows; QImage would
+# decode the whole image into memory.
+QT = core
+
+TARGET = heightmap
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++1z
+CONFIG += warn_on
+win32 {
+    LIBS += -lpsapi
+}
+unix {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libpng
+}
+win32 {
+    LIBS += -lpng
+}
+
+SRC = $$PWD/../../src
+
+INCLUDEPATH += $$PWD/../../include
+INCLUDEPATH += $$SRC $$SRC/scene
+INCLUDEPATH += $$PWD/../common
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$SRC/scene/chunkblocks.cpp \
+    $$SRC/scene/chunkcodec.cpp \
+    $$SRC/scene/chunkdelta.cpp \
+    $$SRC/scene/filesync.cpp \
+    $$SRC/scene/regionfile.cpp \
+    $$SRC/scene/worldstorage.cpp
+
+HEADERS += \
+    $$PWD/../common/peakmemory.h \
+    $$SRC/scene/chunkblocks.h \
+    $$SRC/scene/chunkcodec.h \
+    $$SRC/scene/chunkdelta.h \
+    $$SRC/scene/chunklayout.h \
+    $$SRC/scene/filesync.h \
+    $$SRC/scene/regionfile.h \
+    $$SRC/scene/terraingen.h \
+    $$SRC/scene/worldstorage.h
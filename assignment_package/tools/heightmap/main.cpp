@@ -0,0 +1,398 @@
+// Imports a grayscale heightmap PNG (a DEM export, say) into a world's
+// region files, one block column per pixel.
+//
+//   heightmap <image.png> <world dir> [--origin <x> <z>] [--min-y <y>]
+//             [--max-y <y>] [--water <y>] [--threads <n>]
+//
+// Pixel (col, row) becomes the column at world (x + col, z + row), with
+// the origin rounded down to a Chunk corner (default 0 0). Black maps to
+// --min-y and white to --max-y (defaults 128 and 250). Columns are built
+// from the same layers as generated terrain: bedrock, stone, three dirt,
+// then grass (snow above the snow line), with water up to --water
+// (default 148) over anything lower. The Chunks the image covers are
+// replaced whole; Chunks along its right and bottom edges that the image
+// only partly covers repeat its edge pixels.
+//
+// The image is streamed 16 rows (one row of Chunks) at a time, and only a
+// few such strips are in memory at once, so memory depends on the image's
+// width but not its height. Each strip is cut into region-wide runs of
+// Chunks that are built, encoded and written on a thread pool.
+// Interlaced PNGs can't be streamed and are rejected.
+#include "terraingen.h"
+#include "worldstorage.h"
+#include "chunkcodec.h"
+#include "peakmemory.h"
+#include "smartpointerhelp.h"
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <png.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+// Strips read ahead of the workers; bounds memory
+#define MAX_STRIPS_IN_FLIGHT 4
+// Chunks per ImportWorker: one region's width
+#define CHUNKS_PER_WORKER 32
+
+// Reads a PNG one row at a time as 16-bit gray
+class PngRowReader
+{
+private:
+    std::FILE *mp_file;
+    png_structp mp_png;
+    png_infop mp_info;
+    int m_width, m_height, m_bitDepth;
+    std::vector<png_byte> m_row;
+    std::string m_error;
+
+    static void onError(png_structp png, png_const_charp message) {
+        PngRowReader *reader = static_cast<PngRowReader*>(png_get_error_ptr(png));
+        reader->m_error = message;
+        longjmp(png_jmpbuf(png), 1);
+    }
+    static void onWarning(png_structp, png_const_charp) {}
+
+public:
+    PngRowReader()
+        : mp_file(nullptr), mp_png(nullptr), mp_info(nullptr),
+          m_width(0), m_height(0), m_bitDepth(0), m_row(), m_error()
+    {}
+    ~PngRowReader() {
+        if(mp_png != nullptr) {
+            png_destroy_read_struct(&mp_png, &mp_info, nullptr);
+        }
+        if(mp_file != nullptr) {
+            std::fclose(mp_file);
+        }
+    }
+
+    bool open(const char *path) {
+        mp_file = std::fopen(path, "rb");
+        if(mp_file == nullptr) {
+            m_error = "could not open file";
+            return false;
+        }
+        mp_png = png_create_read_struct(PNG_LIBPNG_VER_STRING, this, onError, onWarning);
+        mp_info = mp_png == nullptr ? nullptr : png_create_info_struct(mp_png);
+        if(mp_info == nullptr) {
+            m_error = "out of memory";
+            return false;
+        }
+        // No locals with destructors past this point: libpng longjmps here
+        if(setjmp(png_jmpbuf(mp_png))) {
+            return false;
+        }
+        png_init_io(mp_png, mp_file);
+        png_read_info(mp_png, mp_info);
+        if(png_get_interlace_type(mp_png, mp_info) != PNG_INTERLACE_NONE) {
+            m_error = "interlaced images can't be streamed";
+            return false;
+        }
+        int colorType = png_get_color_type(mp_png, mp_info);
+        m_bitDepth = png_get_bit_depth(mp_png, mp_info);
+        if(colorType == PNG_COLOR_TYPE_PALETTE) {
+            png_set_palette_to_rgb(mp_png);
+            m_bitDepth = 8;
+        }
+        if(colorType == PNG_COLOR_TYPE_GRAY && m_bitDepth < 8) {
+            png_set_expand_gray_1_2_4_to_8(mp_png);
+            m_bitDepth = 8;
+        }
+        if(colorType & PNG_COLOR_MASK_ALPHA) {
+            png_set_strip_alpha(mp_png);
+        }
+        if(colorType & PNG_COLOR_MASK_COLOR || colorType == PNG_COLOR_TYPE_PALETTE) {
+            png_set_rgb_to_gray_fixed(mp_png, 1, -1, -1);
+        }
+        png_read_update_info(mp_png, mp_info);
+        m_width = png_get_image_width(mp_png, mp_info);
+        m_height = png_get_image_height(mp_png, mp_info);
+        m_row.resize(png_get_rowbytes(mp_png, mp_info));
+        return true;
+    }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    const std::string& error() const { return m_error; }
+
+    // Reads the next row into out (width() values), scaled to [0, 65535]
+    bool readRow(uint16_t *out) {
+        if(setjmp(png_jmpbuf(mp_png))) {
+            return false;
+        }
+        png_read_row(mp_png, m_row.data(), nullptr);
+        if(m_bitDepth == 16) {
+            for(int i = 0; i < m_width; i++) {
+                out[i] = static_cast<uint16_t>((m_row[2 * i] << 8) | m_row[2 * i + 1]);
+            }
+        }
+        else {
+            for(int i = 0; i < m_width; i++) {
+                out[i] = static_cast<uint16_t>(m_row[i] * 257);
+            }
+        }
+        return true;
+    }
+};
+
+struct ImportSettings
+{
+    int originX, originZ;
+    int minY, maxY, waterY;
+};
+
+// 16 rows of heights, the pixels of one row of Chunks
+struct HeightStrip
+{
+    int row;
+    int width;
+    std::vector<uint16_t> heights;
+    // ImportWorkers still reading this strip
+    std::atomic<int> workersLeft;
+
+    uint16_t at(int col, int r) const {
+        return heights[r * width + std::min(col, width - 1)];
+    }
+};
+
+// Counts strips still in use so the reader can wait for room
+struct StripGate
+{
+    QMutex lock;
+    QWaitCondition freed;
+    int inFlight = 0;
+};
+
+struct Progress
+{
+    std::atomic<std::size_t> chunksWritten{0};
+    std::atomic<std::size_t> bytesWritten{0};
+    // Chunks that couldn't be saved; any of these fails the import
+    std::atomic<std::size_t> chunksFailed{0};
+};
+
+// Builds one column from the generator's layers
+static void fillColumn(ChunkBlocks &blocks, int x, int z, int surface, int waterY)
+{
+    blocks.setBlockAt(x, TerrainGenerator::BED_LEVEL, z, BEDROCK);
+    for(int y = TerrainGenerator::BED_LEVEL + 1; y <= surface; y++) {
+        BlockType t = STONE;
+        if(y == surface) {
+            t = y >= TerrainGenerator::SNOW_LEVEL ? SNOW : GRASS;
+        }
+        else if(y > surface - 4 && surface < TerrainGenerator::SNOW_LEVEL) {
+            t = DIRT;
+        }
+        blocks.setBlockAt(x, y, z, t);
+    }
+    for(int y = surface + 1; y < waterY; y++) {
+        blocks.setBlockAt(x, y, z, WATER);
+    }
+}
+
+// Builds, encodes and saves a run of Chunks from one strip
+class ImportWorker : public QRunnable
+{
+private:
+    sPtr<HeightStrip> mp_strip;
+    int m_firstChunk, m_chunkCount;
+    const ImportSettings *mp_settings;
+    WorldStorage *mp_storage;
+    StripGate *mp_gate;
+    Progress *mp_progress;
+public:
+    ImportWorker(sPtr<HeightStrip> strip, int firstChunk, int chunkCount,
+                 const ImportSettings *settings, WorldStorage *storage,
+                 StripGate *gate, Progress *progress)
+        : mp_strip(strip), m_firstChunk(firstChunk), m_chunkCount(chunkCount),
+          mp_settings(settings), mp_storage(storage),
+          mp_gate(gate), mp_progress(progress)
+    {}
+
+    void run() override {
+        const ImportSettings &s = *mp_settings;
+        ChunkBlocks blocks;
+        for(int c = m_firstChunk; c < m_firstChunk + m_chunkCount; c++) {
+            blocks.clearBlocks();
+            for(int z = 0; z < 16; z++) {
+                for(int x = 0; x < 16; x++) {
+                    uint16_t h = mp_strip->at(16 * c + x, z);
+                    int surface = s.minY + (h * (s.maxY - s.minY) + 32767) / 65535;
+                    fillColumn(blocks, x, z, surface, s.waterY);
+                }
+            }
+            std::vector<unsigned char> body = encodeChunkBlocks(blocks);
+            int x = s.originX + 16 * c, z = s.originZ + 16 * mp_strip->row;
+            if(mp_storage->writePayload(x, z, WorldStorage::FULL_CHUNK, body)) {
+                mp_progress->chunksWritten++;
+                mp_progress->bytesWritten += body.size();
+            }
+            else if(mp_progress->chunksFailed++ == 0) {
+                // Only the first: a full disk would fail every Chunk after it
+                std::printf("Could not write the chunk at %d %d\n", x, z);
+            }
+        }
+
+        if(--mp_strip->workersLeft == 0) {
+            QMutexLocker locker(&mp_gate->lock);
+            mp_gate->inFlight--;
+            mp_gate->freed.wakeAll();
+        }
+    }
+};
+
+static void printUsage()
+{
+    std::printf("usage: heightmap <image.png> <world dir> [--origin <x> <z>] [--min-y <y>]\n"
+                "                 [--max-y <y>] [--water <y>] [--threads <n>]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3) {
+        printUsage();
+        return 1;
+    }
+    const char *image = argv[1];
+    std::string dir = argv[2];
+    ImportSettings settings{0, 0, TerrainGenerator::BASE_HEIGHT, 250, TerrainGenerator::WATER_LEVEL};
+    int threads = QThreadPool::globalInstance()->maxThreadCount();
+    for(int i = 3; i < argc; i++) {
+        if(std::strcmp(argv[i], "--origin") == 0 && i + 2 < argc) {
+            settings.originX = std::atoi(argv[++i]) & ~15;
+            settings.originZ = std::atoi(argv[++i]) & ~15;
+        }
+        else if(std::strcmp(argv[i], "--min-y") == 0 && i + 1 < argc) {
+            settings.minY = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--max-y") == 0 && i + 1 < argc) {
+            settings.maxY = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--water") == 0 && i + 1 < argc) {
+            settings.waterY = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if(settings.minY <= TerrainGenerator::BED_LEVEL || settings.maxY > 255 ||
+            settings.minY > settings.maxY) {
+        std::printf("Heights must satisfy %d < min-y <= max-y <= 255\n", TerrainGenerator::BED_LEVEL);
+        return 1;
+    }
+    // Water fills up to but not including --water
+    if(settings.waterY < 0 || settings.waterY > 256) {
+        std::printf("The water level must satisfy 0 <= water <= 256\n");
+        return 1;
+    }
+    if(threads <= 0) {
+        printUsage();
+        return 1;
+    }
+
+    PngRowReader png;
+    if(!png.open(image)) {
+        std::printf("Could not read %s: %s\n", image, png.error().c_str());
+        return 1;
+    }
+    WorldStorage storage(dir, 1337u);
+    if(!storage.isOpen()) {
+        std::printf("Could not open world %s\n", dir.c_str());
+        return 1;
+    }
+
+    int width = png.width();
+    int chunksX = (width + 15) / 16;
+    int chunksZ = (png.height() + 15) / 16;
+    std::printf("Importing %s (%d x %d) as %d x %d chunks at %d %d into %s, %d threads\n",
+                image, width, png.height(), chunksX, chunksZ,
+                settings.originX, settings.originZ, dir.c_str(), threads);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    StripGate gate;
+    Progress progress;
+    auto start = steady_clock::now();
+    auto lastReport = start;
+    bool ok = true;
+    for(int row = 0; row < chunksZ; row++) {
+        {
+            QMutexLocker locker(&gate.lock);
+            while(gate.inFlight >= MAX_STRIPS_IN_FLIGHT) {
+                gate.freed.wait(&gate.lock);
+            }
+            gate.inFlight++;
+        }
+
+        sPtr<HeightStrip> strip = mkS<HeightStrip>();
+        strip->row = row;
+        strip->width = width;
+        strip->heights.resize(16 * static_cast<std::size_t>(width));
+        strip->workersLeft = (chunksX + CHUNKS_PER_WORKER - 1) / CHUNKS_PER_WORKER;
+        int rows = std::min(16, png.height() - 16 * row);
+        for(int r = 0; r < rows && ok; r++) {
+            ok = png.readRow(&strip->heights[r * static_cast<std::size_t>(width)]);
+        }
+        if(!ok) {
+            // No worker will release this strip's slot
+            QMutexLocker locker(&gate.lock);
+            gate.inFlight--;
+            break;
+        }
+        // The last strip may be short: repeat the image's bottom row
+        for(int r = rows; r < 16; r++) {
+            std::copy_n(&strip->heights[(rows - 1) * static_cast<std::size_t>(width)], width,
+                        &strip->heights[r * static_cast<std::size_t>(width)]);
+        }
+
+        for(int c = 0; c < chunksX; c += CHUNKS_PER_WORKER) {
+            pool.start(new ImportWorker(strip, c, std::min(CHUNKS_PER_WORKER, chunksX - c),
+                                        &settings, &storage, &gate, &progress));
+        }
+
+        auto now = steady_clock::now();
+        if(now - lastReport > seconds(1) || row == chunksZ - 1) {
+            lastReport = now;
+            double secs = duration<double>(now - start).count();
+            std::printf("  %d / %d chunk rows read, %zu chunks written, %.0f chunks/s, peak memory %zu MB\n",
+                        row + 1, chunksZ, progress.chunksWritten.load(),
+                        progress.chunksWritten / secs, peakMemoryKB() >> 10);
+            std::fflush(stdout);
+        }
+    }
+    pool.waitForDone();
+    if(!ok) {
+        std::printf("Could not read %s: %s\n", image, png.error().c_str());
+        return 1;
+    }
+    if(progress.chunksFailed > 0) {
+        std::printf("Import failed: %zu of %d chunks could not be written\n",
+                    progress.chunksFailed.load(), chunksX * chunksZ);
+        return 1;
+    }
+    if(!storage.sync()) {
+        std::printf("Import failed: could not sync the region files of %s\n", dir.c_str());
+        return 1;
+    }
+
+    double secs = duration<double>(steady_clock::now() - start).count();
+    std::printf("Wrote %zu chunks (%zu MB) in %.1f s: %.0f chunks/s, peak memory %zu MB\n",
+                progress.chunksWritten.load(), progress.bytesWritten.load() >> 20, secs,
+                secs > 0 ? progress.chunksWritten / secs : 0.0, peakMemoryKB() >> 10);
+    return 0;
+}
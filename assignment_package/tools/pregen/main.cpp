@@ -0,0 +1,179 @@
+// Pregenerates a rectangle of terrain zones into a world's region files,
+// on every core, so players walking into that area load Chunks instead of
+// waiting for them to be generated.
+//
+//   pregen <world dir> <zones x> <zones z> [--center <zone x> <zone z>]
+//          [--seed <seed>] [--threads <n>]
+//
+// Zones are the game's 64 x 64 terrain generation zones (4 x 4 Chunks).
+// The rectangle is centered on the given zone, by default the one the
+// player starts in. --seed only applies to a world that doesn't exist
+// yet; an existing world keeps its own.
+//
+// Chunks are stored whole. Chunks already saved whole are left alone, and
+// Chunks with saved edits are generated with the edits applied, so it is
+// safe to run on a world that has been played (but not while the game has
+// it open).
+#include "terraingen.h"
+#include "worldstorage.h"
+#include "chunkcodec.h"
+#include "peakmemory.h"
+#include <QRunnable>
+#include <QThreadPool>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std::chrono;
+
+// Progress is printed this often
+#define REPORT_INTERVAL_MS 1000
+
+struct Progress
+{
+    std::atomic<std::size_t> zonesDone{0};
+    std::atomic<std::size_t> chunksWritten{0};
+    std::atomic<std::size_t> chunksSkipped{0};
+    std::atomic<std::size_t> bytesWritten{0};
+    // Chunks that couldn't be saved; any of these fails the run
+    std::atomic<std::size_t> chunksFailed{0};
+};
+
+// Generates and saves one terrain zone
+class PregenWorker : public QRunnable
+{
+private:
+    int m_x, m_z;
+    const TerrainGenerator *mp_generator;
+    WorldStorage *mp_storage;
+    Progress *mp_progress;
+public:
+    PregenWorker(int x, int z, const TerrainGenerator *generator,
+                 WorldStorage *storage, Progress *progress)
+        : m_x(x), m_z(z), mp_generator(generator),
+          mp_storage(storage), mp_progress(progress)
+    {}
+
+    void run() override {
+        ChunkBlocks blocks;
+        for(int x = m_x; x < m_x + 64; x+=16) {
+            for(int z = m_z; z < m_z + 64; z+=16) {
+                if(mp_storage->hasFullChunk(x, z)) {
+                    mp_progress->chunksSkipped++;
+                    continue;
+                }
+                blocks.clearBlocks();
+                mp_generator->fillChunk(blocks, x, z);
+                ChunkDelta edits;
+                if(mp_storage->loadEdits(x, z, edits)) {
+                    edits.applyTo(blocks);
+                }
+                std::vector<unsigned char> body = encodeChunkBlocks(blocks);
+                if(mp_storage->writePayload(x, z, WorldStorage::FULL_CHUNK, body)) {
+                    mp_progress->chunksWritten++;
+                    mp_progress->bytesWritten += body.size();
+                }
+                else if(mp_progress->chunksFailed++ == 0) {
+                    // Only the first: a full disk would fail every Chunk after it
+                    std::printf("Could not write the chunk at %d %d\n", x, z);
+                }
+            }
+        }
+        mp_progress->zonesDone++;
+    }
+};
+
+static void printUsage()
+{
+    std::printf("usage: pregen <world dir> <zones x> <zones z> [--center <zone x> <zone z>]\n"
+                "              [--seed <seed>] [--threads <n>]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 4) {
+        printUsage();
+        return 1;
+    }
+    std::string dir = argv[1];
+    int zonesX = std::atoi(argv[2]);
+    int zonesZ = std::atoi(argv[3]);
+    int centerX = 0, centerZ = 0;
+    uint32_t seed = 1337u;
+    int threads = QThreadPool::globalInstance()->maxThreadCount();
+    for(int i = 4; i < argc; i++) {
+        if(std::strcmp(argv[i], "--center") == 0 && i + 2 < argc) {
+            centerX = std::atoi(argv[++i]);
+            centerZ = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if(zonesX <= 0 || zonesZ <= 0 || threads <= 0) {
+        printUsage();
+        return 1;
+    }
+
+    WorldStorage storage(dir, seed);
+    if(!storage.isOpen()) {
+        std::printf("Could not open world %s\n", dir.c_str());
+        return 1;
+    }
+    TerrainGenerator generator(storage.seed());
+    Progress progress;
+
+    // Row by row, so each region file is filled before the next
+    std::size_t zones = static_cast<std::size_t>(zonesX) * zonesZ;
+    int firstX = centerX - zonesX / 2;
+    int firstZ = centerZ - zonesZ / 2;
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for(int z = firstZ; z < firstZ + zonesZ; z++) {
+        for(int x = firstX; x < firstX + zonesX; x++) {
+            pool.start(new PregenWorker(64 * x, 64 * z, &generator, &storage, &progress));
+        }
+    }
+    std::printf("Pregenerating %d x %d zones (%zu chunks) around zone %d %d of %s, seed %u, %d threads\n",
+                zonesX, zonesZ, zones * 16, centerX, centerZ, dir.c_str(), storage.seed(), threads);
+
+    auto start = steady_clock::now();
+    bool finished = false;
+    while(!finished) {
+        finished = pool.waitForDone(REPORT_INTERVAL_MS);
+        double secs = duration<double>(steady_clock::now() - start).count();
+        std::size_t done = progress.zonesDone;
+        std::size_t chunks = progress.chunksWritten + progress.chunksSkipped;
+        std::printf("  %zu / %zu zones (%.1f%%), %.0f chunks/s, peak memory %zu MB\n",
+                    done, zones, 100.0 * done / zones, secs > 0 ? chunks / secs : 0.0,
+                    peakMemoryKB() >> 10);
+        std::fflush(stdout);
+    }
+    if(progress.chunksFailed > 0) {
+        std::printf("Pregeneration failed: %zu of %zu chunks could not be written\n",
+                    progress.chunksFailed.load(), zones * 16);
+        return 1;
+    }
+    if(!storage.sync()) {
+        std::printf("Could not sync the region files of %s\n", dir.c_str());
+        return 1;
+    }
+
+    double secs = duration<double>(steady_clock::now() - start).count();
+    std::printf("Wrote %zu chunks (%zu MB), skipped %zu already saved, in %.1f s: "
+                "%.0f chunks/s, peak memory %zu MB\n",
+                progress.chunksWritten.load(), progress.bytesWritten.load() >> 20,
+                progress.chunksSkipped.load(), secs,
+                secs > 0 ? progress.chunksWritten / secs : 0.0, peakMemoryKB() >> 10);
+    return 0;
+}
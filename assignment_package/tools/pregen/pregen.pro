@@ -0,0 +1,47 @@
+# Offline world pregeneration: a console program with no GUI or OpenGL.
+# Build it on its own (qmake tools/pregen/pregen.pro) and see main.cpp
+# for usage.
+QT = core
+
+TARGET = pregen
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++1z
+CONFIG += warn_on
+win32 {
+    LIBS += -lpsapi
+}
+
+SRC = $$PWD/../../src
+
+INCLUDEPATH += $$PWD/../../include
+INCLUDEPATH += $$SRC $$SRC/scene
+INCLUDEPATH += $$PWD/../common
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$SRC/scene/chunkblocks.cpp \
+    $$SRC/scene/chunkcodec.cpp \
+    $$SRC/scene/chunkdelta.cpp \
+    $$SRC/scene/filesync.cpp \
+    $$SRC/scene/regionfile.cpp \
+    $$SRC/scene/terraingen.cpp \
+    $$SRC/scene/worldstorage.cpp
+
+HEADERS += \
+    $$PWD/../common/peakmemory.h \
+    $$SRC/scene/chunkblocks.h \
+    $$SRC/scene/chunkcodec.h \
+    $$SRC/scene/chunkdelta.h \
+    $$SRC/scene/chunklayout.h \
+    $$SRC/scene/filesync.h \
+    $$SRC/scene/regionfile.h \
+    $$SRC/scene/terraingen.h \
+    $$SRC/scene/worldstorage.h